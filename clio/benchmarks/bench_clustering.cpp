@@ -0,0 +1,153 @@
+#include <benchmark/benchmark.h>
+#include <clio/agglomerative_clustering.h>
+#include <clio/clustering_workspace.h>
+#include <clio/ib_edge_selector.h>
+#include <clio/ib_utils.h>
+#include <clio/task_index.h>
+
+#include "clio_benchmarks/graph_generators.h"
+
+namespace clio::benchmarks {
+
+namespace {
+
+IBEdgeSelector::Config getSelectorConfig() {
+  IBEdgeSelector::Config config;
+  config.max_delta = 0.05;
+  config.py_x.score_threshold = 0.1;
+  return config;
+}
+
+void runClustering(benchmark::State& state,
+                   const spark_dsg::SceneGraphLayer& layer,
+                   size_t num_tasks,
+                   size_t dim,
+                   const AgglomerationConfig& agglomeration = {}) {
+  const auto embeddings = makeEmbeddings(layer, dim, 4);
+  const auto tasks = makeTasks(num_tasks, dim);
+  const hydra::CosineDistance metric;
+  const auto config = getSelectorConfig();
+
+  size_t num_clusters = 0;
+  size_t num_rounds = 0;
+  for (auto _ : state) {
+    ClusteringWorkspace ws(layer, embeddings);
+    IBEdgeSelector selector(config);
+    const auto stats = clusterAgglomerative(
+        ws, tasks, selector, metric, false, -1, 1, 5, agglomeration);
+    num_clusters = ws.getClusters().size();
+    num_rounds = stats.rounds;
+    benchmark::DoNotOptimize(num_clusters);
+  }
+
+  state.counters["nodes"] = layer.numNodes();
+  state.counters["edges"] = layer.numEdges();
+  state.counters["clusters"] = num_clusters;
+  state.counters["rounds"] = num_rounds;
+}
+
+}  // namespace
+
+// args: grid side, number of tasks, feature dimension
+void BM_ClusterGrid(benchmark::State& state) {
+  const auto side = state.range(0);
+  const auto layer = makeGridLayer(side, side);
+  runClustering(state, *layer, state.range(1), state.range(2));
+}
+
+BENCHMARK(BM_ClusterGrid)
+    ->ArgsProduct({{8, 16, 32, 64}, {10, 100}, {32, 512}})
+    ->Unit(benchmark::kMillisecond);
+
+// args: number of nodes, average degree, number of tasks
+void BM_ClusterRandomGeometric(benchmark::State& state) {
+  const auto layer = makeRandomGeometricLayer(state.range(0), state.range(1));
+  runClustering(state, *layer, state.range(2), 64);
+}
+
+BENCHMARK(BM_ClusterRandomGeometric)
+    ->ArgsProduct({{100, 1000, 4000}, {4, 12}, {10, 100}})
+    ->Unit(benchmark::kMillisecond);
+
+// args: grid side, batch merges
+void BM_ClusterGridScheduler(benchmark::State& state) {
+  const auto side = state.range(0);
+  const auto layer = makeGridLayer(side, side);
+  AgglomerationConfig agglomeration;
+  agglomeration.batch_merges = state.range(1);
+  runClustering(state, *layer, 100, 64, agglomeration);
+}
+
+BENCHMARK(BM_ClusterGridScheduler)
+    ->ArgsProduct({{16, 32, 64}, {0, 1}})
+    ->Unit(benchmark::kMillisecond);
+
+// args: grid side
+void BM_WorkspaceAddMerge(benchmark::State& state) {
+  const auto side = state.range(0);
+  const auto layer = makeGridLayer(side, side);
+  const auto embeddings = makeEmbeddings(*layer, 8, 1);
+  for (auto _ : state) {
+    state.PauseTiming();
+    ClusteringWorkspace ws(*layer, embeddings);
+    state.ResumeTiming();
+    // merge everything into one cluster in edge order
+    while (!ws.edges.empty()) {
+      benchmark::DoNotOptimize(ws.addMerge(ws.edges.begin()->first));
+    }
+  }
+
+  state.counters["merges"] = layer->numNodes() - 1;
+  state.SetComplexityN(layer->numNodes());
+}
+
+BENCHMARK(BM_WorkspaceAddMerge)->RangeMultiplier(2)->Range(8, 128)->Complexity();
+
+// args: number of features, number of tasks, feature dimension, sparse
+void BM_PyGivenX(benchmark::State& state) {
+  const auto features = makeFeatures(state.range(0), state.range(2));
+  const auto tasks = makeTasks(state.range(1), state.range(2));
+  const hydra::CosineDistance metric;
+  const bool sparse = state.range(3);
+  const auto config = getSelectorConfig().py_x;
+  for (auto _ : state) {
+    if (sparse) {
+      const auto py_x = computeSparseIBpyGivenX(features, tasks, metric, config);
+      benchmark::DoNotOptimize(py_x.data());
+    } else {
+      const auto py_x = computeIBpyGivenX(features, tasks, metric, config);
+      benchmark::DoNotOptimize(py_x.data());
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BM_PyGivenX)
+    ->ArgsProduct({{100, 1000}, {10, 100, 1000}, {64, 512}, {0, 1}})
+    ->Unit(benchmark::kMicrosecond);
+
+// args: number of tasks, feature dimension, use task index
+void BM_BestTask(benchmark::State& state) {
+  const auto features = makeFeatures(100, state.range(1));
+  const auto tasks = makeTasks(state.range(0), state.range(1));
+  const hydra::CosineDistance metric;
+  const TaskIndex index(tasks, metric);
+  const bool use_index = state.range(2);
+  for (auto _ : state) {
+    for (int i = 0; i < features.cols(); ++i) {
+      const Eigen::VectorXf feature = features.col(i);
+      const auto result = use_index ? index.getBestScore(feature)
+                                    : tasks.getBestScore(metric, feature);
+      benchmark::DoNotOptimize(result.score);
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations() * features.cols());
+}
+
+BENCHMARK(BM_BestTask)
+    ->ArgsProduct({{10, 100, 1000}, {64, 512}, {0, 1}})
+    ->Unit(benchmark::kMicrosecond);
+
+}  // namespace clio::benchmarks
@@ -0,0 +1,132 @@
+#include <benchmark/benchmark.h>
+#include <clio/ib_utils.h>
+#include <clio/object_update_functor.h>
+#include <clio/probability_utilities.h>
+
+#include "clio_benchmarks/allocation_counter.h"
+#include "clio_benchmarks/graph_generators.h"
+
+namespace clio::benchmarks {
+
+using namespace spark_dsg;
+
+namespace {
+
+ObjectUpdateFunctor::Config getFunctorConfig(double index_resolution) {
+  ObjectUpdateFunctor::Config config;
+  config.tasks = RandomEmbeddingGroup::getConfig(10, 16);
+  config.segment_index_resolution = index_resolution;
+  return config;
+}
+
+}  // namespace
+
+// args: number of segments, index resolution in cm (0 for pairwise checks)
+void BM_AddSegmentEdges(benchmark::State& state) {
+  const size_t num_segments = state.range(0);
+  ObjectUpdateFunctor functor(getFunctorConfig(state.range(1) / 100.0));
+  // roughly constant density as the number of segments grows
+  const double extent = 2.0 * std::cbrt(static_cast<double>(num_segments));
+
+  size_t num_edges = 0;
+  for (auto _ : state) {
+    state.PauseTiming();
+    hydra::SharedDsgInfo info({{DsgLayers::SEGMENTS, 's'},
+                               {DsgLayers::OBJECTS, 'o'},
+                               {DsgLayers::PLACES, 'p'}});
+    addRandomSegments(*info.graph, num_segments, extent, 1.0, 16);
+    state.ResumeTiming();
+
+    functor.addSegmentEdges(*info.graph);
+    num_edges = info.graph->getLayer(DsgLayers::SEGMENTS).numEdges();
+  }
+
+  state.counters["edges"] = num_edges;
+}
+
+BENCHMARK(BM_AddSegmentEdges)
+    ->ArgsProduct({{100, 1000, 5000}, {0, 50, 100}})
+    ->Unit(benchmark::kMillisecond);
+
+// args: grid side, recycle the component between iterations (0 or 1)
+void BM_ClusterComponent(benchmark::State& state) {
+  const size_t side = state.range(0);
+  const bool recycle = state.range(1) != 0;
+  const size_t dim = 32;
+  const auto layer = makeGridLayer(side, side);
+  const auto embeddings = makeEmbeddings(*layer, dim, 4);
+  const auto tasks = makeTasks(10, dim);
+  const hydra::CosineDistance metric;
+
+  std::vector<NodeId> nodes;
+  Eigen::MatrixXf features(dim, embeddings.size());
+  for (const auto& [node_id, feature] : embeddings) {
+    features.col(nodes.size()) = feature;
+    nodes.push_back(node_id);
+  }
+
+  IBEdgeSelector::Config config;
+  config.max_delta = 0.05;
+  config.py_x.score_threshold = 0.1;
+  // the component is the only one in the map
+  const auto py_x = computeIBpyGivenX(features, tasks, metric, config.py_x);
+  const Eigen::VectorXd px =
+      Eigen::VectorXd::Constant(nodes.size(), 1.0 / nodes.size());
+  const double I_xy = mutualInformation(computeIBpy(tasks), px, py_x);
+
+  const AgglomerationConfig agglomeration;
+  auto component = std::make_unique<ComponentInfo>(config);
+  size_t num_allocations = 0;
+  for (auto _ : state) {
+    const auto start = numAllocations();
+    if (!recycle) {
+      component = std::make_unique<ComponentInfo>(config);
+    }
+
+    component->cluster(
+        agglomeration, tasks, metric, *layer, nodes, features, I_xy, 1.0);
+    num_allocations += numAllocations() - start;
+    benchmark::DoNotOptimize(component->ws.parents.data());
+  }
+
+  state.counters["nodes"] = nodes.size();
+  state.counters["edges"] = layer->numEdges();
+  if (countsAllocations()) {
+    state.counters["allocations"] =
+        benchmark::Counter(num_allocations, benchmark::Counter::kAvgIterations);
+  }
+}
+
+BENCHMARK(BM_ClusterComponent)
+    ->ArgsProduct({{8, 16, 32}, {0, 1}})
+    ->Unit(benchmark::kMicrosecond);
+
+// args: number of objects, vertices per object
+void BM_MergeObjectAttributes(benchmark::State& state) {
+  std::vector<KhronosObjectAttributes> objects;
+  for (int64_t i = 0; i < state.range(0); ++i) {
+    const Eigen::Vector3f offset(0.5f * i, 0.0f, 0.0f);
+    objects.push_back(makeObject(state.range(1), offset, i));
+  }
+
+  std::vector<const KhronosObjectAttributes*> to_merge;
+  for (size_t i = 1; i < objects.size(); ++i) {
+    to_merge.push_back(&objects[i]);
+  }
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto merged = objects.front();
+    state.ResumeTiming();
+    mergeObjectAttributes(to_merge, merged);
+    benchmark::DoNotOptimize(merged.mesh.numVertices());
+  }
+
+  state.SetItemsProcessed(state.iterations() * state.range(0) * state.range(1));
+}
+
+BENCHMARK(BM_MergeObjectAttributes)
+    ->ArgsProduct({{2, 10, 50}, {300, 3000}})
+    ->Unit(benchmark::kMicrosecond);
+
+}  // namespace clio::benchmarks
@@ -0,0 +1,74 @@
+#include <benchmark/benchmark.h>
+#include <clio/probability_utilities.h>
+#include <clio/sparse_pmf.h>
+
+#include <random>
+
+namespace clio::benchmarks {
+
+namespace {
+
+// PMF with k entries carrying most of the mass over a tiny floor
+Eigen::VectorXd makePmf(size_t dim, size_t k, unsigned seed) {
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<size_t> index(0, dim - 1);
+  Eigen::VectorXd p = Eigen::VectorXd::Constant(dim, 1.0e-12);
+  for (size_t i = 0; i < k; ++i) {
+    p(index(rng)) += 1.0;
+  }
+
+  return p / p.sum();
+}
+
+}  // namespace
+
+// args: number of labels, number of distributions
+void BM_JensenShannonDivergence(benchmark::State& state) {
+  const size_t dim = state.range(0);
+  const size_t num_pmfs = state.range(1);
+  Eigen::MatrixXd pmfs(dim, num_pmfs);
+  for (size_t i = 0; i < num_pmfs; ++i) {
+    pmfs.col(i) = makePmf(dim, 3, i);
+  }
+
+  const Eigen::VectorXd priors = Eigen::VectorXd::Constant(num_pmfs, 1.0 / num_pmfs);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(jensenShannonDivergence(pmfs, priors));
+  }
+}
+
+BENCHMARK(BM_JensenShannonDivergence)->ArgsProduct({{10, 100, 1000}, {2, 8}});
+
+// args: number of labels, representation (0: double, 1: float, 2: sparse)
+void BM_PairwiseJensenShannonDivergence(benchmark::State& state) {
+  const size_t dim = state.range(0);
+  const auto p1 = makePmf(dim, 3, 0);
+  const auto p2 = makePmf(dim, 3, 1);
+  const Eigen::VectorXf f1 = p1.cast<float>();
+  const Eigen::VectorXf f2 = p2.cast<float>();
+  const auto s1 = SparsePmf::fromDense(p1, p1.minCoeff());
+  const auto s2 = SparsePmf::fromDense(p2, p2.minCoeff());
+  const auto H1 = mixtureEntropy(p1, p1, 1.0, 0.0);
+  const auto H2 = mixtureEntropy(p2, p2, 1.0, 0.0);
+  for (auto _ : state) {
+    switch (state.range(1)) {
+      case 0:
+        benchmark::DoNotOptimize(
+            pairwiseJensenShannonDivergence(p1, p2, 0.5, 0.5, H1, H2));
+        break;
+      case 1:
+        benchmark::DoNotOptimize(
+            pairwiseJensenShannonDivergence(f1, f2, 0.5, 0.5, H1, H2));
+        break;
+      default:
+        benchmark::DoNotOptimize(
+            pairwiseJensenShannonDivergence(s1, s2, 0.5, 0.5, H1, H2));
+        break;
+    }
+  }
+}
+
+BENCHMARK(BM_PairwiseJensenShannonDivergence)
+    ->ArgsProduct({{10, 100, 1000}, {0, 1, 2}});
+
+}  // namespace clio::benchmarks
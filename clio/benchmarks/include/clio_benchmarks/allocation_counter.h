@@ -0,0 +1,19 @@
+#pragma once
+#include <cstddef>
+
+namespace clio::benchmarks {
+
+/**
+ * @brief Number of heap allocations made by the process so far
+ *
+ * Calls to malloc are counted, which covers operator new as well as Eigen storage.
+ * Counting is only available with glibc (numAllocations always returns 0
+ * otherwise), and every thread shares the counter, so only differences over a
+ * single-threaded section are meaningful.
+ */
+size_t numAllocations();
+
+//! Whether numAllocations actually counts allocations
+bool countsAllocations();
+
+}  // namespace clio::benchmarks
@@ -0,0 +1,94 @@
+#pragma once
+#include <config_utilities/factory.h>
+#include <config_utilities/virtual_config.h>
+#include <hydra/openset/embedding_group.h>
+#include <spark_dsg/dynamic_scene_graph.h>
+#include <spark_dsg/node_attributes.h>
+#include <spark_dsg/scene_graph_layer.h>
+
+#include <memory>
+#include <string>
+
+#include "clio/clustering_workspace.h"
+
+namespace clio::benchmarks {
+
+using LayerPtr = std::unique_ptr<spark_dsg::IsolatedSceneGraphLayer>;
+
+/**
+ * @brief Random unit-norm task embeddings usable through the embedding factory
+ */
+struct RandomEmbeddingGroup : public hydra::EmbeddingGroup {
+  struct Config {
+    size_t num_embeddings = 10;
+    size_t dim = 16;
+    unsigned seed = 0;
+  };
+
+  explicit RandomEmbeddingGroup(const Config& config);
+
+  static config::VirtualConfig<hydra::EmbeddingGroup> getConfig(size_t num_embeddings,
+                                                                size_t dim,
+                                                                unsigned seed = 0);
+
+ private:
+  inline static const auto registration_ =
+      config::RegistrationWithConfig<hydra::EmbeddingGroup,
+                                     RandomEmbeddingGroup,
+                                     Config>("benchmark_group");
+};
+
+void declare_config(RandomEmbeddingGroup::Config& config);
+
+/**
+ * @brief 4-connected grid of width x height nodes (spaced 1m apart)
+ */
+LayerPtr makeGridLayer(size_t width, size_t height);
+
+/**
+ * @brief Nodes uniformly sampled in the unit square connected to every node closer
+ * than a radius that gives the requested average degree
+ */
+LayerPtr makeRandomGeometricLayer(size_t num_nodes, double degree, unsigned seed = 0);
+
+/**
+ * @brief Copy a layer (nodes, attributes and edges) out of a saved scene graph
+ */
+LayerPtr loadLayer(const std::string& filepath, spark_dsg::LayerId layer_id);
+
+/**
+ * @brief Random features drawn around num_groups centers
+ *
+ * Centers are assigned by node position along x so that neighboring nodes tend to
+ * share a group (which gives clustering something to merge).
+ */
+ClusteringWorkspace::NodeEmbeddings makeEmbeddings(
+    const spark_dsg::SceneGraphLayer& layer,
+    size_t dim,
+    size_t num_groups,
+    unsigned seed = 0);
+
+hydra::EmbeddingGroup makeTasks(size_t num_tasks, size_t dim, unsigned seed = 0);
+
+Eigen::MatrixXf makeFeatures(size_t num_features, size_t dim, unsigned seed = 0);
+
+/**
+ * @brief Add segments with random boxes (of edge length up to max_size) spread over
+ * a cube of the given extent
+ */
+void addRandomSegments(spark_dsg::DynamicSceneGraph& graph,
+                       size_t num_segments,
+                       double extent,
+                       double max_size,
+                       size_t dim,
+                       unsigned seed = 0);
+
+/**
+ * @brief Object with a random mesh of num_vertices vertices (and num_vertices / 3
+ * faces) inside a unit box at offset
+ */
+spark_dsg::KhronosObjectAttributes makeObject(size_t num_vertices,
+                                              const Eigen::Vector3f& offset,
+                                              unsigned seed = 0);
+
+}  // namespace clio::benchmarks
@@ -0,0 +1,60 @@
+#include <benchmark/benchmark.h>
+#include <clio/agglomerative_clustering.h>
+#include <clio/ib_edge_selector.h>
+#include <glog/logging.h>
+
+#include <cstdlib>
+
+#include "clio_benchmarks/graph_generators.h"
+
+// Usage: clio_benchmarks [--benchmark_filter=<regex>] [--benchmark_out=results.json
+// --benchmark_out_format=json]
+//
+// Setting CLIO_BENCHMARK_GRAPH to a saved scene graph additionally benchmarks
+// clustering the segments of that graph.
+
+namespace {
+
+void registerGraphBenchmarks(const std::string& filepath) {
+  std::shared_ptr<const spark_dsg::SceneGraphLayer> layer =
+      clio::benchmarks::loadLayer(filepath, spark_dsg::DsgLayers::SEGMENTS);
+  benchmark::RegisterBenchmark(
+      "BM_ClusterGraphFile",
+      [layer](benchmark::State& state) {
+        const auto dim = clio::ClusteringWorkspace(*layer).featureDim();
+        const auto tasks = clio::benchmarks::makeTasks(state.range(0), dim);
+        const hydra::CosineDistance metric;
+        clio::IBEdgeSelector::Config config;
+        for (auto _ : state) {
+          clio::ClusteringWorkspace ws(*layer);
+          clio::IBEdgeSelector selector(config);
+          clio::clusterAgglomerative(ws, tasks, selector, metric);
+          benchmark::DoNotOptimize(ws.getClusters());
+        }
+
+        state.counters["nodes"] = layer->numNodes();
+        state.counters["edges"] = layer->numEdges();
+      })
+      ->Arg(10)
+      ->Arg(100)
+      ->Unit(benchmark::kMillisecond);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  google::InitGoogleLogging(argv[0]);
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+
+  const char* graph_path = std::getenv("CLIO_BENCHMARK_GRAPH");
+  if (graph_path) {
+    registerGraphBenchmarks(graph_path);
+  }
+
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
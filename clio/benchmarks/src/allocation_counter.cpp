@@ -0,0 +1,38 @@
+#include "clio_benchmarks/allocation_counter.h"
+
+#include <atomic>
+#include <cstdlib>
+
+namespace {
+
+std::atomic<size_t> num_allocations{0};
+
+}  // namespace
+
+#if defined(__GLIBC__)
+// the benchmark executable interposes malloc for every library it loads
+extern "C" {
+
+void* __libc_malloc(size_t size);
+
+void* malloc(size_t size) noexcept {
+  num_allocations.fetch_add(1, std::memory_order_relaxed);
+  return __libc_malloc(size);
+}
+
+}  // extern "C"
+#endif
+
+namespace clio::benchmarks {
+
+size_t numAllocations() { return num_allocations.load(std::memory_order_relaxed); }
+
+bool countsAllocations() {
+#if defined(__GLIBC__)
+  return true;
+#else
+  return false;
+#endif
+}
+
+}  // namespace clio::benchmarks
@@ -0,0 +1,232 @@
+#include "clio_benchmarks/graph_generators.h"
+
+#include <config_utilities/config.h>
+#include <glog/logging.h>
+#include <spark_dsg/scene_graph_types.h>
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <random>
+
+namespace clio::benchmarks {
+
+using namespace spark_dsg;
+
+namespace {
+
+Eigen::VectorXf getRandomVector(size_t dim, std::mt19937& rng, float stddev = 1.0f) {
+  std::normal_distribution<float> dist(0.0f, stddev);
+  Eigen::VectorXf vec(dim);
+  for (size_t i = 0; i < dim; ++i) {
+    vec(i) = dist(rng);
+  }
+
+  return vec;
+}
+
+}  // namespace
+
+RandomEmbeddingGroup::RandomEmbeddingGroup(const Config& config) {
+  auto tasks = makeTasks(config.num_embeddings, config.dim, config.seed);
+  embeddings = std::move(tasks.embeddings);
+  names = std::move(tasks.names);
+}
+
+config::VirtualConfig<hydra::EmbeddingGroup> RandomEmbeddingGroup::getConfig(
+    size_t num_embeddings, size_t dim, unsigned seed) {
+  Config config;
+  config.num_embeddings = num_embeddings;
+  config.dim = dim;
+  config.seed = seed;
+  return {config, "benchmark_group"};
+}
+
+void declare_config(RandomEmbeddingGroup::Config& config) {
+  using namespace config;
+  name("RandomEmbeddingGroup::Config");
+  field(config.num_embeddings, "num_embeddings");
+  field(config.dim, "dim");
+  field(config.seed, "seed");
+}
+
+LayerPtr makeGridLayer(size_t width, size_t height) {
+  auto layer = std::make_unique<IsolatedSceneGraphLayer>(DsgLayers::SEGMENTS);
+  for (size_t y = 0; y < height; ++y) {
+    for (size_t x = 0; x < width; ++x) {
+      auto attrs = std::make_unique<NodeAttributes>();
+      attrs->position << x, y, 0.0;
+      layer->emplaceNode(y * width + x, std::move(attrs));
+    }
+  }
+
+  for (size_t y = 0; y < height; ++y) {
+    for (size_t x = 0; x < width; ++x) {
+      const auto node = y * width + x;
+      if (x + 1 < width) {
+        layer->insertEdge(node, node + 1);
+      }
+
+      if (y + 1 < height) {
+        layer->insertEdge(node, node + width);
+      }
+    }
+  }
+
+  return layer;
+}
+
+LayerPtr makeRandomGeometricLayer(size_t num_nodes, double degree, unsigned seed) {
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<double> dist(0.0, 1.0);
+  std::vector<Eigen::Vector2d> points(num_nodes);
+  for (auto& point : points) {
+    point << dist(rng), dist(rng);
+  }
+
+  auto layer = std::make_unique<IsolatedSceneGraphLayer>(DsgLayers::SEGMENTS);
+  for (size_t i = 0; i < num_nodes; ++i) {
+    auto attrs = std::make_unique<NodeAttributes>();
+    attrs->position << points[i].x(), points[i].y(), 0.0;
+    layer->emplaceNode(i, std::move(attrs));
+  }
+
+  // expected degree is N * pi * r^2 (ignoring boundary effects)
+  const double radius = std::sqrt(degree / (M_PI * std::max<size_t>(num_nodes, 1)));
+  std::vector<size_t> order(num_nodes);
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](size_t lhs, size_t rhs) {
+    return points[lhs].x() < points[rhs].x();
+  });
+
+  // sweep along x so only nodes within the radius band are compared
+  for (size_t i = 0; i < num_nodes; ++i) {
+    const auto& point = points[order[i]];
+    for (size_t j = i + 1; j < num_nodes; ++j) {
+      const auto& other = points[order[j]];
+      if (other.x() - point.x() > radius) {
+        break;
+      }
+
+      if ((other - point).norm() <= radius) {
+        layer->insertEdge(order[i], order[j]);
+      }
+    }
+  }
+
+  return layer;
+}
+
+LayerPtr loadLayer(const std::string& filepath, LayerId layer_id) {
+  const auto graph = DynamicSceneGraph::load(filepath);
+  CHECK(graph) << "failed to load scene graph from '" << filepath << "'";
+  const auto& layer = graph->getLayer(layer_id);
+
+  auto copy = std::make_unique<IsolatedSceneGraphLayer>(layer_id);
+  for (const auto& [node_id, node] : layer.nodes()) {
+    copy->emplaceNode(node_id, node->attributes().clone());
+  }
+
+  for (const auto& id_edge_pair : layer.edges()) {
+    const auto& edge = id_edge_pair.second;
+    copy->insertEdge(edge.source, edge.target);
+  }
+
+  return copy;
+}
+
+ClusteringWorkspace::NodeEmbeddings makeEmbeddings(const SceneGraphLayer& layer,
+                                                   size_t dim,
+                                                   size_t num_groups,
+                                                   unsigned seed) {
+  std::mt19937 rng(seed);
+  std::vector<Eigen::VectorXf> centers;
+  for (size_t i = 0; i < std::max<size_t>(num_groups, 1); ++i) {
+    centers.push_back(getRandomVector(dim, rng));
+  }
+
+  double x_min = std::numeric_limits<double>::max();
+  double x_max = std::numeric_limits<double>::lowest();
+  for (const auto& id_node_pair : layer.nodes()) {
+    const auto x = id_node_pair.second->attributes().position.x();
+    x_min = std::min(x_min, x);
+    x_max = std::max(x_max, x);
+  }
+
+  ClusteringWorkspace::NodeEmbeddings embeddings;
+  const double range = std::max(x_max - x_min, 1.0e-6);
+  for (const auto& [node_id, node] : layer.nodes()) {
+    const auto ratio = (node->attributes().position.x() - x_min) / range;
+    const auto group = std::min<size_t>(ratio * centers.size(), centers.size() - 1);
+    embeddings[node_id] = centers[group] + getRandomVector(dim, rng, 0.3f);
+  }
+
+  return embeddings;
+}
+
+hydra::EmbeddingGroup makeTasks(size_t num_tasks, size_t dim, unsigned seed) {
+  std::mt19937 rng(seed);
+  hydra::EmbeddingGroup tasks;
+  for (size_t i = 0; i < num_tasks; ++i) {
+    tasks.embeddings.push_back(getRandomVector(dim, rng).normalized());
+    tasks.names.push_back("task_" + std::to_string(i));
+  }
+
+  return tasks;
+}
+
+Eigen::MatrixXf makeFeatures(size_t num_features, size_t dim, unsigned seed) {
+  std::mt19937 rng(seed);
+  Eigen::MatrixXf features(dim, num_features);
+  for (size_t i = 0; i < num_features; ++i) {
+    features.col(i) = getRandomVector(dim, rng);
+  }
+
+  return features;
+}
+
+void addRandomSegments(DynamicSceneGraph& graph,
+                       size_t num_segments,
+                       double extent,
+                       double max_size,
+                       size_t dim,
+                       unsigned seed) {
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<float> position(0.0f, extent);
+  std::uniform_real_distribution<float> size(0.1f * max_size, max_size);
+  for (size_t i = 0; i < num_segments; ++i) {
+    auto attrs = std::make_unique<KhronosObjectAttributes>();
+    const Eigen::Vector3f center(position(rng), position(rng), position(rng));
+    const Eigen::Vector3f half_size =
+        0.5f * Eigen::Vector3f(size(rng), size(rng), size(rng));
+    attrs->position = center.cast<double>();
+    attrs->bounding_box = BoundingBox(center - half_size, center + half_size);
+    attrs->semantic_feature = getRandomVector(dim, rng);
+    graph.emplaceNode(DsgLayers::SEGMENTS, NodeSymbol('s', i), std::move(attrs));
+  }
+}
+
+KhronosObjectAttributes makeObject(size_t num_vertices,
+                                   const Eigen::Vector3f& offset,
+                                   unsigned seed) {
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<float> dist(-0.5f, 0.5f);
+  KhronosObjectAttributes attrs;
+  attrs.bounding_box = BoundingBox(offset - Eigen::Vector3f::Constant(0.5f),
+                                   offset + Eigen::Vector3f::Constant(0.5f));
+  attrs.position = offset.cast<double>();
+
+  auto& mesh = attrs.mesh;
+  mesh.resizeVertices(num_vertices);
+  for (size_t v = 0; v < num_vertices; ++v) {
+    mesh.setPos(v, Eigen::Vector3f(dist(rng), dist(rng), dist(rng)));
+  }
+
+  for (size_t f = 0; f + 2 < num_vertices; f += 3) {
+    mesh.faces.push_back({f, f + 1, f + 2});
+  }
+
+  return attrs;
+}
+
+}  // namespace clio::benchmarks
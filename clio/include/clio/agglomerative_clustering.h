@@ -5,20 +5,49 @@
 #include <Eigen/Dense>
 
 #include "clio/cluster.h"
+#include "clio/clustering_stats.h"
 #include "clio/clustering_workspace.h"
+#include "clio/dendrogram.h"
 #include "clio/ib_edge_selector.h"
 #include "clio/scene_graph_types.h"
+#include "clio/task_index.h"
+#include "clio/thread_pool.h"
 
 namespace clio {
 
-void clusterAgglomerative(ClusteringWorkspace& ws,
-                          const hydra::EmbeddingGroup& tasks,
-                          EdgeSelector& edge_selector,
-                          const hydra::EmbeddingDistance& metric,
-                          bool reweight = false,
-                          double I_xy = -1,
-                          double delta_weight = 1,
-                          int verbosity = 5);
+struct AgglomerationConfig {
+  // use a heap to find the best edge instead of scanning every edge per merge
+  bool use_edge_queue = true;
+  // merge batches of disjoint, non-adjacent edges per round (see BatchMergeScheduler)
+  bool batch_merges = false;
+  // minimum edges per parallel scoring work item (fewer edges are scored serially)
+  size_t scoring_grain_size = 512;
+};
+
+void declare_config(AgglomerationConfig& config);
+
+/**
+ * @brief Greedily merge the best edge of the workspace until the selector stops
+ *
+ * Edges are scored on the pool if one is provided (see scoreEdges). If a dendrogram
+ * is provided, merging continues past the stopping criterion until no edges are
+ * left and every merge is recorded with its delta (merges are never batched in
+ * this case). The selector has to report merge deltas (see
+ * EdgeSelector::lastMergeDelta) for this.
+ *
+ * @returns Number of edges scored, merges performed and per-phase times
+ */
+ClusteringStats clusterAgglomerative(ClusteringWorkspace& ws,
+                                     const hydra::EmbeddingGroup& tasks,
+                                     EdgeSelector& edge_selector,
+                                     const hydra::EmbeddingDistance& metric,
+                                     bool reweight = false,
+                                     double I_xy = -1,
+                                     double delta_weight = 1,
+                                     int verbosity = 5,
+                                     const AgglomerationConfig& config = {},
+                                     ThreadPool* pool = nullptr,
+                                     Dendrogram* dendrogram = nullptr);
 
 class AgglomerativeClustering {
  public:
@@ -30,7 +59,11 @@ class AgglomerativeClustering {
     config::VirtualConfig<hydra::EmbeddingDistance> metric{
         hydra::CosineDistance::Config()};
     IBEdgeSelector::Config selector;
+    AgglomerationConfig agglomeration;
+    TaskIndex::Config task_index;
     bool filter_regions = false;
+    // threads used to score edges (see AgglomerationConfig::scoring_grain_size)
+    size_t num_threads = 1;
   } const config;
 
   AgglomerativeClustering(const Config& config);
@@ -38,13 +71,77 @@ class AgglomerativeClustering {
   Clusters cluster(const spark_dsg::SceneGraphLayer& layer,
                    const NodeEmbeddingMap& embeddings) const;
 
+  /**
+   * @brief Cluster a subset of a larger set of nodes
+   *
+   * Merge deltas are reweighted so that the stopping criterion matches clustering
+   * the subset as part of the full set of nodes. Pending tasks are not applied:
+   * callers keep state scored against the current tasks and switch tasks themselves
+   * via updateTasks.
+   *
+   * @param layer Layer to take edges from
+   * @param embeddings Features for the subset of nodes to cluster
+   * @param I_xy_full I(X;Y) over the full set of nodes
+   * @param delta_weight Fraction of the full set of nodes in the subset
+   */
+  Clusters cluster(const spark_dsg::SceneGraphLayer& layer,
+                   const NodeEmbeddingMap& embeddings,
+                   double I_xy_full,
+                   double delta_weight) const;
+
+  /**
+   * @brief Cluster until no edges are left, recording every merge
+   *
+   * Cutting the result at config.selector.max_delta gives the same clusters as
+   * cluster (without batch_merges), and any other cut only takes O(N).
+   */
+  Dendrogram buildDendrogram(const spark_dsg::SceneGraphLayer& layer,
+                             const NodeEmbeddingMap& embeddings) const;
+
   Clusters getClusters(const ClusteringWorkspace& workspace,
                        const NodeEmbeddingMap& features) const;
 
+  /**
+   * @brief Get the clusters of a dendrogram cut at max_delta
+   */
+  Clusters getClusters(const Dendrogram& dendrogram,
+                       double max_delta,
+                       const NodeEmbeddingMap& features) const;
+
+  /**
+   * @brief Replace the tasks (safe to call from any thread)
+   *
+   * The new tasks take effect at the start of the next call to cluster (for a full
+   * set of nodes), buildDendrogram or updateTasks.
+   */
+  void setTasks(hydra::EmbeddingGroup::Ptr tasks);
+
+  /**
+   * @brief Switch to the tasks most recently passed to setTasks (if any)
+   * @returns True if the tasks changed
+   */
+  bool updateTasks() const;
+
+  const hydra::EmbeddingGroup& tasks() const { return *tasks_; }
+
+  const hydra::EmbeddingDistance& metric() const { return *metric_; }
+
+  /**
+   * @brief Counters and times from the most recent call to cluster
+   */
+  const ClusteringStats& stats() const { return stats_; }
+
  private:
-  hydra::EmbeddingGroup::Ptr tasks_;
+  Clusters makeClusters(const std::vector<std::vector<NodeId>>& cluster_nodes,
+                        const NodeEmbeddingMap& features) const;
+
+  mutable hydra::EmbeddingGroup::Ptr tasks_;
   std::unique_ptr<hydra::EmbeddingDistance> metric_;
+  mutable std::unique_ptr<TaskIndex> task_index_;
+  mutable PendingTasks pending_tasks_;
   EdgeSelector::Ptr edge_selector_;
+  ThreadPool::Ptr pool_;
+  mutable ClusteringStats stats_;
 };
 
 void declare_config(AgglomerativeClustering::Config& config);
@@ -0,0 +1,99 @@
+#pragma once
+#include <spark_dsg/scene_graph_layer.h>
+
+#include <chrono>
+#include <future>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "clio/scene_graph_types.h"
+
+namespace clio {
+
+/**
+ * @brief A single unit of work running on its own thread with a result to collect
+ *
+ * At most one call is in flight at a time. The destructor waits for the call to
+ * finish, so owners should declare the job after everything the call refers to.
+ */
+template <typename Result>
+class AsyncJob {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  AsyncJob() = default;
+
+  ~AsyncJob() { wait(); }
+
+  AsyncJob(const AsyncJob&) = delete;
+  AsyncJob& operator=(const AsyncJob&) = delete;
+
+  //! true if a call was started and its result hasn't been collected
+  bool running() const { return future_.valid(); }
+
+  //! true if a call was started and has finished
+  bool ready() const {
+    return running() &&
+           future_.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+  }
+
+  //! seconds since the current call was started
+  double elapsed() const {
+    return running() ? std::chrono::duration<double>(Clock::now() - start_).count()
+                     : 0.0;
+  }
+
+  /**
+   * @brief Start a call on a new thread (the previous result has to be collected)
+   * @returns False if a call is already in flight
+   */
+  template <typename Func>
+  bool start(Func&& func) {
+    if (running()) {
+      return false;
+    }
+
+    start_ = Clock::now();
+    future_ = std::async(std::launch::async, std::forward<Func>(func));
+    return true;
+  }
+
+  /**
+   * @brief Collect the result of the current call
+   *
+   * Exceptions thrown by the call are rethrown here.
+   *
+   * @param block Wait for the call to finish instead of only checking if it has
+   * @returns Result of the call (or nothing if no call has finished)
+   */
+  std::optional<Result> take(bool block) {
+    if (!running() || (!block && !ready())) {
+      return std::nullopt;
+    }
+
+    return future_.get();
+  }
+
+  void wait() const {
+    if (running()) {
+      future_.wait();
+    }
+  }
+
+ private:
+  Clock::time_point start_;
+  std::future<Result> future_;
+};
+
+/**
+ * @brief Copy the nodes and the edges between them (without any attributes)
+ *
+ * Clustering only needs the neighbors of each node, so a topology copy is enough to
+ * cluster a layer on another thread while the original layer keeps changing.
+ */
+std::unique_ptr<spark_dsg::IsolatedSceneGraphLayer> copyLayerTopology(
+    const spark_dsg::SceneGraphLayer& layer, const std::vector<NodeId>& nodes);
+
+}  // namespace clio
@@ -0,0 +1,83 @@
+#pragma once
+#include <config_utilities/factory.h>
+#include <hydra/openset/embedding_distances.h>
+#include <hydra/openset/embedding_group.h>
+#include <spark_dsg/dynamic_scene_graph.h>
+
+#include <string>
+
+#include "clio/agglomerative_clustering.h"
+#include "clio/clustering_stats.h"
+#include "clio/ib_edge_selector.h"
+
+namespace clio {
+
+/**
+ * @brief Task embeddings read from a file instead of a task server
+ *
+ * Files are YAML with a list of task names and a matching list of embeddings (one
+ * list of numbers per task), as written by clio_batch/export_task_embeddings.py.
+ * Unreadable files leave the group empty.
+ */
+class FileEmbeddingGroup : public hydra::EmbeddingGroup {
+ public:
+  struct Config {
+    std::string path;
+  } const config;
+
+  explicit FileEmbeddingGroup(const Config& config);
+
+ private:
+  inline static const auto registration_ =
+      config::RegistrationWithConfig<hydra::EmbeddingGroup,
+                                     FileEmbeddingGroup,
+                                     FileEmbeddingGroup::Config>("FileEmbeddingGroup");
+};
+
+void declare_config(FileEmbeddingGroup::Config& config);
+
+struct BatchClusteringConfig {
+  IBEdgeSelector::Config selector;
+  AgglomerationConfig agglomeration;
+  // clusters scoring below this against every task do not become objects
+  double prune_threshold = 0.23;
+  // cluster each connected component of the segments separately
+  bool partition = false;
+  // cluster over edges between overlapping segment bounding boxes (the segment
+  // edges of the graph are used otherwise, unless there are none)
+  bool recompute_edges = false;
+  // fraction of each box dimension to grow both sides of a box by for overlap checks
+  double bbox_dilation = 0.0;
+  // cell size of the bounding box index used to recompute edges
+  double index_resolution = 1.0;
+};
+
+void declare_config(BatchClusteringConfig& config);
+
+struct BatchClusteringResult {
+  spark_dsg::DynamicSceneGraph::Ptr graph;
+  ClusteringStats stats;
+  size_t num_clusters = 0;
+  size_t num_objects = 0;
+};
+
+/**
+ * @brief Replace the objects of a graph with clusters of its segments
+ *
+ * Offline equivalent of clio_batch.object_cluster.cluster_3d. When partitioning,
+ * merge deltas are reweighted so that each component stops where clustering every
+ * segment at once would. Cluster i becomes object O<i> (with edges to its segments)
+ * if it scores at least prune_threshold against a task, so object IDs can have gaps.
+ *
+ * @param graph Graph to cluster the segments of (not modified)
+ * @param tasks Task embeddings
+ * @param metric Metric to score segments against tasks with
+ * @param config Clustering parameters
+ * @returns Copy of the graph with the new objects
+ */
+BatchClusteringResult clusterSegments(const spark_dsg::DynamicSceneGraph& graph,
+                                      const hydra::EmbeddingGroup& tasks,
+                                      const hydra::EmbeddingDistance& metric,
+                                      const BatchClusteringConfig& config);
+
+}  // namespace clio
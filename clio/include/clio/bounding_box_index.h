@@ -0,0 +1,81 @@
+#pragma once
+#include <Eigen/Geometry>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "clio/scene_graph_types.h"
+
+namespace clio {
+
+/**
+ * @brief Uniform voxel hash over axis-aligned boxes for overlap queries
+ *
+ * Each box is stored in every cell it touches. Boxes that would touch more than
+ * max_cells_per_box cells (including unbounded boxes) are kept in a separate list
+ * that every query checks.
+ */
+class BoundingBoxIndex {
+ public:
+  using Box = Eigen::AlignedBox3f;
+
+  explicit BoundingBoxIndex(double cell_size = 1.0, size_t max_cells_per_box = 512);
+
+  /**
+   * @brief Add a box to the index (replacing any previous box for the node)
+   */
+  void insert(NodeId node, const Box& box);
+
+  /**
+   * @brief Remove a node from the index
+   * @returns true if the node was present
+   */
+  bool erase(NodeId node);
+
+  /**
+   * @brief Get the stored box for a node (or nullptr if not present)
+   */
+  const Box* getBox(NodeId node) const;
+
+  /**
+   * @brief Find every node whose box overlaps the query box
+   * @returns node IDs in ascending order
+   */
+  std::vector<NodeId> query(const Box& box) const;
+
+  size_t size() const { return boxes_.size(); }
+
+  const std::unordered_map<NodeId, Box>& boxes() const { return boxes_; }
+
+ private:
+  struct CellRange {
+    Eigen::Vector3i min;
+    Eigen::Vector3i max;
+    double numCells() const;
+  };
+
+  struct CellHash {
+    size_t operator()(const Eigen::Vector3i& index) const;
+  };
+
+  CellRange getRange(const Box& box) const;
+
+  template <typename Func>
+  void forEachCell(const CellRange& range, const Func& func) const {
+    for (int x = range.min.x(); x <= range.max.x(); ++x) {
+      for (int y = range.min.y(); y <= range.max.y(); ++y) {
+        for (int z = range.min.z(); z <= range.max.z(); ++z) {
+          func(Eigen::Vector3i(x, y, z));
+        }
+      }
+    }
+  }
+
+  const float cell_size_;
+  const size_t max_cells_per_box_;
+  std::unordered_map<NodeId, Box> boxes_;
+  std::unordered_set<NodeId> oversized_;
+  std::unordered_map<Eigen::Vector3i, std::vector<NodeId>, CellHash> cells_;
+};
+
+}  // namespace clio
@@ -8,9 +8,9 @@ namespace clio {
 struct Cluster {
   using Ptr = std::shared_ptr<Cluster>;
   std::set<uint64_t> nodes;
-  double score;
+  double score = 0.0;
   Eigen::VectorXf feature;
-  size_t best_task_index;
+  size_t best_task_index = 0;
   std::string best_task_name;
 };
 
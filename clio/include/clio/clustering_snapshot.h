@@ -0,0 +1,70 @@
+#pragma once
+#include <hydra/openset/embedding_group.h>
+
+#include <Eigen/Dense>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "clio/scene_graph_types.h"
+
+namespace clio {
+
+/**
+ * @brief Clustering state of an ObjectUpdateFunctor that can be saved next to a DSG
+ *
+ * The file is a fixed header followed by length-prefixed arrays. Every scalar is 8
+ * bytes and every array is padded to a multiple of 8 bytes, so all arrays (including
+ * the column-major feature and p(y|x) matrices) are aligned and can be mapped
+ * directly. Values are stored in native (little-endian) byte order.
+ */
+struct ObjectClusteringSnapshot {
+  //! incremented whenever the layout changes (older files are rejected)
+  static constexpr uint64_t kVersion = 1;
+
+  struct Component {
+    std::vector<NodeId> segments;
+    //! object node IDs and the (sorted) segments merged into each object
+    std::map<NodeId, std::vector<NodeId>> objects;
+  };
+
+  //! identifies the tasks that the cached p(y|x) were computed with
+  uint64_t task_fingerprint = 0;
+  NodeId next_object_id = 0;
+  std::vector<Component> components;
+  //! objects waiting to be reconciled (and their segments)
+  std::map<NodeId, std::vector<NodeId>> previous_objects;
+  std::vector<NodeId> ignored;
+  std::vector<NodeId> active;
+  //! cached segment statistics, where column i belongs to stat_nodes[i]
+  std::vector<NodeId> stat_nodes;
+  Eigen::MatrixXf features;
+  Eigen::MatrixXd py_x;
+  Eigen::VectorXd information;
+
+  /**
+   * @brief Write the snapshot to a file (replacing any existing file)
+   *
+   * The snapshot is written to "<filepath>.tmp" first and then renamed, so the
+   * previous file stays intact if writing fails part way.
+   *
+   * @returns False if the file couldn't be written
+   */
+  bool save(const std::string& filepath) const;
+
+  /**
+   * @brief Read a snapshot written by save
+   * @returns Snapshot (or nothing if the file is missing, truncated or has another
+   * version)
+   */
+  static std::optional<ObjectClusteringSnapshot> load(const std::string& filepath);
+};
+
+/**
+ * @brief Hash of the task names and embeddings (FNV-1a)
+ */
+uint64_t getTaskFingerprint(const hydra::EmbeddingGroup& tasks);
+
+}  // namespace clio
@@ -0,0 +1,81 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <ostream>
+#include <string>
+
+namespace clio {
+
+/**
+ * @brief Work counters and per-phase times for clustering and functor updates
+ *
+ * Filled in with plain increments and a few clock reads per phase, so they are
+ * always collected. Times are accumulated per call (and summed over components),
+ * which keeps them usable from worker threads where named hydra timers are not.
+ */
+struct ClusteringStats {
+  using Duration = std::chrono::nanoseconds;
+
+  size_t edges_scored = 0;
+  size_t merges = 0;
+  //! sequential merge rounds (a batch of merges counts as a single round)
+  size_t rounds = 0;
+  size_t components_clustered = 0;
+  //! new ComponentInfo allocations (components not taken from the free list)
+  size_t components_allocated = 0;
+  size_t segments_compared = 0;
+  //! mesh vertices of segments merged into another segment or an existing object
+  size_t vertices_merged = 0;
+  //! selector setup (mostly computing p(y|x))
+  Duration setup_time{0};
+  //! scoring the initial edges
+  Duration scoring_time{0};
+  //! merge loop (including rescoring changed edges)
+  Duration merge_time{0};
+
+  ClusteringStats& operator+=(const ClusteringStats& other);
+};
+
+std::ostream& operator<<(std::ostream& out, const ClusteringStats& stats);
+
+/**
+ * @brief Writes the stats of every update as a CSV row into the hydra log directory
+ *
+ * Phases of the functors are also timed with named hydra timers. This log adds the
+ * counters and the clustering times that are summed over components. Nothing is
+ * written if hydra logging is not set up.
+ */
+class ClusteringStatsLog {
+ public:
+  //! rows go to <log dir>/backend/<name>_stats.csv (opened on the first record)
+  explicit ClusteringStatsLog(const std::string& name);
+
+  void record(uint64_t timestamp_ns, const ClusteringStats& stats);
+
+ private:
+  const std::string name_;
+  bool initialized_ = false;
+  std::unique_ptr<std::ofstream> file_;
+};
+
+/**
+ * @brief Adds the time between construction and destruction to a duration
+ */
+class PhaseTimer {
+ public:
+  explicit PhaseTimer(ClusteringStats::Duration& total)
+      : total_(total), start_(std::chrono::steady_clock::now()) {}
+
+  ~PhaseTimer() { total_ += std::chrono::steady_clock::now() - start_; }
+
+  PhaseTimer(const PhaseTimer&) = delete;
+  PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+ private:
+  ClusteringStats::Duration& total_;
+  const std::chrono::steady_clock::time_point start_;
+};
+
+}  // namespace clio
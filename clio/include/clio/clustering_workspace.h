@@ -4,18 +4,35 @@
 #include <Eigen/Dense>
 #include <list>
 #include <map>
+#include <optional>
+#include <vector>
 
 #include "clio/scene_graph_types.h"
 
 namespace clio {
 
+/**
+ * @brief Pool the semantic features of each node into a single column
+ * @param layer Layer containing the nodes (attributes must be SemanticNodeAttributes)
+ * @param nodes Nodes to pool features for
+ * @returns DxN matrix where column i is the pooled feature for nodes[i]
+ */
+Eigen::MatrixXf getPooledFeatures(const spark_dsg::SceneGraphLayer& layer,
+                                  const std::vector<NodeId>& nodes);
+
 struct ClusteringWorkspace {
   using NodeEmbeddings = std::map<NodeId, Eigen::VectorXf>;
-  std::map<size_t, Eigen::VectorXf> features;
-  std::map<size_t, NodeId> node_lookup;
-  std::map<NodeId, size_t> order;
+  // DxN feature matrix (one column per workspace index)
+  Eigen::MatrixXf features;
+  // node IDs in ascending order (the position of a node is its workspace index)
+  std::vector<NodeId> node_lookup;
   std::map<EdgeKey, double> edges;
-  std::vector<size_t> assignments;
+  // union-find forest over workspace indices (roots are the cluster indices)
+  std::vector<size_t> parents;
+  // sorted adjacent clusters (only valid for roots)
+  std::vector<std::vector<size_t>> neighbors;
+
+  ClusteringWorkspace() = default;
 
   ClusteringWorkspace(const spark_dsg::SceneGraphLayer& layer,
                       const NodeEmbeddings& node_embeddings);
@@ -25,10 +42,46 @@ struct ClusteringWorkspace {
 
   ClusteringWorkspace(const spark_dsg::SceneGraphLayer& layer);
 
+  /**
+   * @brief Construct a workspace from precomputed features
+   * @param layer Layer to take edges from
+   * @param nodes Node IDs (workspace indices are assigned in sorted ID order)
+   * @param features DxN matrix where column i is the feature for nodes[i]
+   */
+  ClusteringWorkspace(const spark_dsg::SceneGraphLayer& layer,
+                      const std::vector<NodeId>& nodes,
+                      const Eigen::MatrixXf& features);
+
+  /**
+   * @brief Reinitialize the workspace from precomputed features
+   *
+   * Behaves like the equivalent constructor, but keeps the capacity of the node
+   * lookup, union-find forest, neighbor lists and (if the size matches) the feature
+   * matrix. Edge map nodes are still allocated again.
+   */
+  void reset(const spark_dsg::SceneGraphLayer& layer,
+             const std::vector<NodeId>& nodes,
+             const Eigen::MatrixXf& features);
+
+  /**
+   * @brief Reserve the per-node storage for a workspace of num_nodes nodes
+   */
+  void reserve(size_t num_nodes);
+
   size_t size() const;
 
   size_t featureDim() const;
 
+  /**
+   * @brief Look up the workspace index of a node
+   * @returns Index of the node (if the node is part of the workspace)
+   */
+  std::optional<size_t> getIndex(NodeId node_id) const;
+
+  size_t findRoot(size_t index) const;
+
+  std::vector<size_t> getAssignments() const;
+
   std::list<EdgeKey> addMerge(EdgeKey to_merge);
 
   std::vector<std::vector<NodeId>> getClusters() const;
@@ -0,0 +1,66 @@
+#pragma once
+#include <vector>
+
+#include "clio/scene_graph_types.h"
+
+namespace clio {
+
+/**
+ * @brief Merge sequence of an agglomerative clustering that ran to completion
+ *
+ * Cutting at max_delta keeps every merge before the first merge with a delta of at
+ * least max_delta, which is exactly where clusterAgglomerative stops for that
+ * max_delta with the sequential merge scheduler. One clustering pass can therefore
+ * be cut at any number of thresholds.
+ */
+class Dendrogram {
+ public:
+  struct Merge {
+    // workspace indices of the merged clusters (k2 joins k1)
+    EdgeKey edge;
+    double delta;
+  };
+
+  Dendrogram() = default;
+
+  /**
+   * @brief Clear all merges
+   * @param nodes Node ID for every workspace index
+   */
+  void reset(const std::vector<NodeId>& nodes);
+
+  void addMerge(EdgeKey edge, double delta);
+
+  size_t size() const { return nodes_.size(); }
+
+  const std::vector<NodeId>& nodes() const { return nodes_; }
+
+  const std::vector<Merge>& merges() const { return merges_; }
+
+  /**
+   * @brief Number of merges kept when cutting at max_delta (O(log N))
+   */
+  size_t numMerges(double max_delta) const;
+
+  /**
+   * @brief Root workspace index of every workspace index when cutting at max_delta
+   *
+   * Same layout as ClusteringWorkspace::getAssignments. Takes O(N).
+   */
+  std::vector<size_t> getAssignments(double max_delta) const;
+
+  /**
+   * @brief Node IDs of every cluster when cutting at max_delta
+   *
+   * Same order as ClusteringWorkspace::getClusters. Takes O(N).
+   */
+  std::vector<std::vector<NodeId>> getClusters(double max_delta) const;
+
+ private:
+  std::vector<NodeId> nodes_;
+  std::vector<Merge> merges_;
+  // running maximum of the merge deltas (non-decreasing, so cuts are a binary search)
+  std::vector<double> max_deltas_;
+};
+
+}  // namespace clio
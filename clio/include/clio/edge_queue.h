@@ -0,0 +1,104 @@
+#pragma once
+#include <map>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "clio/clustering_workspace.h"
+#include "clio/edge_selector.h"
+
+namespace clio {
+
+/**
+ * @brief Tracks edge scores for the workspace and finds the best edge to merge
+ *
+ * Ordering is delegated to EdgeSelector::compareEdges with ties broken by edge key
+ * so that all implementations pick the same edge as std::min_element would over the
+ * workspace edges
+ */
+class EdgeQueue {
+ public:
+  using Ptr = std::unique_ptr<EdgeQueue>;
+  using Entry = std::pair<EdgeKey, double>;
+
+  EdgeQueue(ClusteringWorkspace& ws, const EdgeSelector& selector);
+
+  virtual ~EdgeQueue() = default;
+
+  /**
+   * @brief Set (or replace) the score for an edge in the workspace
+   */
+  virtual void update(EdgeKey edge, double score) = 0;
+
+  /**
+   * @brief Get the best edge still present in the workspace (if any)
+   */
+  virtual std::optional<Entry> top() = 0;
+
+  /**
+   * @brief Get the current score of an edge (if it has been scored)
+   */
+  virtual std::optional<double> score(EdgeKey edge) const = 0;
+
+ protected:
+  bool better(const Entry& lhs, const Entry& rhs) const;
+
+  ClusteringWorkspace& ws_;
+  const EdgeSelector& selector_;
+};
+
+/**
+ * @brief Original behavior: scores live in the workspace and each query is a scan
+ */
+class LinearEdgeQueue : public EdgeQueue {
+ public:
+  LinearEdgeQueue(ClusteringWorkspace& ws, const EdgeSelector& selector);
+
+  void update(EdgeKey edge, double score) override;
+
+  std::optional<Entry> top() override;
+
+  std::optional<double> score(EdgeKey edge) const override;
+};
+
+/**
+ * @brief Binary heap of edge scores with lazy invalidation
+ *
+ * Rescoring an edge pushes a new entry and bumps the edge's stamp; entries with an
+ * out-of-date stamp or for edges no longer in the workspace are discarded as they
+ * reach the top of the heap.
+ */
+class HeapEdgeQueue : public EdgeQueue {
+ public:
+  HeapEdgeQueue(ClusteringWorkspace& ws, const EdgeSelector& selector);
+
+  void update(EdgeKey edge, double score) override;
+
+  std::optional<Entry> top() override;
+
+  std::optional<double> score(EdgeKey edge) const override;
+
+  size_t heapSize() const { return heap_.size(); }
+
+ private:
+  struct HeapEntry {
+    Entry entry;
+    size_t stamp;
+  };
+
+  struct Current {
+    double score;
+    size_t stamp;
+  };
+
+  bool isValid(const HeapEntry& entry) const;
+  void compact();
+
+  bool heapCompare(const HeapEntry& lhs, const HeapEntry& rhs) const;
+
+  size_t next_stamp_ = 0;
+  std::vector<HeapEntry> heap_;
+  std::map<EdgeKey, Current> current_;
+};
+
+}  // namespace clio
@@ -2,11 +2,16 @@
 #include <hydra/openset/embedding_distances.h>
 #include <hydra/openset/embedding_group.h>
 
+#include <optional>
+#include <vector>
+
 #include "clio/clustering_workspace.h"
 #include "clio/scene_graph_types.h"
 
 namespace clio {
 
+class ThreadPool;
+
 class EdgeSelector {
  public:
   using ScoreFunc = std::function<double(const Eigen::VectorXd&)>;
@@ -18,7 +23,8 @@ class EdgeSelector {
                      const hydra::EmbeddingGroup& tasks,
                      const hydra::EmbeddingDistance& metric) = 0;
 
-  virtual double scoreEdge(EdgeKey edge) = 0;
+  //! only reads selector state, so edges can be scored concurrently
+  virtual double scoreEdge(EdgeKey edge) const = 0;
 
   virtual bool updateFromEdge(EdgeKey edge) = 0;
 
@@ -28,7 +34,43 @@ class EdgeSelector {
 
   virtual void onlineReweighting(double param1, double param2) = 0;
 
+  /**
+   * @brief Start recording merges so that they can be undone by rollback
+   * @returns false if the selector can't undo merges
+   */
+  virtual bool checkpoint() { return false; }
+
+  /**
+   * @brief Undo every merge since the last checkpoint (and stop recording)
+   */
+  virtual void rollback() {}
+
+  /**
+   * @brief Keep every merge since the last checkpoint (and stop recording)
+   */
+  virtual void commit() {}
+
+  /**
+   * @brief Value checked against the stopping criterion for the most recent merge
+   * @returns Nothing if there was no merge or the selector doesn't track one
+   */
+  virtual std::optional<double> lastMergeDelta() const { return std::nullopt; }
+
   virtual std::string summarize() const = 0;
 };
 
+/**
+ * @brief Score a flat array of edges
+ *
+ * Edges are split into chunks of grain_size edges that are scored in parallel on the
+ * pool. Without a pool (or with at most grain_size edges) every edge is scored on
+ * the calling thread.
+ *
+ * @returns Scores in the same order as the edges
+ */
+std::vector<double> scoreEdges(const EdgeSelector& selector,
+                               const std::vector<EdgeKey>& edges,
+                               ThreadPool* pool = nullptr,
+                               size_t grain_size = 512);
+
 }  // namespace clio
@@ -2,6 +2,8 @@
 #include <config_utilities/factory.h>
 
 #include <Eigen/Dense>
+#include <Eigen/Sparse>
+#include <optional>
 
 #include "clio/edge_selector.h"
 #include "clio/ib_utils.h"
@@ -13,6 +15,14 @@ class IBEdgeSelector : public EdgeSelector {
   struct Config {
     double max_delta = 1.0e-3;
     double tolerance = -1.0e-18;
+    // merges between full recomputations of I(Z;Y) (0 to only update incrementally)
+    size_t mi_refresh_interval = 100;
+    // store p(y|x) and p(y|z) as sparse top-k columns (cost scales with top_k
+    // instead of the number of tasks)
+    bool sparse = false;
+    // store p(y|z) and evaluate entropies and divergences in float (p(z) and sums
+    // of mutual information terms stay in double; ignored when sparse)
+    bool single_precision = false;
     PyGivenXConfig py_x;
   };
 
@@ -24,7 +34,15 @@ class IBEdgeSelector : public EdgeSelector {
              const hydra::EmbeddingGroup& tasks,
              const hydra::EmbeddingDistance& metric) override;
 
-  double scoreEdge(EdgeKey edge) override;
+  /**
+   * @brief Reserve per-node storage (setup reserves for the workspace size)
+   *
+   * Only covers the per-merge vectors: setup computes new p(y|x) and p(y|z)
+   * matrices every time it is called.
+   */
+  void reserve(size_t num_nodes);
+
+  double scoreEdge(EdgeKey edge) const override;
 
   bool updateFromEdge(EdgeKey edge) override;
 
@@ -33,26 +51,86 @@ class IBEdgeSelector : public EdgeSelector {
 
   void onlineReweighting(double Ixy, double delta_weight) override;
 
+  bool checkpoint() override;
+
+  void rollback() override;
+
+  void commit() override;
+
+  std::optional<double> lastMergeDelta() const override;
+
   const Config config;
 
   std::string summarize() const override;
 
+  // p(z|x) as a sparse NxN matrix indexed by (x, z) (only built on request)
+  Eigen::SparseMatrix<double> getPzGivenX() const;
+
  protected:
   // p(x), p(z), p(y)
   Eigen::VectorXd px_;
   Eigen::VectorXd pz_;
   Eigen::VectorXd py_;
-  // p(z|x), p(y|x), p(y|z)
-  Eigen::MatrixXd pz_x_;  // NxN
-  Eigen::MatrixXd py_x_;  // 2xN
-  Eigen::MatrixXd py_z_;  // 2xN
+  // p(y|x), p(y|z) (left empty when using sparse columns, p(y|x) is scratch space
+  // when using single precision)
+  Eigen::MatrixXd py_x_;  // MxN
+  Eigen::MatrixXd py_z_;  // MxN
+  // p(y|z) and p(y) when using single precision
+  Eigen::MatrixXf py_z_float_;
+  Eigen::VectorXf py_float_;
+  // p(y|z) when using sparse columns
+  std::vector<SparsePmf> sparse_py_z_;
+  // H(p(y|z)) for every cluster
+  Eigen::VectorXd H_y_z_;
+  // p(z|x) is a hard assignment: merged clusters point to the cluster they joined
+  std::vector<size_t> pz_x_parents_;
   // mutual information caches
   double I_xy_;
   double I_zy_prev_;
+  // per-cluster contributions p(z) * D(p(y|z) || p(y)) to I(Z;Y)
+  Eigen::VectorXd I_zy_terms_;
+  size_t merges_since_refresh_ = 0;
   double delta_weight_ = 1.0;
   std::vector<double> deltas_;
 
  private:
+  // p(y|z) for a single cluster (only the representation in use is stored)
+  struct ClusterColumn {
+    Eigen::VectorXd dense;
+    Eigen::VectorXf single;
+    SparsePmf sparse;
+  };
+
+  // state of both clusters of an edge before the edge was merged
+  struct MergeRecord {
+    EdgeKey edge;
+    double p_s;
+    double p_t;
+    double H_s;
+    double H_t;
+    double I_s;
+    double I_t;
+    ClusterColumn py_s;
+    ClusterColumn py_t;
+  };
+
+  struct Checkpoint {
+    double I_zy_prev;
+    size_t merges_since_refresh;
+    size_t num_deltas;
+    std::vector<MergeRecord> merges;
+  };
+
+  ClusterColumn saveColumn(size_t z) const;
+  void restoreColumn(size_t z, ClusterColumn&& column);
+
+  double clusterEntropy(size_t z) const;
+  double clusterInformation(size_t z) const;
+  double clusterDivergence(EdgeKey edge, double w_s, double w_t) const;
+  void mergeClusters(EdgeKey edge, double p_s, double p_t);
+
+  std::optional<Checkpoint> checkpoint_;
+
   inline static const auto registration_ =
       config::RegistrationWithConfig<EdgeSelector,
                                      IBEdgeSelector,
@@ -8,6 +8,7 @@
 
 #include "clio/clustering_workspace.h"
 #include "clio/scene_graph_types.h"
+#include "clio/sparse_pmf.h"
 
 namespace clio {
 
@@ -18,11 +19,85 @@ struct PyGivenXConfig {
   bool null_task_preprune = true;
 };
 
+/**
+ * @brief Score every workspace feature against every task
+ *
+ * For hydra::CosineDistance this is a single product between the normalized task
+ * and feature matrices; other metrics (and zero-norm features) go through
+ * EmbeddingGroup::getScores one node at a time. Batched scores are computed in
+ * single precision and agree with the per-node path to within kBatchScoreTolerance.
+ *
+ * @param ws Workspace containing the features to score
+ * @param tasks Task embeddings
+ * @param metric Metric to use for scoring
+ * @param batched Allow the batched path (disable to force per-node scoring)
+ * @returns MxN matrix of scores for M tasks and N nodes
+ */
+Eigen::MatrixXf computeTaskScores(const ClusteringWorkspace& ws,
+                                  const hydra::EmbeddingGroup& tasks,
+                                  const hydra::EmbeddingDistance& metric,
+                                  bool batched = true);
+
+/**
+ * @brief Score a DxN matrix of features against every task (see above)
+ */
+Eigen::MatrixXf computeTaskScores(const Eigen::MatrixXf& features,
+                                  const hydra::EmbeddingGroup& tasks,
+                                  const hydra::EmbeddingDistance& metric,
+                                  bool batched = true);
+
+inline constexpr float kBatchScoreTolerance = 1.0e-5f;
+
 Eigen::MatrixXd computeIBpyGivenX(const ClusteringWorkspace& ws,
                                   const hydra::EmbeddingGroup& tasks,
                                   const hydra::EmbeddingDistance& metric,
                                   const PyGivenXConfig& config);
 
+/**
+ * @brief Compute p(y|x) for a DxN matrix of features
+ *
+ * Each column only depends on the corresponding feature, so columns can be computed
+ * for subsets of nodes and combined later.
+ */
+Eigen::MatrixXd computeIBpyGivenX(const Eigen::MatrixXf& features,
+                                  const hydra::EmbeddingGroup& tasks,
+                                  const hydra::EmbeddingDistance& metric,
+                                  const PyGivenXConfig& config);
+
+/**
+ * @brief Compute p(y|x) into caller-owned storage (see above)
+ *
+ * py_x only reallocates if its size changes.
+ */
+void computeIBpyGivenX(const Eigen::MatrixXf& features,
+                       const hydra::EmbeddingGroup& tasks,
+                       const hydra::EmbeddingDistance& metric,
+                       const PyGivenXConfig& config,
+                       Eigen::MatrixXd& py_x);
+
+/**
+ * @brief Compute p(y|x) for a DxN matrix of features as sparse columns
+ *
+ * Same distributions as the dense version, but only the (at most top_k) accumulated
+ * entries of each column are stored explicitly.
+ */
+std::vector<SparsePmf> computeSparseIBpyGivenX(const Eigen::MatrixXf& features,
+                                               const hydra::EmbeddingGroup& tasks,
+                                               const hydra::EmbeddingDistance& metric,
+                                               const PyGivenXConfig& config);
+
+/**
+ * @brief Compute sparse p(y|x) into caller-owned storage (see above)
+ *
+ * Existing columns are overwritten in place, so they keep the capacity of their
+ * entries.
+ */
+void computeSparseIBpyGivenX(const Eigen::MatrixXf& features,
+                             const hydra::EmbeddingGroup& tasks,
+                             const hydra::EmbeddingDistance& metric,
+                             const PyGivenXConfig& config,
+                             std::vector<SparsePmf>& py_x);
+
 Eigen::VectorXd computeIBpx(const ClusteringWorkspace& ws);
 
 Eigen::VectorXd computeIBpy(const hydra::EmbeddingGroup& tasks);
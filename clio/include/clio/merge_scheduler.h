@@ -0,0 +1,90 @@
+#pragma once
+#include <memory>
+#include <vector>
+
+#include "clio/clustering_stats.h"
+#include "clio/clustering_workspace.h"
+#include "clio/edge_queue.h"
+#include "clio/edge_selector.h"
+
+namespace clio {
+
+class ThreadPool;
+
+/**
+ * @brief Decides which edges of the workspace get merged each round
+ */
+class MergeScheduler {
+ public:
+  using Ptr = std::unique_ptr<MergeScheduler>;
+
+  /**
+   * @param pool Optional pool to rescore changed edges with
+   * @param grain_size Minimum number of edges per parallel work item
+   */
+  explicit MergeScheduler(ThreadPool* pool = nullptr, size_t grain_size = 512);
+
+  virtual ~MergeScheduler() = default;
+
+  /**
+   * @brief Merge edges until the selector stops or no edges are left
+   *
+   * Every edge in the workspace has to already be scored in the queue.
+   */
+  virtual void run(ClusteringWorkspace& ws,
+                   EdgeSelector& selector,
+                   EdgeQueue& queue,
+                   ClusteringStats& stats) const = 0;
+
+ protected:
+  void rescore(const std::vector<EdgeKey>& edges,
+               const EdgeSelector& selector,
+               EdgeQueue& queue,
+               ClusteringStats& stats) const;
+
+  ThreadPool* const pool_;
+  const size_t grain_size_;
+};
+
+/**
+ * @brief Original behavior: merge the best edge and rescore its neighbors each round
+ */
+class SequentialMergeScheduler : public MergeScheduler {
+ public:
+  using MergeScheduler::MergeScheduler;
+
+  void run(ClusteringWorkspace& ws,
+           EdgeSelector& selector,
+           EdgeQueue& queue,
+           ClusteringStats& stats) const override;
+};
+
+/**
+ * @brief Merge a batch of disjoint, mutually non-adjacent edges each round
+ *
+ * Edges are taken greedily in score order. No cluster in a batch neighbors a cluster
+ * of another edge in the batch, so merging one edge never changes the score of
+ * another and the whole batch is merged in a single sweep before rescoring. If any
+ * merge of a batch fails the stopping criterion, the batch is rolled back and the
+ * remaining merges are done sequentially, so clustering stops at the same criterion
+ * as the sequential scheduler. The same fallback is used once batches shrink to a
+ * single edge or if the selector can't roll back merges.
+ */
+class BatchMergeScheduler : public MergeScheduler {
+ public:
+  using MergeScheduler::MergeScheduler;
+
+  void run(ClusteringWorkspace& ws,
+           EdgeSelector& selector,
+           EdgeQueue& queue,
+           ClusteringStats& stats) const override;
+
+  /**
+   * @brief Get the edges for the next batch in merge order
+   */
+  static std::vector<EdgeKey> getBatch(const ClusteringWorkspace& ws,
+                                       const EdgeSelector& selector,
+                                       const EdgeQueue& queue);
+};
+
+}  // namespace clio
@@ -0,0 +1,86 @@
+#pragma once
+#include <hydra/openset/embedding_distances.h>
+#include <hydra/openset/embedding_group.h>
+
+#include <Eigen/Dense>
+#include <map>
+
+#include "clio/ib_utils.h"
+#include "clio/pooled_embedding_cache.h"
+#include "clio/scene_graph_types.h"
+
+namespace clio {
+
+/**
+ * @brief Persistent pooled features and p(y|x) columns for every node in a layer
+ *
+ * I(X;Y) over the layer (with uniform p(x) and p(y)) is the mean over nodes of
+ * KL(p(y|x) || p(y)), so it is maintained as a running sum of per-node terms and
+ * only nodes that were added, removed or modified need to be rescored.
+ *
+ * Entries are scored against the tasks passed to update() and insert(). Owners have to
+ * call clear() when the tasks change.
+ */
+class NodeStatisticsCache {
+ public:
+  struct Entry {
+    Eigen::VectorXf feature;
+    Eigen::VectorXd py_x;
+    //! contribution to I(X;Y) before weighting by p(x)
+    double information;
+  };
+
+  explicit NodeStatisticsCache(const PyGivenXConfig& config);
+
+  /**
+   * @brief Synchronize the cache with already pooled features
+   *
+   * Nodes missing from the embeddings are dropped and any node whose pooled feature
+   * changed is rescored.
+   *
+   * @returns Number of nodes that were rescored
+   */
+  size_t update(const PooledEmbeddingCache& embeddings,
+                const hydra::EmbeddingGroup& tasks,
+                const hydra::EmbeddingDistance& metric);
+
+  /**
+   * @brief Rescore the provided nodes (replacing any existing entries)
+   * @param nodes Node IDs
+   * @param features DxN matrix where column i is the pooled feature for nodes[i]
+   */
+  void insert(const std::vector<NodeId>& nodes,
+              const Eigen::MatrixXf& features,
+              const hydra::EmbeddingGroup& tasks,
+              const hydra::EmbeddingDistance& metric);
+
+  /**
+   * @brief Add a precomputed entry (e.g. from a snapshot) without rescoring it
+   */
+  void insert(NodeId node, Entry entry);
+
+  bool erase(NodeId node);
+
+  void clear();
+
+  /**
+   * @brief Get I(X;Y) over every cached node
+   */
+  double mutualInformation() const;
+
+  const Entry* getEntry(NodeId node) const;
+
+  size_t size() const { return entries_.size(); }
+
+  const std::map<NodeId, Entry>& entries() const { return entries_; }
+
+ private:
+  void addChanges(size_t num_changes);
+
+  const PyGivenXConfig config_;
+  std::map<NodeId, Entry> entries_;
+  double information_sum_ = 0.0;
+  size_t changes_since_refresh_ = 0;
+};
+
+}  // namespace clio
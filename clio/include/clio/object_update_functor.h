@@ -5,15 +5,46 @@
 
 #include <map>
 
+#include "clio/agglomerative_clustering.h"
+#include "clio/async_job.h"
+#include "clio/bounding_box_index.h"
+#include "clio/clustering_snapshot.h"
+#include "clio/clustering_stats.h"
 #include "clio/ib_edge_selector.h"
+#include "clio/node_statistics_cache.h"
+#include "clio/pooled_embedding_cache.h"
+#include "clio/task_index.h"
+#include "clio/thread_pool.h"
 
 namespace clio {
 
+/**
+ * @brief Merge the bounding boxes and meshes of several objects into another object
+ *
+ * The final bounding box is computed first so that every vertex is transformed into
+ * the merged box frame exactly once.
+ */
+void mergeObjectAttributes(
+    const std::vector<const spark_dsg::KhronosObjectAttributes*>& from,
+    spark_dsg::KhronosObjectAttributes& into);
+
+void mergeObjectAttributes(const spark_dsg::KhronosObjectAttributes& from,
+                           spark_dsg::KhronosObjectAttributes& into);
+
+/**
+ * @brief Get the (slightly padded) world-frame box to index a bounding box with
+ *
+ * Invalid boxes are unbounded so that they overlap every other box.
+ */
+BoundingBoxIndex::Box getIndexBox(const spark_dsg::BoundingBox& box);
+
 struct IntersectionPolicy {
   using Ptr = std::unique_ptr<IntersectionPolicy>;
   virtual ~IntersectionPolicy() = default;
   virtual bool call(const spark_dsg::KhronosObjectAttributes& lhs,
                     const spark_dsg::KhronosObjectAttributes& rhs) const = 0;
+  //! true if call() can only succeed when the bounding boxes of both segments overlap
+  virtual bool requiresOverlap() const { return false; }
   bool operator()(const spark_dsg::KhronosObjectAttributes& lhs,
                   const spark_dsg::KhronosObjectAttributes& rhs) const {
     return call(lhs, rhs);
@@ -29,6 +60,8 @@ struct OverlapIntersection : public IntersectionPolicy {
 
   bool call(const spark_dsg::KhronosObjectAttributes& lhs,
             const spark_dsg::KhronosObjectAttributes& rhs) const;
+
+  bool requiresOverlap() const override { return true; }
 };
 
 void declare_config(OverlapIntersection::Config& config);
@@ -36,18 +69,60 @@ void declare_config(OverlapIntersection::Config& config);
 struct ComponentInfo {
   using Ptr = std::unique_ptr<ComponentInfo>;
 
+  //! empty component (see cluster)
+  explicit ComponentInfo(const IBEdgeSelector::Config& config);
+
   ComponentInfo(const IBEdgeSelector::Config& config,
+                const AgglomerationConfig& agglomeration,
                 const hydra::EmbeddingGroup& tasks,
                 const hydra::EmbeddingDistance& metric,
                 const spark_dsg::SceneGraphLayer& segments,
+                const PooledEmbeddingCache& embeddings,
                 const std::vector<NodeId>& nodes,
-                double I_xy_full);
+                double I_xy_full,
+                ThreadPool* pool = nullptr);
+
+  /**
+   * @brief Replace the contents of the component by clustering a new set of nodes
+   *
+   * The workspace and selector are reset in place, so recycled components keep the
+   * capacity of their vectors (see ClusteringWorkspace::reset).
+   */
+  void cluster(const AgglomerationConfig& agglomeration,
+               const hydra::EmbeddingGroup& tasks,
+               const hydra::EmbeddingDistance& metric,
+               const spark_dsg::SceneGraphLayer& segments,
+               const PooledEmbeddingCache& embeddings,
+               const std::vector<NodeId>& nodes,
+               double I_xy_full,
+               ThreadPool* pool = nullptr);
+
+  /**
+   * @brief Cluster a set of nodes from precomputed features
+   * @param layer Layer to take edges from
+   * @param nodes Nodes to cluster
+   * @param features DxN matrix where column i is the feature for nodes[i]
+   * @param I_xy_full I(X;Y) over every segment
+   * @param delta_weight Fraction of every segment in the component
+   */
+  void cluster(const AgglomerationConfig& agglomeration,
+               const hydra::EmbeddingGroup& tasks,
+               const hydra::EmbeddingDistance& metric,
+               const spark_dsg::SceneGraphLayer& layer,
+               const std::vector<NodeId>& nodes,
+               const Eigen::MatrixXf& features,
+               double I_xy_full,
+               double delta_weight,
+               ThreadPool* pool = nullptr);
 
   IBEdgeSelector edge_selector;
   ClusteringWorkspace ws;
 
   std::vector<NodeId> segments;
-  std::vector<NodeId> objects;
+  //! object node IDs and the (sorted) segments merged into each object
+  std::map<NodeId, std::vector<NodeId>> objects;
+  //! counters and times from clustering the component
+  ClusteringStats stats;
 };
 
 class ObjectUpdateFunctor : public hydra::UpdateFunctor {
@@ -60,17 +135,46 @@ class ObjectUpdateFunctor : public hydra::UpdateFunctor {
     config::VirtualConfig<hydra::EmbeddingDistance> metric{
         hydra::CosineDistance::Config()};
     IBEdgeSelector::Config selector;
+    AgglomerationConfig agglomeration;
+    PooledEmbeddingCache::Config embeddings;
+    TaskIndex::Config task_index;
     double min_segment_score = 0.2;
     double min_object_score = 0.2;
     double neighbor_max_distance = 0.0;
+    double segment_index_resolution = 1.0;
+    size_t num_threads = 1;
+    bool reconcile_objects = true;
+    //! maximum number of cleared components kept for reuse
+    size_t component_pool_size = 64;
+    //! cluster on a worker thread and apply the objects on a later call
+    bool async = false;
+    //! seconds a call waits for before it blocks on clustering (<= 0 to never block)
+    double async_max_latency = 1.0;
+    //! clustering state file loaded on construction and written on destruction
+    //! (disabled if empty)
+    std::string state_path = "";
+    //! calls between writing the state file from call() (0 to only write it on
+    //! destruction)
+    size_t state_save_interval = 50;
   } const config;
 
   explicit ObjectUpdateFunctor(const Config& config);
 
+  ~ObjectUpdateFunctor() override;
+
   hydra::MergeList call(const spark_dsg::DynamicSceneGraph& unmerged,
                         hydra::SharedDsgInfo& dsg,
                         const hydra::UpdateInfo::ConstPtr& info) const override;
 
+  /**
+   * @brief Add edges between overlapping segments (and ignore low-scoring segments)
+   *
+   * Segments missing from the feature cache are pooled on demand here, in
+   * detectObjects and in launchClustering, so they also work outside of call() (which
+   * pools every segment).
+   *
+   * @returns Components that new edges connect to
+   */
   std::set<size_t> addSegmentEdges(spark_dsg::DynamicSceneGraph& graph) const;
 
   void clearActiveComponents(spark_dsg::DynamicSceneGraph& graph,
@@ -78,12 +182,135 @@ class ObjectUpdateFunctor : public hydra::UpdateFunctor {
 
   void detectObjects(spark_dsg::DynamicSceneGraph& segments) const;
 
+  /**
+   * @brief Start clustering new components on the worker thread (async mode)
+   *
+   * Features and the component topology are copied, so the graph can change while
+   * clustering runs. Segments of the new components are assigned to pending
+   * components until the results are applied.
+   *
+   * @returns False if a clustering pass is already running (or there is nothing to
+   * cluster)
+   */
+  bool launchClustering(spark_dsg::DynamicSceneGraph& graph) const;
+
+  /**
+   * @brief Create objects from the running clustering pass if it has finished
+   *
+   * Components that were cleared since the pass started (or that lost segments) are
+   * stale: their segments are left for the next pass instead.
+   *
+   * @param block Wait for the pass to finish
+   * @returns Number of components whose objects were applied
+   */
+  size_t applyClustering(spark_dsg::DynamicSceneGraph& graph, bool block) const;
+
   void updateActiveParents(spark_dsg::DynamicSceneGraph& graph) const;
 
+  /**
+   * @brief Synchronize the segment index with the segment layer
+   *
+   * Only new segments and segments whose update time or bounding box changed since
+   * they were indexed are re-indexed.
+   */
+  void updateSegmentIndex(const spark_dsg::SceneGraphLayer& segments) const;
+
+  //! outcome of matching a cluster against the previous objects
+  enum class Reconciliation { NO_MATCH, REUSED, REJECTED };
+
+  /**
+   * @brief Reuse a previous object for a cluster if possible
+   *
+   * Objects with the same segments are kept untouched and objects whose segments are
+   * a subset of the cluster are extended in place with the remaining segments. The
+   * cluster is scored before the object is modified; a matched object that no longer
+   * scores high enough is removed instead.
+   *
+   * @param graph Graph containing the previous objects
+   * @param cluster Segments of the cluster
+   * @param object_id Set to the ID of the reused object
+   * @returns Whether the cluster reused, removed or matched no previous object
+   */
+  Reconciliation reconcileObject(spark_dsg::DynamicSceneGraph& graph,
+                                 const std::vector<NodeId>& cluster,
+                                 NodeId& object_id) const;
+
+  void updateObjectParent(spark_dsg::DynamicSceneGraph& graph,
+                          NodeId object_id,
+                          const std::vector<NodeId>& cluster) const;
+
+  /**
+   * @brief Reassign a clustered component and create (or reuse) its objects
+   */
+  void addComponent(spark_dsg::DynamicSceneGraph& graph,
+                    size_t component_id,
+                    const std::vector<NodeId>& nodes,
+                    ComponentInfo::Ptr component) const;
+
+  /**
+   * @brief Get an empty component, reusing a previously cleared one if possible
+   */
+  ComponentInfo::Ptr acquireComponent() const;
+
+  /**
+   * @brief Return a cleared component to the pool (dropped if the pool is full)
+   */
+  void releaseComponent(ComponentInfo::Ptr component) const;
+
+  /**
+   * @brief Get the clustering state needed to resume with the same objects
+   *
+   * A running async pass is discarded first, so its segments are clustered again
+   * after restoring.
+   */
+  ObjectClusteringSnapshot getSnapshot() const;
+
+  /**
+   * @brief Replace the clustering state with a snapshot of the same graph
+   *
+   * Cached p(y|x) and ignored segments are only kept if the snapshot was taken with
+   * the current tasks. Otherwise every component is re-clustered by the next call.
+   */
+  void restoreSnapshot(const ObjectClusteringSnapshot& snapshot) const;
+
+  //! write the clustering state to a file (see ObjectClusteringSnapshot)
+  bool saveState(const std::string& filepath) const;
+
+  //! restore the clustering state from a file written by saveState
+  bool loadState(const std::string& filepath) const;
+
+  /**
+   * @brief Replace the tasks (safe to call from any thread)
+   *
+   * The new tasks take effect at the start of the next call, which re-clusters
+   * every component and re-checks every segment against the new tasks. Pooled
+   * segment features are kept.
+   */
+  void setTasks(hydra::EmbeddingGroup::Ptr tasks);
+
+  /**
+   * @brief Switch to the tasks most recently passed to setTasks (if any)
+   *
+   * Drops cached p(y|x) and segments previously ignored for their scores.
+   *
+   * @returns True if the tasks changed
+   */
+  bool updateTasks() const;
+
+  /**
+   * @brief Counters and clustering times from the most recent call
+   */
+  const ClusteringStats& stats() const { return stats_; }
+
  protected:
   IntersectionPolicy::Ptr edge_checker_;
-  hydra::EmbeddingGroup::Ptr tasks_;
+  mutable hydra::EmbeddingGroup::Ptr tasks_;
   std::unique_ptr<hydra::EmbeddingDistance> metric_;
+  //! best-task lookup for segment and object score thresholds
+  mutable std::unique_ptr<TaskIndex> task_index_;
+  mutable PendingTasks pending_tasks_;
+  //! clusters independent components in parallel
+  ThreadPool::Ptr pool_;
 
   hydra::IdTracker components_ids_;
   mutable std::set<NodeId> ignored_;
@@ -91,6 +318,58 @@ class ObjectUpdateFunctor : public hydra::UpdateFunctor {
   mutable NodeSymbol next_node_id_;
   mutable std::map<size_t, ComponentInfo::Ptr> components_;
   mutable std::map<NodeId, size_t> node_to_component_;
+  //! cleared components whose clustering state can be reused
+  mutable std::vector<ComponentInfo::Ptr> free_components_;
+  //! objects of cleared components (and their segments) waiting to be reconciled
+  mutable std::map<NodeId, std::vector<NodeId>> previous_objects_;
+  mutable std::map<NodeId, NodeId> segment_to_previous_object_;
+  //! broad-phase lookup for segment edges (null if the edge checker can't use it)
+  mutable std::unique_ptr<BoundingBoxIndex> segment_index_;
+  //! segment attributes as of when their box was last indexed
+  struct IndexedSegment {
+    uint64_t last_update_time_ns = 0;
+    spark_dsg::BoundingBox bounding_box;
+  };
+  mutable std::map<NodeId, IndexedSegment> indexed_segments_;
+  //! pooled segment features (shared by edge detection, clustering and merging)
+  mutable PooledEmbeddingCache segment_embeddings_;
+  //! per-segment p(y|x) and I(X;Y) over the whole segment layer
+  mutable NodeStatisticsCache segment_stats_;
+  mutable ClusteringStats stats_;
+  mutable ClusteringStatsLog stats_log_;
+  //! every component has to be re-clustered by the next call
+  mutable bool invalidated_ = false;
+  mutable size_t calls_since_save_ = 0;
+
+  //! write the state file if state_save_interval calls passed since the last write
+  void saveStateIfDue(uint64_t timestamp_ns) const;
+
+  //! inputs and results of a clustering pass on the worker thread
+  struct ClusteringJob {
+    using Ptr = std::unique_ptr<ClusteringJob>;
+    //! topology of the segments being clustered
+    std::unique_ptr<spark_dsg::IsolatedSceneGraphLayer> segments;
+    std::vector<size_t> ids;
+    std::vector<std::vector<NodeId>> components;
+    std::vector<Eigen::MatrixXf> features;
+    std::vector<ComponentInfo::Ptr> infos;
+    double I_xy = 0.0;
+    size_t num_segments = 0;
+    //! objects of cleared components waiting for this pass to be reconciled
+    std::map<NodeId, std::vector<NodeId>> previous_objects;
+    std::map<NodeId, NodeId> segment_to_previous_object;
+  };
+
+  //! drop the running clustering pass and leave its segments for the next pass
+  void discardClustering() const;
+
+  //! remove previous objects that no cluster reused
+  void removePreviousObjects(spark_dsg::DynamicSceneGraph& graph) const;
+
+  //! segments of components that are being clustered on the worker thread
+  mutable std::map<size_t, std::vector<NodeId>> pending_components_;
+  //! declared last so that the running pass finishes before anything it refers to
+  mutable AsyncJob<ClusteringJob::Ptr> clustering_job_;
 };
 
 void declare_config(ObjectUpdateFunctor::Config& config);
@@ -0,0 +1,133 @@
+#pragma once
+#include <hydra/openset/embedding_distances.h>
+#include <hydra/openset/embedding_group.h>
+
+#include <Eigen/Dense>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+#include "clio/ib_edge_selector.h"
+#include "clio/scene_graph_types.h"
+
+namespace clio {
+
+/**
+ * @brief Agglomerative IB clustering over a graph that changes over time
+ *
+ * Clusters track node counts instead of p(z), so inserting nodes never rescales
+ * existing clusters. With p(x) uniform, the IB stopping rule d I(Z;Y) / I(X;Y) <
+ * max_delta becomes (n_s + n_t) * JS(p(y|s), p(y|t)) < max_delta * S, where S is the
+ * sum of KL(p(y|x) || p(y)) over every node. After every update no edge between
+ * clusters satisfies the rule, the same state that clustering a workspace from
+ * scratch stops in.
+ *
+ * Node and edge insertions only create new singleton clusters; removals dissolve
+ * the affected clusters into singletons (they may no longer be connected). Only
+ * edges incident to those clusters are rescored, and clusters are never split to
+ * undo earlier merges.
+ */
+class OnlineClustering {
+ public:
+  struct Config {
+    //! stopping criterion (max_delta) and p(y|x) computation
+    IBEdgeSelector::Config selector;
+  } const config;
+
+  OnlineClustering(const Config& config,
+                   const hydra::EmbeddingGroup& tasks,
+                   const hydra::EmbeddingDistance& metric);
+
+  /**
+   * @brief Add a node (scored during the next update)
+   * @returns false if the node already exists
+   */
+  bool addNode(NodeId node, const Eigen::VectorXf& feature);
+
+  bool removeNode(NodeId node);
+
+  bool addEdge(NodeId source, NodeId target);
+
+  bool removeEdge(NodeId source, NodeId target);
+
+  /**
+   * @brief Score new nodes and merge until the stopping rule holds everywhere
+   * @returns Number of merges performed
+   */
+  size_t update();
+
+  bool hasNode(NodeId node) const { return nodes_.count(node); }
+
+  size_t numNodes() const { return nodes_.size(); }
+
+  size_t numClusters() const { return clusters_.size(); }
+
+  //! ID of the cluster a node belongs to (cluster IDs are node IDs of a member)
+  NodeId getCluster(NodeId node) const;
+
+  //! members of every cluster (sorted)
+  std::vector<std::vector<NodeId>> getClusters() const;
+
+  //! I(X;Y) over all scored nodes
+  double mutualInformation() const;
+
+ private:
+  struct Node {
+    Eigen::VectorXf feature;
+    Eigen::VectorXd py_x;
+    double information = 0.0;
+    bool scored = false;
+    NodeId cluster;
+    std::set<NodeId> neighbors;
+  };
+
+  struct ClusterInfo {
+    std::set<NodeId> nodes;
+    Eigen::VectorXd py_z;
+    double entropy = 0.0;
+    //! adjacent clusters and the number of node edges between them
+    std::map<NodeId, size_t> neighbors;
+  };
+
+  struct HeapEntry {
+    double score;
+    EdgeKey edge;
+    size_t stamp;
+  };
+
+  struct HeapCompare {
+    bool operator()(const HeapEntry& lhs, const HeapEntry& rhs) const;
+  };
+
+  void scorePending();
+  void makeSingleton(NodeId node);
+  void dissolve(NodeId cluster);
+  void linkClusters(NodeId lhs, NodeId rhs);
+  void unlinkClusters(NodeId lhs, NodeId rhs);
+  void merge(EdgeKey edge);
+  void scoreEdges(NodeId cluster);
+  double scoreEdge(EdgeKey edge) const;
+  void addChanges(size_t num_changes);
+
+  const hydra::EmbeddingGroup& tasks_;
+  const hydra::EmbeddingDistance& metric_;
+  Eigen::VectorXd py_;
+
+  std::unordered_map<NodeId, Node> nodes_;
+  std::map<NodeId, ClusterInfo> clusters_;
+  std::set<NodeId> pending_;
+  std::set<NodeId> dirty_;
+
+  // lazily invalidated heap of inter-cluster edge scores
+  size_t next_stamp_ = 0;
+  std::vector<HeapEntry> heap_;
+  std::map<EdgeKey, std::pair<double, size_t>> scores_;
+
+  double information_sum_ = 0.0;
+  size_t changes_since_refresh_ = 0;
+};
+
+void declare_config(OnlineClustering::Config& config);
+
+}  // namespace clio
@@ -0,0 +1,106 @@
+#pragma once
+#include <spark_dsg/node_attributes.h>
+#include <spark_dsg/scene_graph_layer.h>
+
+#include <Eigen/Dense>
+#include <map>
+#include <string>
+
+#include "clio/scene_graph_types.h"
+
+namespace clio {
+
+/**
+ * @brief Per-node pooled semantic features, recomputed only when a node can change
+ *
+ * Every column of a node's semantic feature is a view of the node. The views are
+ * pooled into a single feature once per update (instead of by every consumer), and
+ * the number of views is kept so that pooled features of several nodes can be
+ * combined with each node weighted by how often it was observed.
+ */
+class PooledEmbeddingCache {
+ public:
+  enum class Pooling { MEAN, MAX, LAST };
+
+  struct Config {
+    //! how views of a single node are pooled: one of "mean", "max" or "last"
+    std::string pooling = "mean";
+    //! weight nodes by number of views when combining them (instead of uniformly)
+    bool weight_by_views = false;
+  } const config;
+
+  struct Entry {
+    Eigen::VectorXf feature;
+    size_t num_views = 0;
+  };
+
+  PooledEmbeddingCache();
+
+  explicit PooledEmbeddingCache(const Config& config);
+
+  /**
+   * @brief Synchronize the cache with the nodes in the layer
+   *
+   * Removed nodes are dropped and new and active nodes are re-pooled. Archived
+   * (inactive) nodes that are already cached are assumed not to change. Nodes without
+   * a semantic feature are not cached.
+   *
+   * @returns Number of nodes that were re-pooled
+   */
+  size_t update(const spark_dsg::SceneGraphLayer& layer);
+
+  /**
+   * @brief Pool only the nodes in the layer that are not cached yet
+   *
+   * Cached nodes are never re-pooled, so this is cheap once the cache is up to date.
+   *
+   * @returns Number of nodes that were pooled
+   */
+  size_t addMissing(const spark_dsg::SceneGraphLayer& layer);
+
+  /**
+   * @brief Force a node to be re-pooled by the next update
+   */
+  bool erase(NodeId node);
+
+  void clear();
+
+  const Entry* getEntry(NodeId node) const;
+
+  /**
+   * @brief Get the pooled feature for a node (which has to be cached)
+   */
+  const Eigen::VectorXf& getFeature(NodeId node) const;
+
+  /**
+   * @brief Get a DxN matrix where column i is the pooled feature for nodes[i]
+   */
+  Eigen::MatrixXf getFeatures(const std::vector<NodeId>& nodes) const;
+
+  /**
+   * @brief Average the pooled features of several nodes
+   *
+   * Nodes are weighted by their number of views if weight_by_views is set.
+   */
+  Eigen::VectorXf combine(const std::vector<NodeId>& nodes) const;
+
+  /**
+   * @brief Pool the views (columns) of a single feature matrix
+   */
+  Eigen::VectorXf pool(const Eigen::MatrixXf& views) const;
+
+  size_t size() const { return entries_.size(); }
+
+  const std::map<NodeId, Entry>& entries() const { return entries_; }
+
+ private:
+  //! pool a node into the cache (false if the node has no feature)
+  bool add(NodeId node, const spark_dsg::SemanticNodeAttributes& attrs);
+
+  const Pooling pooling_;
+  std::map<NodeId, Entry> entries_;
+};
+
+void declare_config(PooledEmbeddingCache::Config& config);
+
+}  // namespace clio
@@ -23,6 +23,87 @@ double jensenShannonDivergence(const Eigen::MatrixXd& p,
                                const Eigen::VectorXd& priors,
                                double tolerance = 1.0e-9);
 
+/**
+ * @brief Compute the Shannon entropy of the mixture w1 * p1 + w2 * p2
+ *
+ * Evaluated in a single vectorized pass (no temporaries) using natural log, so
+ * results can differ from shannonEntropy in the last few bits.
+ *
+ * @param p1 PMF of the first distribution
+ * @param p2 PMF of the second distribution
+ * @param w1 Weight of the first distribution
+ * @param w2 Weight of the second distribution
+ * @param tolerance Threshold for near-zero probability
+ * @returns Shannon entropy of the mixture
+ */
+double mixtureEntropy(const Eigen::Ref<const Eigen::VectorXd>& p1,
+                      const Eigen::Ref<const Eigen::VectorXd>& p2,
+                      double w1,
+                      double w2,
+                      double tolerance = 1.0e-9);
+
+/**
+ * @brief Single-precision version of mixtureEntropy (accumulated in float)
+ */
+double mixtureEntropy(const Eigen::Ref<const Eigen::VectorXf>& p1,
+                      const Eigen::Ref<const Eigen::VectorXf>& p2,
+                      double w1,
+                      double w2,
+                      double tolerance = 1.0e-9);
+
+/**
+ * @brief Compute the JS divergence of two distributions with known entropies
+ *
+ * Same quantity as jensenShannonDivergence for two columns and priors (w1, w2), but
+ * allocation-free. Entropies should come from mixtureEntropy(p, p, 1.0, 0.0) so that
+ * rounding is consistent; the result is clamped to be non-negative.
+ *
+ * @param p1 PMF of the first distribution
+ * @param p2 PMF of the second distribution
+ * @param w1 Prior of the first distribution
+ * @param w2 Prior of the second distribution
+ * @param H1 Entropy of the first distribution
+ * @param H2 Entropy of the second distribution
+ * @param tolerance Threshold for near-zero probability
+ * @returns JS divergence of the distributions
+ */
+double pairwiseJensenShannonDivergence(const Eigen::Ref<const Eigen::VectorXd>& p1,
+                                       const Eigen::Ref<const Eigen::VectorXd>& p2,
+                                       double w1,
+                                       double w2,
+                                       double H1,
+                                       double H2,
+                                       double tolerance = 1.0e-9);
+
+/**
+ * @brief Single-precision version of pairwiseJensenShannonDivergence
+ */
+double pairwiseJensenShannonDivergence(const Eigen::Ref<const Eigen::VectorXf>& p1,
+                                       const Eigen::Ref<const Eigen::VectorXf>& p2,
+                                       double w1,
+                                       double w2,
+                                       double H1,
+                                       double H2,
+                                       double tolerance = 1.0e-9);
+
+/**
+ * @brief Compute the KL divergence D(p || q) (skips near-zero entries of p or q)
+ * @param p PMF of the first distribution
+ * @param q PMF of the second distribution
+ * @param tolerance Threshold for near-zero probability
+ * @returns KL divergence in bits
+ */
+double klDivergence(const Eigen::Ref<const Eigen::VectorXd>& p,
+                    const Eigen::Ref<const Eigen::VectorXd>& q,
+                    double tolerance = 1.0e-9);
+
+/**
+ * @brief Single-precision version of klDivergence (accumulated in double)
+ */
+double klDivergence(const Eigen::Ref<const Eigen::VectorXf>& p,
+                    const Eigen::Ref<const Eigen::VectorXf>& q,
+                    double tolerance = 1.0e-9);
+
 /**
  * @brief Compute the mutual information between two distributions
  * @param pa Marginal of the first distribution p(a)
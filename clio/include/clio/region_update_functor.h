@@ -1,27 +1,133 @@
 #pragma once
 #include <hydra/backend/update_functions.h>
 
+#include <map>
+#include <set>
+
 #include "clio/agglomerative_clustering.h"
+#include "clio/async_job.h"
+#include "clio/clustering_stats.h"
+#include "clio/node_statistics_cache.h"
+#include "clio/pooled_embedding_cache.h"
 
 namespace clio {
 
 struct RegionUpdateFunctor : public hydra::UpdateFunctor {
   struct Config {
     AgglomerativeClustering::Config clustering;
+    //! place features default to the most recent view
+    PooledEmbeddingCache::Config embeddings{"last"};
+    //! only re-cluster regions touched by places that changed since the last update
+    bool incremental = false;
+    //! edit existing regions to match new clusters instead of recreating every region
+    bool diff_update = false;
+    //! cluster on a worker thread and apply the regions on a later call (ignored
+    //! for incremental updates)
+    bool async = false;
+    //! seconds a call waits for before it blocks on clustering (<= 0 to never block)
+    double async_max_latency = 1.0;
   } const config;
 
   explicit RegionUpdateFunctor(const Config& config);
 
+  ~RegionUpdateFunctor() override;
+
   hydra::MergeList call(const spark_dsg::DynamicSceneGraph& unmmerged,
                         hydra::SharedDsgInfo& dsg,
                         const hydra::UpdateInfo::ConstPtr& info) const override;
 
-  void updateGraphBatch(spark_dsg::DynamicSceneGraph& graph,
-                        const std::vector<Cluster::Ptr>& clusters) const;
+  /**
+   * @brief Replace the contents of the region layer with the clusters
+   * @returns Number of changes (region nodes added or removed, region attributes
+   * updated and region-place edges added or removed) applied to the graph
+   */
+  size_t updateGraphBatch(spark_dsg::DynamicSceneGraph& graph,
+                          const std::vector<Cluster::Ptr>& clusters) const;
+
+  /**
+   * @brief Match clusters to existing regions and only apply what changed
+   *
+   * Clusters are greedily matched to the region that shares the most places with
+   * them. Matched regions keep their node ID and have children and attributes
+   * edited in place; unmatched regions are removed and unmatched clusters become
+   * new regions.
+   *
+   * @returns Number of changes applied to the graph (see updateGraphBatch)
+   */
+  size_t updateGraphDiff(spark_dsg::DynamicSceneGraph& graph,
+                         const std::vector<Cluster::Ptr>& clusters) const;
+
+  /**
+   * @brief Re-cluster only the neighborhoods of changed places
+   *
+   * Places that are new, removed or active with a changed feature or set of
+   * neighbors mark themselves and their neighbors as dirty. Regions containing a
+   * dirty place are dissolved and their places (plus any unassigned dirty places)
+   * are clustered again; every other region is kept as-is with the same node ID.
+   *
+   * @returns Number of places that were re-clustered
+   */
+  size_t updateIncremental(spark_dsg::DynamicSceneGraph& graph) const;
+
+  /**
+   * @brief Start clustering every valid place on the worker thread (async mode)
+   * @returns False if a clustering pass is already running (or there are no places)
+   */
+  bool launchClustering(const spark_dsg::DynamicSceneGraph& graph) const;
+
+  /**
+   * @brief Apply the regions from the running clustering pass if it has finished
+   *
+   * Places removed since the pass started are dropped from the regions.
+   *
+   * @param block Wait for the pass to finish
+   * @returns True if the regions were applied
+   */
+  bool applyClustering(spark_dsg::DynamicSceneGraph& graph, bool block) const;
+
+  /**
+   * @brief Replace the tasks (safe to call from any thread)
+   *
+   * The new tasks take effect at the start of the next call, which re-clusters
+   * every place (and re-creates every region for incremental updates). Pooled place
+   * features are kept.
+   */
+  void setTasks(hydra::EmbeddingGroup::Ptr tasks);
+
+  /**
+   * @brief Counters and clustering times from the most recent call
+   */
+  const ClusteringStats& stats() const { return stats_; }
 
  private:
+  struct ClusteringResult {
+    std::vector<Cluster::Ptr> clusters;
+    ClusteringStats stats;
+  };
+
+  struct PlaceInfo {
+    Eigen::VectorXf feature;
+    std::set<NodeId> siblings;
+  };
+
+  //! cluster every valid place and replace the regions with the clusters
+  void updateBatch(spark_dsg::DynamicSceneGraph& graph, uint64_t timestamp_ns) const;
+
+  std::set<NodeId> updatePlaces(const spark_dsg::SceneGraphLayer& places) const;
+
   mutable NodeSymbol region_id_;
   AgglomerativeClustering clustering_;
+
+  // state for incremental updates
+  mutable std::map<NodeId, PlaceInfo> places_;
+  mutable std::map<NodeId, std::set<NodeId>> regions_;
+  mutable std::map<NodeId, NodeId> place_to_region_;
+  mutable PooledEmbeddingCache place_embeddings_;
+  mutable NodeStatisticsCache place_stats_;
+  mutable ClusteringStats stats_;
+  mutable ClusteringStatsLog stats_log_;
+  //! declared last so that the running pass finishes before the clustering it uses
+  mutable AsyncJob<ClusteringResult> clustering_job_;
 };
 
 void declare_config(RegionUpdateFunctor::Config& config);
@@ -0,0 +1,69 @@
+#pragma once
+#include <Eigen/Dense>
+#include <vector>
+
+namespace clio {
+
+/**
+ * @brief PMF stored as a sorted list of entries over a constant floor
+ *
+ * Every index outside the support has probability `floor`, so columns of p(y|x)
+ * built from top-k task scores only need O(k) storage regardless of the number of
+ * tasks. The floor is handled analytically by the kernels below, which cost
+ * O(nnz) instead of O(dim) whenever the floor is below tolerance.
+ */
+struct SparsePmf {
+  Eigen::Index dim = 0;
+  double floor = 0.0;
+  //! ascending indices of entries that are not the floor
+  std::vector<Eigen::Index> indices;
+  std::vector<double> values;
+
+  size_t nnz() const { return indices.size(); }
+
+  double operator()(Eigen::Index i) const;
+
+  Eigen::VectorXd toDense() const;
+
+  /**
+   * @brief Compress a dense PMF (every entry equal to floor is left implicit)
+   */
+  static SparsePmf fromDense(const Eigen::Ref<const Eigen::VectorXd>& p,
+                             double floor = 0.0);
+};
+
+/**
+ * @brief Compute the mixture w1 * p1 + w2 * p2 (support is the union of supports)
+ */
+SparsePmf mixPmfs(const SparsePmf& p1, const SparsePmf& p2, double w1, double w2);
+
+/**
+ * @brief Compute the Shannon entropy of w1 * p1 + w2 * p2 (see dense version)
+ */
+double mixtureEntropy(const SparsePmf& p1,
+                      const SparsePmf& p2,
+                      double w1,
+                      double w2,
+                      double tolerance = 1.0e-9);
+
+/**
+ * @brief Compute the JS divergence of two distributions with known entropies
+ *
+ * Entropies should come from mixtureEntropy(p, p, 1.0, 0.0).
+ */
+double pairwiseJensenShannonDivergence(const SparsePmf& p1,
+                                       const SparsePmf& p2,
+                                       double w1,
+                                       double w2,
+                                       double H1,
+                                       double H2,
+                                       double tolerance = 1.0e-9);
+
+/**
+ * @brief Compute the KL divergence D(p || q) for a dense q (see dense version)
+ */
+double klDivergence(const SparsePmf& p,
+                    const Eigen::Ref<const Eigen::VectorXd>& q,
+                    double tolerance = 1.0e-9);
+
+}  // namespace clio
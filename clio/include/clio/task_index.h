@@ -0,0 +1,92 @@
+#pragma once
+#include <hydra/openset/embedding_distances.h>
+#include <hydra/openset/embedding_group.h>
+
+#include <Eigen/Dense>
+#include <limits>
+#include <mutex>
+
+namespace clio {
+
+/**
+ * @brief Best-task lookup that avoids scanning every task with the metric
+ *
+ * For cosine metrics the task embeddings are normalized once into a dense NxD
+ * matrix, so that approximate scores against every task are a single
+ * matrix-vector product. The best rerank_k approximate tasks are then rescored with
+ * the metric, so the returned score is always the exact metric score of the
+ * returned task. Other metrics, small vocabularies and disabled indices fall back to
+ * EmbeddingGroup::getBestScore.
+ *
+ * The index holds references to the tasks and metric and has to be rebuilt if the
+ * task embeddings change.
+ */
+class TaskIndex {
+ public:
+  using Score = hydra::EmbeddingGroup::Score;
+
+  struct Config {
+    //! use the dense cosine index when possible (instead of a linear metric scan)
+    bool enable = true;
+    //! smaller vocabularies are scanned (the index only pays off for many tasks)
+    size_t min_tasks = 32;
+    //! number of best approximate tasks rescored with the exact metric
+    size_t rerank_k = 4;
+    //! slack on approximate scores before skipping rescoring for a threshold
+    double tolerance = 1.0e-4;
+  } const config;
+
+  TaskIndex(const hydra::EmbeddingGroup& tasks, const hydra::EmbeddingDistance& metric);
+
+  TaskIndex(const Config& config,
+            const hydra::EmbeddingGroup& tasks,
+            const hydra::EmbeddingDistance& metric);
+
+  /**
+   * @brief Get the best task (and its score) for a feature
+   *
+   * If the best approximate score is below min_score (with some tolerance), the
+   * approximate best task is returned without rescoring. Callers that only check
+   * the score against min_score get the same answer as an exact scan.
+   */
+  Score getBestScore(const Eigen::VectorXf& feature,
+                     double min_score = -std::numeric_limits<double>::infinity()) const;
+
+  //! whether lookups use the dense index (instead of scanning every task)
+  bool indexed() const { return indexed_; }
+
+  size_t size() const { return tasks_.embeddings.size(); }
+
+ private:
+  const hydra::EmbeddingGroup& tasks_;
+  const hydra::EmbeddingDistance& metric_;
+  const bool indexed_;
+  //! row i is the normalized embedding of task i
+  Eigen::MatrixXf normalized_;
+};
+
+void declare_config(TaskIndex::Config& config);
+
+/**
+ * @brief Thread-safe hand-off of replacement tasks to the clustering thread
+ *
+ * Tasks can be set from any thread (e.g., a subscriber callback) and are taken by
+ * the clustering thread at the start of its next update, so setting tasks never
+ * waits on clustering. Only the most recent tasks are kept.
+ */
+class PendingTasks {
+ public:
+  void set(hydra::EmbeddingGroup::Ptr tasks);
+
+  /**
+   * @brief Get the most recently set tasks
+   * @returns Tasks set since the last call (or null if there are none)
+   */
+  hydra::EmbeddingGroup::Ptr take();
+
+ private:
+  std::mutex mutex_;
+  hydra::EmbeddingGroup::Ptr tasks_;
+};
+
+}  // namespace clio
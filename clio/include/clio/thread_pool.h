@@ -0,0 +1,69 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace clio {
+
+/**
+ * @brief Fixed set of worker threads for running independent work items
+ *
+ * The calling thread takes part in every parallelFor, so a pool of N threads only
+ * spawns N - 1 workers and nested calls from inside a work item cannot deadlock.
+ */
+class ThreadPool {
+ public:
+  using Ptr = std::unique_ptr<ThreadPool>;
+
+  /**
+   * @brief Start the pool
+   * @param num_threads Total number of threads (0 for hardware concurrency)
+   */
+  explicit ThreadPool(size_t num_threads);
+
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  size_t numThreads() const { return workers_.size() + 1; }
+
+  /**
+   * @brief Call func(i) for every i in [0, count) and wait for all calls to finish
+   *
+   * Calls may happen concurrently and in any order. The first exception thrown by
+   * a call is rethrown here once the remaining calls have finished.
+   */
+  void parallelFor(size_t count, const std::function<void(size_t)>& func);
+
+ private:
+  struct Job {
+    Job(size_t count, const std::function<void(size_t)>& func);
+
+    const size_t count;
+    const std::function<void(size_t)>& func;
+    std::atomic<size_t> next;
+    std::atomic<size_t> finished;
+    std::exception_ptr error;
+  };
+
+  void spin();
+
+  //! run items from a job until none are left to claim
+  void work(Job& job);
+
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  std::condition_variable work_cv_;
+  std::condition_variable done_cv_;
+  std::deque<std::shared_ptr<Job>> jobs_;
+  bool should_shutdown_ = false;
+};
+
+}  // namespace clio
@@ -7,15 +7,28 @@
 #include <hydra/utils/display_utilities.h>
 #include <spark_dsg/printing.h>
 
+#include <chrono>
+#include <limits>
 #include <numeric>
+#include <optional>
 
+#include "clio/edge_queue.h"
 #include "clio/edge_selector.h"
+#include "clio/merge_scheduler.h"
 
 namespace clio {
 
 using namespace spark_dsg;
 using Clusters = AgglomerativeClustering::Clusters;
 
+void declare_config(AgglomerationConfig& config) {
+  using namespace config;
+  name("AgglomerationConfig");
+  field(config.use_edge_queue, "use_edge_queue");
+  field(config.batch_merges, "batch_merges");
+  field(config.scoring_grain_size, "scoring_grain_size");
+}
+
 void declare_config(AgglomerativeClustering::Config& config) {
   using namespace config;
   name("AgglomerativeClustering::Config");
@@ -23,103 +36,240 @@ void declare_config(AgglomerativeClustering::Config& config) {
   config.metric.setOptional();
   field(config.metric, "metric");
   field(config.selector, "selector");
+  field(config.agglomeration, "agglomeration");
+  field(config.task_index, "task_index");
   field(config.filter_regions, "filter_regions");
+  field(config.num_threads, "num_threads");
 }
 
-void clusterAgglomerative(ClusteringWorkspace& ws,
-                          const hydra::EmbeddingGroup& tasks,
-                          EdgeSelector& edge_selector,
-                          const hydra::EmbeddingDistance& metric,
-                          bool reweight,
-                          double I_xy,
-                          double delta_weight,
-                          int verbosity) {
-  VLOG(verbosity) << "[IB] starting clustering with " << ws.edges.size() << " edges";
+namespace {
 
-  edge_selector.setup(ws, tasks, metric);
+// keeps merging past the stopping criterion and records the delta of every merge
+class DendrogramRecorder : public EdgeSelector {
+ public:
+  DendrogramRecorder(EdgeSelector& selector, Dendrogram& dendrogram)
+      : selector_(selector), dendrogram_(dendrogram) {}
 
-  if (reweight) {
-    edge_selector.onlineReweighting(I_xy, delta_weight);
+  void setup(const ClusteringWorkspace& ws,
+             const hydra::EmbeddingGroup& tasks,
+             const hydra::EmbeddingDistance& metric) override {
+    selector_.setup(ws, tasks, metric);
   }
 
-  VLOG(10) << "-----------------------------------";
-  VLOG(10) << "Scoring edges";
-  VLOG(10) << "-----------------------------------";
-  for (auto& [edge, weight] : ws.edges) {
-    const auto score = edge_selector.scoreEdge(edge);
-    VLOG(10) << "edge (" << edge << "): " << score;
-    weight = score;
-  }
-  VLOG(10) << "-----------------------------------";
+  double scoreEdge(EdgeKey edge) const override { return selector_.scoreEdge(edge); }
 
-  for (size_t i = 0; i < ws.size(); ++i) {
-    if (ws.edges.empty()) {
-      // shouldn't happen unless |connected components| > 1
-      break;
+  bool updateFromEdge(EdgeKey edge) override {
+    const bool valid = selector_.updateFromEdge(edge);
+    const auto delta = selector_.lastMergeDelta();
+    if (!delta) {
+      LOG_FIRST_N(ERROR, 1) << "Selector does not report merge deltas: dendrogram will "
+                               "be incomplete";
+      return valid;
     }
 
-    // iter will always be valid: always at least one edge
-    auto best_edge_ptr = std::min_element(
-        ws.edges.begin(), ws.edges.end(), [&](const auto& lhs, const auto& rhs) {
-          return edge_selector.compareEdges(lhs, rhs);
-        });
-    CHECK(best_edge_ptr != ws.edges.end());
-    if (VLOG_IS_ON(15)) {
-      VLOG(15) << "***********************************";
-      VLOG(15) << "Candidates";
-      VLOG(15) << "***********************************";
-      for (auto&& [edge, weight] : ws.edges) {
-        VLOG(15) << "edge (" << edge << "): " << weight;
-      }
-      VLOG(15) << "***********************************";
+    dendrogram_.addMerge(edge, *delta);
+    return true;
+  }
+
+  bool compareEdges(const std::pair<EdgeKey, double>& lhs,
+                    const std::pair<EdgeKey, double>& rhs) const override {
+    return selector_.compareEdges(lhs, rhs);
+  }
+
+  void onlineReweighting(double param1, double param2) override {
+    selector_.onlineReweighting(param1, param2);
+  }
+
+  // checkpoints are not forwarded, so batched merges fall back to sequential merges
+  // (batches would record merges in a different order)
+
+  std::optional<double> lastMergeDelta() const override {
+    return selector_.lastMergeDelta();
+  }
+
+  std::string summarize() const override { return selector_.summarize(); }
+
+ private:
+  EdgeSelector& selector_;
+  Dendrogram& dendrogram_;
+};
+
+}  // namespace
+
+ClusteringStats clusterAgglomerative(ClusteringWorkspace& ws,
+                                     const hydra::EmbeddingGroup& tasks,
+                                     EdgeSelector& edge_selector,
+                                     const hydra::EmbeddingDistance& metric,
+                                     bool reweight,
+                                     double I_xy,
+                                     double delta_weight,
+                                     int verbosity,
+                                     const AgglomerationConfig& config,
+                                     ThreadPool* pool,
+                                     Dendrogram* dendrogram) {
+  VLOG(verbosity) << "[IB] starting clustering with " << ws.edges.size() << " edges";
+
+  std::optional<DendrogramRecorder> recorder;
+  if (dendrogram) {
+    dendrogram->reset(ws.node_lookup);
+    recorder.emplace(edge_selector, *dendrogram);
+  }
+
+  EdgeSelector& selector = recorder ? *recorder : edge_selector;
+
+  ClusteringStats stats;
+  {  // setup
+    PhaseTimer timer(stats.setup_time);
+    selector.setup(ws, tasks, metric);
+    if (reweight) {
+      selector.onlineReweighting(I_xy, delta_weight);
     }
+  }
+
+  EdgeQueue::Ptr queue;
+  if (config.use_edge_queue) {
+    queue = std::make_unique<HeapEdgeQueue>(ws, selector);
+  } else {
+    queue = std::make_unique<LinearEdgeQueue>(ws, selector);
+  }
 
-    const EdgeKey best_edge = best_edge_ptr->first;
-    if (!edge_selector.updateFromEdge(best_edge)) {
-      // we've hit a stop criteria
-      break;
+  VLOG(10) << "-----------------------------------";
+  VLOG(10) << "Scoring edges";
+  VLOG(10) << "-----------------------------------";
+  {  // initial scoring
+    PhaseTimer timer(stats.scoring_time);
+    std::vector<EdgeKey> edges;
+    edges.reserve(ws.edges.size());
+    for (const auto& edge_weight : ws.edges) {
+      edges.push_back(edge_weight.first);
     }
 
-    const auto changed_edges = ws.addMerge(best_edge);
-    VLOG(10) << "-----------------------------------";
-    VLOG(10) << "Scoring changed edges";
-    VLOG(10) << "-----------------------------------";
-    for (const auto edge : changed_edges) {
-      const auto score = edge_selector.scoreEdge(edge);
-      VLOG(10) << "edge " << edge << ": " << score;
-      ws.edges[edge] = score;
+    const auto scores = scoreEdges(selector, edges, pool, config.scoring_grain_size);
+    for (size_t i = 0; i < edges.size(); ++i) {
+      VLOG(10) << "edge (" << edges[i] << "): " << scores[i];
+      queue->update(edges[i], scores[i]);
     }
-    VLOG(10) << "-----------------------------------";
+  }
+  stats.edges_scored = ws.edges.size();
+  VLOG(10) << "-----------------------------------";
+
+  MergeScheduler::Ptr scheduler;
+  if (config.batch_merges) {
+    scheduler = std::make_unique<BatchMergeScheduler>(pool, config.scoring_grain_size);
+  } else {
+    scheduler =
+        std::make_unique<SequentialMergeScheduler>(pool, config.scoring_grain_size);
   }
 
+  const auto merge_start = std::chrono::steady_clock::now();
+  scheduler->run(ws, selector, *queue, stats);
+  stats.merge_time = std::chrono::steady_clock::now() - merge_start;
+
   VLOG(verbosity) << "[IB] " << edge_selector.summarize();
+  return stats;
 }
 
 AgglomerativeClustering::AgglomerativeClustering(const Config& config)
     : config(config::checkValid(config)),
       tasks_(config.tasks.create()),
       metric_(config.metric.create()),
-      edge_selector_(new IBEdgeSelector(config.selector)) {}
+      task_index_(std::make_unique<TaskIndex>(config.task_index, *tasks_, *metric_)),
+      edge_selector_(new IBEdgeSelector(config.selector)),
+      pool_(std::make_unique<ThreadPool>(config.num_threads)) {}
 
 Clusters AgglomerativeClustering::cluster(const SceneGraphLayer& layer,
                                           const NodeEmbeddingMap& features) const {
+  updateTasks();
+  return cluster(layer, features, -1, 1);
+}
+
+Clusters AgglomerativeClustering::cluster(const SceneGraphLayer& layer,
+                                          const NodeEmbeddingMap& features,
+                                          double I_xy_full,
+                                          double delta_weight) const {
+  stats_ = {};
   if (tasks_->empty()) {
     LOG_FIRST_N(ERROR, 5) << "No tasks present: cannot cluster";
     return {};
   }
 
   ClusteringWorkspace ws(layer, features);
-  clusterAgglomerative(ws, *tasks_, *edge_selector_, *metric_);
+  stats_ = clusterAgglomerative(ws,
+                                *tasks_,
+                                *edge_selector_,
+                                *metric_,
+                                I_xy_full >= 0.0,
+                                I_xy_full,
+                                delta_weight,
+                                5,
+                                config.agglomeration,
+                                pool_.get());
+  stats_.components_clustered = 1;
 
   const auto to_return = getClusters(ws, features);
   VLOG(1) << "[IB] finished clustering with " << to_return.size() << " cluster(s)";
+  VLOG(2) << "[IB] " << stats_;
   return to_return;
 }
 
+Dendrogram AgglomerativeClustering::buildDendrogram(
+    const SceneGraphLayer& layer, const NodeEmbeddingMap& features) const {
+  updateTasks();
+  stats_ = {};
+  Dendrogram dendrogram;
+  if (tasks_->empty()) {
+    LOG_FIRST_N(ERROR, 5) << "No tasks present: cannot cluster";
+    return dendrogram;
+  }
+
+  ClusteringWorkspace ws(layer, features);
+  stats_ = clusterAgglomerative(ws,
+                                *tasks_,
+                                *edge_selector_,
+                                *metric_,
+                                false,
+                                -1,
+                                1,
+                                5,
+                                config.agglomeration,
+                                pool_.get(),
+                                &dendrogram);
+  stats_.components_clustered = 1;
+  VLOG(1) << "[IB] recorded " << dendrogram.merges().size() << " merge(s)";
+  return dendrogram;
+}
+
+void AgglomerativeClustering::setTasks(hydra::EmbeddingGroup::Ptr tasks) {
+  pending_tasks_.set(std::move(tasks));
+}
+
+bool AgglomerativeClustering::updateTasks() const {
+  auto tasks = pending_tasks_.take();
+  if (!tasks) {
+    return false;
+  }
+
+  // the index refers to the tasks, so it has to be replaced first
+  task_index_ = std::make_unique<TaskIndex>(config.task_index, *tasks, *metric_);
+  tasks_ = std::move(tasks);
+  VLOG(1) << "[IB] switched to " << tasks_->embeddings.size() << " task(s)";
+  return true;
+}
+
 Clusters AgglomerativeClustering::getClusters(const ClusteringWorkspace& ws,
                                               const NodeEmbeddingMap& features) const {
-  const auto cluster_nodes = ws.getClusters();
+  return makeClusters(ws.getClusters(), features);
+}
+
+Clusters AgglomerativeClustering::getClusters(const Dendrogram& dendrogram,
+                                              double max_delta,
+                                              const NodeEmbeddingMap& features) const {
+  return makeClusters(dendrogram.getClusters(max_delta), features);
+}
 
+Clusters AgglomerativeClustering::makeClusters(
+    const std::vector<std::vector<NodeId>>& cluster_nodes,
+    const NodeEmbeddingMap& features) const {
   Clusters to_return;
   for (const auto& nodes : cluster_nodes) {
     auto cluster = std::make_shared<Cluster>();
@@ -135,7 +285,11 @@ Clusters AgglomerativeClustering::getClusters(const ClusteringWorkspace& ws,
 
     cluster->feature /= cluster->nodes.size();
 
-    const auto info = tasks_->getBestScore(*metric_, cluster->feature);
+    // scores of filtered regions are never used, so they don't have to be exact
+    const auto min_score = config.filter_regions
+                               ? config.selector.py_x.score_threshold
+                               : -std::numeric_limits<double>::infinity();
+    const auto info = task_index_->getBestScore(cluster->feature, min_score);
     if (config.filter_regions && info.score < config.selector.py_x.score_threshold) {
       continue;
     }
@@ -0,0 +1,28 @@
+#include "clio/async_job.h"
+
+#include <spark_dsg/node_attributes.h>
+
+namespace clio {
+
+using namespace spark_dsg;
+
+std::unique_ptr<IsolatedSceneGraphLayer> copyLayerTopology(
+    const SceneGraphLayer& layer, const std::vector<NodeId>& nodes) {
+  auto copy = std::make_unique<IsolatedSceneGraphLayer>(layer.id);
+  for (const auto node_id : nodes) {
+    copy->emplaceNode(node_id, std::make_unique<NodeAttributes>());
+  }
+
+  for (const auto node_id : nodes) {
+    for (const auto sibling : layer.getNode(node_id).siblings()) {
+      // every edge is visited from both ends, so only insert it once
+      if (sibling < node_id && copy->hasNode(sibling)) {
+        copy->insertEdge(sibling, node_id);
+      }
+    }
+  }
+
+  return copy;
+}
+
+}  // namespace clio
@@ -0,0 +1,288 @@
+#include "clio/batch_clustering.h"
+
+#include <config_utilities/config.h>
+#include <config_utilities/validation.h>
+#include <glog/logging.h>
+#include <spark_dsg/node_attributes.h>
+#include <yaml-cpp/yaml.h>
+
+#include <algorithm>
+#include <deque>
+#include <iterator>
+#include <set>
+#include <unordered_map>
+
+#include "clio/async_job.h"
+#include "clio/bounding_box_index.h"
+#include "clio/ib_utils.h"
+#include "clio/object_update_functor.h"
+#include "clio/probability_utilities.h"
+
+namespace clio {
+
+using namespace spark_dsg;
+
+void declare_config(FileEmbeddingGroup::Config& config) {
+  using namespace config;
+  name("FileEmbeddingGroup::Config");
+  field(config.path, "path");
+  checkCondition(!config.path.empty(), "path is required");
+}
+
+FileEmbeddingGroup::FileEmbeddingGroup(const Config& config)
+    : config(config::checkValid(config)) {
+  YAML::Node root;
+  try {
+    root = YAML::LoadFile(config.path);
+  } catch (const std::exception& e) {
+    LOG(ERROR) << "Failed to read task embeddings from '" << config.path
+               << "': " << e.what();
+    return;
+  }
+
+  const auto names_node = root["names"];
+  const auto embeddings_node = root["embeddings"];
+  if (!names_node || !embeddings_node || names_node.size() != embeddings_node.size()) {
+    LOG(ERROR) << "'" << config.path << "' needs one name per task embedding";
+    return;
+  }
+
+  for (size_t i = 0; i < embeddings_node.size(); ++i) {
+    const auto values = embeddings_node[i].as<std::vector<float>>();
+    const auto dim = static_cast<Eigen::Index>(values.size());
+    if (!embeddings.empty() && dim != embeddings.front().size()) {
+      LOG(ERROR) << "Task embeddings in '" << config.path << "' differ in size";
+      names.clear();
+      embeddings.clear();
+      return;
+    }
+
+    names.push_back(names_node[i].as<std::string>());
+    embeddings.push_back(Eigen::Map<const Eigen::VectorXf>(values.data(), dim));
+  }
+
+  VLOG(1) << "Loaded " << embeddings.size() << " task(s) from '" << config.path << "'";
+}
+
+void declare_config(BatchClusteringConfig& config) {
+  using namespace config;
+  name("BatchClusteringConfig");
+  field(config.selector, "selector");
+  field(config.agglomeration, "agglomeration");
+  field(config.prune_threshold, "prune_threshold");
+  field(config.partition, "partition");
+  field(config.recompute_edges, "recompute_edges");
+  field(config.bbox_dilation, "bbox_dilation");
+  field(config.index_resolution, "index_resolution");
+  check(config.bbox_dilation, GE, 0.0, "bbox_dilation");
+  check(config.index_resolution, GT, 0.0, "index_resolution");
+}
+
+namespace {
+
+// replace the edges of the layer with edges between overlapping (dilated) boxes
+void addOverlapEdges(const SceneGraphLayer& segments,
+                     const BatchClusteringConfig& config,
+                     IsolatedSceneGraphLayer& layer) {
+  std::vector<EdgeKey> to_remove;
+  for (const auto& key_edge : layer.edges()) {
+    to_remove.push_back(key_edge.first);
+  }
+
+  for (const auto& key : to_remove) {
+    layer.removeEdge(key.k1, key.k2);
+  }
+
+  BoundingBoxIndex index(config.index_resolution);
+  for (const auto& id_node : segments.nodes()) {
+    const auto& attrs = id_node.second->attributes<SemanticNodeAttributes>();
+    auto box = getIndexBox(attrs.bounding_box);
+    if (attrs.bounding_box.isValid() && config.bbox_dilation > 0.0) {
+      const Eigen::Vector3f padding = config.bbox_dilation * box.sizes();
+      box.min() -= padding;
+      box.max() += padding;
+    }
+
+    index.insert(id_node.first, box);
+  }
+
+  for (const auto& id_box : index.boxes()) {
+    for (const auto other : index.query(id_box.second)) {
+      if (other < id_box.first) {
+        layer.insertEdge(other, id_box.first);
+      }
+    }
+  }
+}
+
+std::vector<std::vector<NodeId>> getComponents(const SceneGraphLayer& layer) {
+  std::vector<std::vector<NodeId>> components;
+  std::set<NodeId> visited;
+  for (const auto& id_node : layer.nodes()) {
+    if (visited.count(id_node.first)) {
+      continue;
+    }
+
+    auto& component = components.emplace_back();
+    std::deque<NodeId> frontier{id_node.first};
+    visited.insert(id_node.first);
+    while (!frontier.empty()) {
+      const auto node_id = frontier.front();
+      frontier.pop_front();
+      component.push_back(node_id);
+      for (const auto sibling : layer.getNode(node_id).siblings()) {
+        if (visited.insert(sibling).second) {
+          frontier.push_back(sibling);
+        }
+      }
+    }
+
+    // workspace indices follow node ID order
+    std::sort(component.begin(), component.end());
+  }
+
+  return components;
+}
+
+NodeAttributes::Ptr mergeSegments(const SceneGraphLayer& segments,
+                                  const std::vector<NodeId>& nodes,
+                                  const Eigen::VectorXf& feature) {
+  auto attrs_ptr = segments.getNode(nodes.front()).attributes().clone();
+  auto& attrs = *CHECK_NOTNULL(dynamic_cast<KhronosObjectAttributes*>(attrs_ptr.get()));
+  attrs.semantic_feature = feature;
+
+  std::vector<const KhronosObjectAttributes*> others;
+  others.reserve(nodes.size() - 1);
+  for (auto iter = std::next(nodes.begin()); iter != nodes.end(); ++iter) {
+    const auto& other = segments.getNode(*iter).attributes<KhronosObjectAttributes>();
+    attrs.position += other.position;
+    attrs.last_update_time_ns =
+        std::max(attrs.last_update_time_ns, other.last_update_time_ns);
+    others.push_back(&other);
+  }
+
+  mergeObjectAttributes(others, attrs);
+  attrs.position /= nodes.size();
+  return attrs_ptr;
+}
+
+}  // namespace
+
+BatchClusteringResult clusterSegments(const DynamicSceneGraph& graph,
+                                      const hydra::EmbeddingGroup& tasks,
+                                      const hydra::EmbeddingDistance& metric,
+                                      const BatchClusteringConfig& config) {
+  BatchClusteringResult result;
+  result.graph = graph.clone();
+  std::vector<NodeId> to_remove;
+  for (const auto& id_node : graph.getLayer(DsgLayers::OBJECTS).nodes()) {
+    to_remove.push_back(id_node.first);
+  }
+
+  for (const auto node_id : to_remove) {
+    result.graph->removeNode(node_id);
+  }
+
+  const auto& segments = graph.getLayer(DsgLayers::SEGMENTS);
+  if (tasks.empty() || !segments.numNodes()) {
+    LOG_IF(ERROR, tasks.empty()) << "No tasks present: cannot cluster";
+    return result;
+  }
+
+  std::vector<NodeId> nodes;
+  std::unordered_map<NodeId, size_t> order;
+  for (const auto& id_node : segments.nodes()) {
+    order.emplace(id_node.first, nodes.size());
+    nodes.push_back(id_node.first);
+  }
+
+  // edges are only changed for clustering and never written back to the graph
+  auto layer = copyLayerTopology(segments, nodes);
+  if (config.recompute_edges || !layer->numEdges()) {
+    addOverlapEdges(segments, config, *layer);
+  }
+
+  const auto features = getPooledFeatures(segments, nodes);
+  double I_xy_full = -1.0;
+  if (config.partition) {
+    // p(x) is uniform
+    const auto N = static_cast<double>(nodes.size());
+    const Eigen::VectorXd px = Eigen::VectorXd::Constant(nodes.size(), 1.0 / N);
+    const auto py_x = computeIBpyGivenX(features, tasks, metric, config.selector.py_x);
+    I_xy_full = mutualInformation(computeIBpy(tasks), px, py_x);
+  }
+
+  std::vector<std::vector<NodeId>> components;
+  if (config.partition) {
+    components = getComponents(*layer);
+  } else {
+    components.push_back(nodes);
+  }
+
+  std::vector<std::vector<NodeId>> clusters;
+  IBEdgeSelector selector(config.selector);
+  ClusteringWorkspace ws;
+  Eigen::MatrixXf component_features;
+  for (const auto& component : components) {
+    component_features.resize(features.rows(), component.size());
+    for (size_t i = 0; i < component.size(); ++i) {
+      component_features.col(i) = features.col(order.at(component[i]));
+    }
+
+    ws.reset(*layer, component, component_features);
+    if (!ws.edges.empty()) {
+      const double delta_weight = static_cast<double>(component.size()) / nodes.size();
+      result.stats += clusterAgglomerative(ws,
+                                           tasks,
+                                           selector,
+                                           metric,
+                                           config.partition,
+                                           I_xy_full,
+                                           delta_weight,
+                                           5,
+                                           config.agglomeration);
+    }
+
+    auto component_clusters = ws.getClusters();
+    std::move(component_clusters.begin(),
+              component_clusters.end(),
+              std::back_inserter(clusters));
+  }
+
+  result.stats.components_clustered = components.size();
+  result.num_clusters = clusters.size();
+  Eigen::MatrixXf cluster_features(features.rows(), clusters.size());
+  cluster_features.setZero();
+  for (size_t i = 0; i < clusters.size(); ++i) {
+    for (const auto node_id : clusters[i]) {
+      cluster_features.col(i) += features.col(order.at(node_id));
+    }
+
+    cluster_features.col(i) /= clusters[i].size();
+  }
+
+  // scored in one batch (see computeTaskScores)
+  const auto scores = computeTaskScores(cluster_features, tasks, metric);
+  for (size_t i = 0; i < clusters.size(); ++i) {
+    const auto& cluster = clusters[i];
+    if (scores.col(i).maxCoeff() < config.prune_threshold) {
+      continue;
+    }
+
+    const NodeSymbol object_id('O', i);
+    auto attrs = mergeSegments(segments, cluster, cluster_features.col(i));
+    result.graph->emplaceNode(DsgLayers::OBJECTS, object_id, std::move(attrs));
+    for (const auto node_id : cluster) {
+      result.graph->insertEdge(object_id, node_id);
+    }
+
+    ++result.num_objects;
+  }
+
+  VLOG(1) << "[IB] clustered " << nodes.size() << " segment(s) into "
+          << result.num_clusters << " cluster(s) (" << result.num_objects
+          << " object(s))";
+  return result;
+}
+
+}  // namespace clio
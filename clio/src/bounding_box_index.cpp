@@ -0,0 +1,140 @@
+#include "clio/bounding_box_index.h"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace clio {
+
+double BoundingBoxIndex::CellRange::numCells() const {
+  return ((max - min).cast<double>().array() + 1.0).prod();
+}
+
+size_t BoundingBoxIndex::CellHash::operator()(const Eigen::Vector3i& index) const {
+  // large primes from Teschner et al., "Optimized Spatial Hashing for Collision
+  // Detection of Deformable Objects"
+  return static_cast<size_t>(index.x()) * 73856093 ^
+         static_cast<size_t>(index.y()) * 19349663 ^
+         static_cast<size_t>(index.z()) * 83492791;
+}
+
+BoundingBoxIndex::BoundingBoxIndex(double cell_size, size_t max_cells_per_box)
+    : cell_size_(cell_size), max_cells_per_box_(max_cells_per_box) {
+  CHECK_GT(cell_size, 0.0) << "invalid index cell size";
+}
+
+BoundingBoxIndex::CellRange BoundingBoxIndex::getRange(const Box& box) const {
+  // clamped so that unbounded boxes land in (very large) ranges of valid cells
+  constexpr float max_index = 1 << 20;
+  CellRange range;
+  range.min = (box.min() / cell_size_)
+                  .array()
+                  .floor()
+                  .max(-max_index)
+                  .min(max_index)
+                  .cast<int>();
+  range.max = (box.max() / cell_size_)
+                  .array()
+                  .floor()
+                  .max(-max_index)
+                  .min(max_index)
+                  .cast<int>();
+  return range;
+}
+
+void BoundingBoxIndex::insert(NodeId node, const Box& box) {
+  erase(node);
+  boxes_.emplace(node, box);
+  if (box.isEmpty()) {
+    // can never overlap anything, but still tracked so that erase works
+    return;
+  }
+
+  const auto range = getRange(box);
+  if (range.numCells() > max_cells_per_box_) {
+    oversized_.insert(node);
+    return;
+  }
+
+  forEachCell(range,
+              [&](const Eigen::Vector3i& index) { cells_[index].push_back(node); });
+}
+
+bool BoundingBoxIndex::erase(NodeId node) {
+  const auto iter = boxes_.find(node);
+  if (iter == boxes_.end()) {
+    return false;
+  }
+
+  const auto box = iter->second;
+  boxes_.erase(iter);
+  if (box.isEmpty() || oversized_.erase(node)) {
+    return true;
+  }
+
+  forEachCell(getRange(box), [&](const Eigen::Vector3i& index) {
+    auto cell = cells_.find(index);
+    if (cell == cells_.end()) {
+      return;
+    }
+
+    auto& nodes = cell->second;
+    nodes.erase(std::remove(nodes.begin(), nodes.end(), node), nodes.end());
+    if (nodes.empty()) {
+      cells_.erase(cell);
+    }
+  });
+
+  return true;
+}
+
+const BoundingBoxIndex::Box* BoundingBoxIndex::getBox(NodeId node) const {
+  const auto iter = boxes_.find(node);
+  return iter == boxes_.end() ? nullptr : &iter->second;
+}
+
+std::vector<NodeId> BoundingBoxIndex::query(const Box& box) const {
+  std::vector<NodeId> result;
+  if (box.isEmpty()) {
+    return result;
+  }
+
+  const auto add_if_overlapping = [&](NodeId node) {
+    if (boxes_.at(node).intersects(box)) {
+      result.push_back(node);
+    }
+  };
+
+  const auto range = getRange(box);
+  if (range.numCells() > std::max(max_cells_per_box_, boxes_.size())) {
+    // cheaper to check every box than every cell
+    for (const auto& id_box_pair : boxes_) {
+      if (id_box_pair.second.intersects(box)) {
+        result.push_back(id_box_pair.first);
+      }
+    }
+  } else {
+    for (const auto node : oversized_) {
+      add_if_overlapping(node);
+    }
+
+    forEachCell(range, [&](const Eigen::Vector3i& index) {
+      const auto cell = cells_.find(index);
+      if (cell == cells_.end()) {
+        return;
+      }
+
+      for (const auto node : cell->second) {
+        add_if_overlapping(node);
+      }
+    });
+  }
+
+  // boxes spanning several cells are found once per shared cell
+  std::sort(result.begin(), result.end());
+  result.erase(std::unique(result.begin(), result.end()), result.end());
+  return result;
+}
+
+}  // namespace clio
@@ -0,0 +1,255 @@
+#include "clio/clustering_snapshot.h"
+
+#include <glog/logging.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace clio {
+namespace {
+
+constexpr char kMagic[8] = {'C', 'L', 'I', 'O', 'O', 'B', 'J', 'S'};
+constexpr size_t kAlignment = 8;
+
+class SnapshotWriter {
+ public:
+  explicit SnapshotWriter(const std::string& filepath)
+      : out_(filepath, std::ios::binary | std::ios::trunc) {}
+
+  bool good() const { return out_.good(); }
+
+  //! flush and close the file (true if every write succeeded)
+  bool close() {
+    out_.close();
+    return !out_.fail();
+  }
+
+  void bytes(const void* data, size_t size) {
+    out_.write(static_cast<const char*>(data), size);
+    const char padding[kAlignment] = {};
+    const size_t remainder = size % kAlignment;
+    if (remainder) {
+      out_.write(padding, kAlignment - remainder);
+    }
+  }
+
+  void value(uint64_t value) { bytes(&value, sizeof(value)); }
+
+  void ids(const std::vector<NodeId>& ids) {
+    value(ids.size());
+    bytes(ids.data(), ids.size() * sizeof(NodeId));
+  }
+
+  void objects(const std::map<NodeId, std::vector<NodeId>>& objects) {
+    value(objects.size());
+    for (const auto& [object_id, segments] : objects) {
+      value(object_id);
+      ids(segments);
+    }
+  }
+
+ private:
+  std::ofstream out_;
+};
+
+class SnapshotReader {
+ public:
+  explicit SnapshotReader(const std::string& filepath)
+      : in_(filepath, std::ios::binary) {}
+
+  bool good() const { return in_.good(); }
+
+  bool bytes(void* data, size_t size) {
+    in_.read(static_cast<char*>(data), size);
+    char padding[kAlignment];
+    const size_t remainder = size % kAlignment;
+    if (remainder) {
+      in_.read(padding, kAlignment - remainder);
+    }
+
+    return in_.good();
+  }
+
+  bool value(uint64_t& value) { return bytes(&value, sizeof(value)); }
+
+  //! read a length that has to fit in the rest of the file
+  bool count(uint64_t& value, size_t element_size) {
+    if (!this->value(value)) {
+      return false;
+    }
+
+    const auto pos = in_.tellg();
+    in_.seekg(0, std::ios::end);
+    const auto remaining = static_cast<uint64_t>(in_.tellg() - pos);
+    in_.seekg(pos);
+    return element_size == 0 || value <= remaining / element_size;
+  }
+
+  bool ids(std::vector<NodeId>& ids) {
+    uint64_t size;
+    if (!count(size, sizeof(NodeId))) {
+      return false;
+    }
+
+    ids.resize(size);
+    return bytes(ids.data(), size * sizeof(NodeId));
+  }
+
+  bool objects(std::map<NodeId, std::vector<NodeId>>& objects) {
+    uint64_t size;
+    if (!count(size, 2 * sizeof(uint64_t))) {
+      return false;
+    }
+
+    for (uint64_t i = 0; i < size; ++i) {
+      uint64_t object_id;
+      if (!value(object_id) || !ids(objects[object_id])) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+ private:
+  std::ifstream in_;
+};
+
+void fnv1a(uint64_t& hash, const void* data, size_t size) {
+  const auto bytes = static_cast<const unsigned char*>(data);
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ull;
+  }
+}
+
+}  // namespace
+
+bool ObjectClusteringSnapshot::save(const std::string& filepath) const {
+  const size_t num_stats = stat_nodes.size();
+  CHECK_EQ(static_cast<size_t>(features.cols()), num_stats);
+  CHECK_EQ(static_cast<size_t>(py_x.cols()), num_stats);
+  CHECK_EQ(static_cast<size_t>(information.size()), num_stats);
+
+  // the existing file is only replaced once the new one is complete, so a crash
+  // while saving never leaves a truncated snapshot behind
+  const std::string tmp_path = filepath + ".tmp";
+  SnapshotWriter writer(tmp_path);
+  writer.bytes(kMagic, sizeof(kMagic));
+  writer.value(kVersion);
+  writer.value(task_fingerprint);
+  writer.value(next_object_id);
+
+  writer.value(components.size());
+  for (const auto& component : components) {
+    writer.ids(component.segments);
+    writer.objects(component.objects);
+  }
+
+  writer.objects(previous_objects);
+  writer.ids(ignored);
+  writer.ids(active);
+
+  writer.ids(stat_nodes);
+  writer.value(features.rows());
+  writer.bytes(features.data(), features.size() * sizeof(float));
+  writer.value(py_x.rows());
+  writer.bytes(py_x.data(), py_x.size() * sizeof(double));
+  writer.bytes(information.data(), information.size() * sizeof(double));
+
+  if (!writer.close()) {
+    LOG(ERROR) << "Failed to write clustering snapshot to '" << tmp_path << "'";
+    std::remove(tmp_path.c_str());
+    return false;
+  }
+
+  if (std::rename(tmp_path.c_str(), filepath.c_str()) != 0) {
+    LOG(ERROR) << "Failed to move clustering snapshot to '" << filepath
+               << "': " << std::strerror(errno);
+    std::remove(tmp_path.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+std::optional<ObjectClusteringSnapshot> ObjectClusteringSnapshot::load(
+    const std::string& filepath) {
+  SnapshotReader reader(filepath);
+  if (!reader.good()) {
+    return std::nullopt;
+  }
+
+  char magic[sizeof(kMagic)];
+  uint64_t version;
+  if (!reader.bytes(magic, sizeof(magic)) ||
+      std::memcmp(magic, kMagic, sizeof(kMagic)) != 0 || !reader.value(version)) {
+    LOG(ERROR) << "'" << filepath << "' is not a clustering snapshot";
+    return std::nullopt;
+  }
+
+  if (version != kVersion) {
+    LOG(ERROR) << "Clustering snapshot '" << filepath << "' has version " << version
+               << " (expected " << kVersion << ")";
+    return std::nullopt;
+  }
+
+  ObjectClusteringSnapshot snapshot;
+  uint64_t num_components;
+  bool valid = reader.value(snapshot.task_fingerprint) &&
+               reader.value(snapshot.next_object_id) &&
+               reader.count(num_components, 2 * sizeof(uint64_t));
+  for (uint64_t i = 0; valid && i < num_components; ++i) {
+    auto& component = snapshot.components.emplace_back();
+    valid = reader.ids(component.segments) && reader.objects(component.objects);
+  }
+
+  valid = valid && reader.objects(snapshot.previous_objects) &&
+          reader.ids(snapshot.ignored) && reader.ids(snapshot.active) &&
+          reader.ids(snapshot.stat_nodes);
+
+  const size_t num_stats = snapshot.stat_nodes.size();
+  uint64_t feature_dim = 0;
+  uint64_t num_labels = 0;
+  if (valid && reader.count(feature_dim, num_stats * sizeof(float))) {
+    snapshot.features.resize(feature_dim, num_stats);
+    valid = reader.bytes(snapshot.features.data(),
+                         snapshot.features.size() * sizeof(float));
+  } else {
+    valid = false;
+  }
+
+  if (valid && reader.count(num_labels, num_stats * sizeof(double))) {
+    snapshot.py_x.resize(num_labels, num_stats);
+    snapshot.information.resize(num_stats);
+    valid = reader.bytes(snapshot.py_x.data(), snapshot.py_x.size() * sizeof(double)) &&
+            reader.bytes(snapshot.information.data(), num_stats * sizeof(double));
+  } else {
+    valid = false;
+  }
+
+  if (!valid) {
+    LOG(ERROR) << "Clustering snapshot '" << filepath << "' is truncated";
+    return std::nullopt;
+  }
+
+  return snapshot;
+}
+
+uint64_t getTaskFingerprint(const hydra::EmbeddingGroup& tasks) {
+  uint64_t hash = 14695981039346656037ull;
+  for (const auto& name : tasks.names) {
+    fnv1a(hash, name.data(), name.size() + 1);
+  }
+
+  for (const auto& embedding : tasks.embeddings) {
+    const Eigen::VectorXf values = embedding.cast<float>();
+    fnv1a(hash, values.data(), values.size() * sizeof(float));
+  }
+
+  return hash;
+}
+
+}  // namespace clio
@@ -0,0 +1,79 @@
+#include "clio/clustering_stats.h"
+
+#include <glog/logging.h>
+#include <hydra/common/global_info.h>
+
+#include <filesystem>
+
+namespace clio {
+
+namespace {
+
+inline double toMs(const ClusteringStats::Duration& duration) {
+  return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+}  // namespace
+
+ClusteringStats& ClusteringStats::operator+=(const ClusteringStats& other) {
+  edges_scored += other.edges_scored;
+  merges += other.merges;
+  rounds += other.rounds;
+  components_clustered += other.components_clustered;
+  components_allocated += other.components_allocated;
+  segments_compared += other.segments_compared;
+  vertices_merged += other.vertices_merged;
+  setup_time += other.setup_time;
+  scoring_time += other.scoring_time;
+  merge_time += other.merge_time;
+  return *this;
+}
+
+std::ostream& operator<<(std::ostream& out, const ClusteringStats& stats) {
+  out << stats.components_clustered << " component(s) ("
+      << stats.components_allocated << " allocated), " << stats.edges_scored
+      << " edge(s) scored, " << stats.merges << " merge(s) in " << stats.rounds
+      << " round(s), " << stats.segments_compared << " segment pair(s) compared, "
+      << stats.vertices_merged << " vertices merged [setup: "
+      << toMs(stats.setup_time) << " ms, scoring: " << toMs(stats.scoring_time)
+      << " ms, merging: " << toMs(stats.merge_time) << " ms]";
+  return out;
+}
+
+ClusteringStatsLog::ClusteringStatsLog(const std::string& name) : name_(name) {}
+
+void ClusteringStatsLog::record(uint64_t timestamp_ns, const ClusteringStats& stats) {
+  if (!initialized_) {
+    initialized_ = true;
+    const auto& logs = hydra::GlobalInfo::instance().getLogs();
+    if (!logs || !logs->valid()) {
+      return;
+    }
+
+    const std::filesystem::path log_dir = logs->getLogDir("backend");
+    std::filesystem::create_directories(log_dir);
+    const auto filepath = log_dir / (name_ + "_stats.csv");
+    file_ = std::make_unique<std::ofstream>(filepath);
+    if (!file_->good()) {
+      LOG(ERROR) << "Unable to write clustering stats to " << filepath;
+      file_.reset();
+      return;
+    }
+
+    *file_ << "timestamp_ns,edges_scored,merges,rounds,components_clustered,"
+           << "components_allocated,segments_compared,vertices_merged,setup_ms,"
+           << "scoring_ms,merge_ms\n";
+  }
+
+  if (!file_) {
+    return;
+  }
+
+  *file_ << timestamp_ns << "," << stats.edges_scored << "," << stats.merges << ","
+         << stats.rounds << "," << stats.components_clustered << ","
+         << stats.components_allocated << "," << stats.segments_compared << ","
+         << stats.vertices_merged << "," << toMs(stats.setup_time) << ","
+         << toMs(stats.scoring_time) << "," << toMs(stats.merge_time) << "\n";
+}
+
+}  // namespace clio
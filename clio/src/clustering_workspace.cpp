@@ -4,6 +4,7 @@
 #include <hydra/utils/display_utilities.h>
 #include <spark_dsg/node_attributes.h>
 
+#include <algorithm>
 #include <numeric>
 
 namespace clio {
@@ -11,113 +12,221 @@ namespace clio {
 using namespace spark_dsg;
 using EmbeddingMap = std::map<NodeId, Eigen::VectorXf>;
 
-bool keysIntersect(EdgeKey key1, EdgeKey key2) {
-  return key1.k1 == key2.k1 || key1.k1 == key2.k2 || key1.k2 == key2.k1 ||
-         key1.k2 == key2.k2;
+namespace {
+
+inline void insertSorted(std::vector<size_t>& values, size_t value) {
+  const auto iter = std::lower_bound(values.begin(), values.end(), value);
+  if (iter == values.end() || *iter != value) {
+    values.insert(iter, value);
+  }
+}
+
+inline void eraseSorted(std::vector<size_t>& values, size_t value) {
+  const auto iter = std::lower_bound(values.begin(), values.end(), value);
+  if (iter != values.end() && *iter == value) {
+    values.erase(iter);
+  }
 }
 
-EmbeddingMap getEmbeddingMap(const std::map<NodeId, SceneGraphNode::Ptr>& nodes) {
-  EmbeddingMap features;
-  for (const auto& id_node : nodes) {
-    const auto& attrs = id_node.second->attributes<SemanticNodeAttributes>();
+}  // namespace
+
+std::vector<NodeId> getNodeIds(const SceneGraphLayer& layer) {
+  std::vector<NodeId> nodes;
+  nodes.reserve(layer.numNodes());
+  for (const auto& id_node : layer.nodes()) {
+    nodes.push_back(id_node.first);
+  }
+
+  return nodes;
+}
+
+Eigen::MatrixXf getPooledFeatures(const SceneGraphLayer& layer,
+                                  const std::vector<NodeId>& nodes) {
+  if (nodes.empty()) {
+    return {};
+  }
+
+  Eigen::MatrixXf features;
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    const auto& attrs = layer.getNode(nodes[i]).attributes<SemanticNodeAttributes>();
+    if (i == 0) {
+      features.resize(attrs.semantic_feature.rows(), nodes.size());
+    }
+
     // TODO(nathan) consider other pooling operations
-    features[id_node.first] = attrs.semantic_feature.rowwise().mean();
+    features.col(i) = attrs.semantic_feature.rowwise().mean();
   }
 
   return features;
 }
 
-EmbeddingMap getEmbeddingMap(const SceneGraphLayer& layer,
-                             const std::vector<NodeId>& nodes) {
-  EmbeddingMap features;
-  for (const auto node : nodes) {
-    const auto& attrs = layer.getNode(node).attributes<SemanticNodeAttributes>();
-    // TODO(nathan) consider other pooling operations
-    features[node] = attrs.semantic_feature.rowwise().mean();
+Eigen::MatrixXf getFeatureMatrix(const EmbeddingMap& node_embeddings) {
+  if (node_embeddings.empty()) {
+    return {};
+  }
+
+  const auto dim = node_embeddings.begin()->second.rows();
+  Eigen::MatrixXf features(dim, node_embeddings.size());
+  size_t index = 0;
+  for (const auto& id_feature : node_embeddings) {
+    features.col(index) = id_feature.second;
+    ++index;
   }
 
   return features;
 }
 
+std::vector<NodeId> getNodeIds(const EmbeddingMap& node_embeddings) {
+  std::vector<NodeId> nodes;
+  nodes.reserve(node_embeddings.size());
+  for (const auto& id_feature : node_embeddings) {
+    nodes.push_back(id_feature.first);
+  }
+
+  return nodes;
+}
+
 ClusteringWorkspace::ClusteringWorkspace(const SceneGraphLayer& layer)
-    : ClusteringWorkspace(layer, getEmbeddingMap(layer.nodes())) {}
+    : ClusteringWorkspace(layer, getNodeIds(layer)) {}
 
 ClusteringWorkspace::ClusteringWorkspace(const SceneGraphLayer& layer,
                                          const std::vector<NodeId>& nodes)
-    : ClusteringWorkspace(layer, getEmbeddingMap(layer, nodes)) {}
+    : ClusteringWorkspace(layer, nodes, getPooledFeatures(layer, nodes)) {}
 
 ClusteringWorkspace::ClusteringWorkspace(const SceneGraphLayer& layer,
-                                         const EmbeddingMap& node_embeddings) {
-  size_t index = 0;
-  for (auto&& [node_id, feature] : node_embeddings) {
-    features[index] = feature;
+                                         const EmbeddingMap& node_embeddings)
+    : ClusteringWorkspace(
+          layer, getNodeIds(node_embeddings), getFeatureMatrix(node_embeddings)) {}
+
+ClusteringWorkspace::ClusteringWorkspace(const SceneGraphLayer& layer,
+                                         const std::vector<NodeId>& nodes,
+                                         const Eigen::MatrixXf& node_features) {
+  reset(layer, nodes, node_features);
+}
+
+void ClusteringWorkspace::reserve(size_t num_nodes) {
+  node_lookup.reserve(num_nodes);
+  parents.reserve(num_nodes);
+  neighbors.reserve(num_nodes);
+}
+
+void ClusteringWorkspace::reset(const SceneGraphLayer& layer,
+                                const std::vector<NodeId>& nodes,
+                                const Eigen::MatrixXf& node_features) {
+  CHECK_EQ(nodes.size(), static_cast<size_t>(node_features.cols()));
+  const size_t num_nodes = nodes.size();
+
+  // workspace indices follow node ID order
+  std::vector<size_t> sorted(num_nodes);
+  std::iota(sorted.begin(), sorted.end(), 0);
+  const bool is_sorted = std::is_sorted(nodes.begin(), nodes.end());
+  if (!is_sorted) {
+    std::sort(sorted.begin(), sorted.end(), [&](size_t lhs, size_t rhs) {
+      return nodes[lhs] < nodes[rhs];
+    });
+  }
+
+  // vectors are cleared instead of replaced so that they keep their capacity
+  node_lookup.resize(num_nodes);
+  edges.clear();
+  // the feature matrix only reallocates if its size changes
+  if (is_sorted) {
+    features = node_features;
+  } else {
+    features.resize(node_features.rows(), num_nodes);
+  }
+
+  for (size_t index = 0; index < num_nodes; ++index) {
+    const auto node_id = nodes[sorted[index]];
+    if (!is_sorted) {
+      features.col(index) = node_features.col(sorted[index]);
+    }
+
     node_lookup[index] = node_id;
-    order[node_id] = index;
-    ++index;
   }
 
-  for (auto&& [node_id, index] : order) {
-    const auto& node = layer.getNode(node_id);
+  // neighbor lists are cleared in place so that they keep their capacity
+  neighbors.resize(num_nodes);
+  for (size_t index = 0; index < num_nodes; ++index) {
+    auto& adjacent = neighbors[index];
+    adjacent.clear();
+    const auto& node = layer.getNode(node_lookup[index]);
     for (const auto& sibling : node.siblings()) {
-      auto iter = order.find(sibling);
-      if (iter == order.end()) {
+      const auto other = getIndex(sibling);
+      if (!other) {
         continue;
       }
 
-      edges.emplace(EdgeKey(index, iter->second), 0.0);
+      edges.emplace(EdgeKey(index, *other), 0.0);
+      adjacent.push_back(*other);
     }
+
+    std::sort(adjacent.begin(), adjacent.end());
   }
 
-  assignments.resize(order.size());
-  std::iota(assignments.begin(), assignments.end(), 0);
+  parents.resize(num_nodes);
+  std::iota(parents.begin(), parents.end(), 0);
 }
 
-size_t ClusteringWorkspace::size() const { return order.size(); }
+size_t ClusteringWorkspace::size() const { return node_lookup.size(); }
 
-size_t ClusteringWorkspace::featureDim() const {
-  if (features.empty()) {
-    return 0;
+size_t ClusteringWorkspace::featureDim() const { return features.rows(); }
+
+std::optional<size_t> ClusteringWorkspace::getIndex(NodeId node_id) const {
+  const auto iter = std::lower_bound(node_lookup.begin(), node_lookup.end(), node_id);
+  if (iter == node_lookup.end() || *iter != node_id) {
+    return std::nullopt;
   }
 
-  return features.begin()->second.rows();
+  return static_cast<size_t>(iter - node_lookup.begin());
 }
 
-std::list<EdgeKey> ClusteringWorkspace::addMerge(EdgeKey key) {
-  // TODO(nathan) there are more efficient ways to maintain this, but modfiying
-  // disjoint set right now is not the best decision
-  for (auto& parent : assignments) {
-    if (parent == key.k2) {
-      parent = key.k1;
-    }
+size_t ClusteringWorkspace::findRoot(size_t index) const {
+  while (parents.at(index) != index) {
+    index = parents[index];
   }
 
-  // clear all affected edge weights
-  std::set<EdgeKey> seen;
-  auto iter = edges.begin();
-  while (iter != edges.end()) {
-    if (keysIntersect(iter->first, key)) {
-      seen.insert(iter->first);
-      iter = edges.erase(iter);
-    } else {
-      ++iter;
-    }
+  return index;
+}
+
+std::vector<size_t> ClusteringWorkspace::getAssignments() const {
+  // merges always point the larger index at the smaller index, so every parent has
+  // already been resolved by the time we reach its children
+  std::vector<size_t> assignments(parents.size());
+  for (size_t i = 0; i < parents.size(); ++i) {
+    assignments[i] = parents[i] == i ? i : assignments[parents[i]];
   }
 
-  std::set<EdgeKey> new_keys;
-  std::list<EdgeKey> to_update;
-  for (const auto& prev : seen) {
-    const auto new_k1 = prev.k1 == key.k2 ? key.k1 : prev.k1;
-    const auto new_k2 = prev.k2 == key.k2 ? key.k1 : prev.k2;
-    if (new_k1 == new_k2) {
-      continue;
-    }
+  return assignments;
+}
 
-    const EdgeKey new_key(new_k1, new_k2);
-    if (new_keys.count(new_key)) {
-      continue;  // we got a duplicate key from a merge
-    }
+std::list<EdgeKey> ClusteringWorkspace::addMerge(EdgeKey key) {
+  // edge keys are ordered, so k1 is always the new root
+  const auto k1 = key.k1;
+  const auto k2 = key.k2;
+  CHECK_EQ(parents.at(k1), k1) << "merging non-root cluster " << k1;
+  CHECK_EQ(parents.at(k2), k2) << "merging non-root cluster " << k2;
+  parents[k2] = k1;
+
+  edges.erase(key);
+  eraseSorted(neighbors[k1], k2);
+  eraseSorted(neighbors[k2], k1);
+
+  // move all edges of k2 over to k1 (duplicates collapse into the existing edge)
+  for (const auto other : neighbors[k2]) {
+    edges.erase(EdgeKey(k2, other));
+    auto& other_neighbors = neighbors[other];
+    eraseSorted(other_neighbors, k2);
+    insertSorted(other_neighbors, k1);
+    insertSorted(neighbors[k1], other);
+  }
+  neighbors[k2].clear();
 
-    edges.emplace(new_key, 0.0);
+  // every edge of the merged cluster needs to be rescored
+  std::list<EdgeKey> to_update;
+  for (const auto other : neighbors[k1]) {
+    const EdgeKey new_key(k1, other);
+    edges[new_key] = 0.0;
     to_update.push_back(new_key);
   }
 
@@ -125,19 +234,19 @@ std::list<EdgeKey> ClusteringWorkspace::addMerge(EdgeKey key) {
 }
 
 std::vector<std::vector<NodeId>> ClusteringWorkspace::getClusters() const {
-  const std::set<size_t> cluster_ids(assignments.begin(), assignments.end());
+  const auto assignments = getAssignments();
 
-  size_t index = 0;
-  std::map<size_t, size_t> cluster_lookup;
-  for (const auto cluster_id : cluster_ids) {
-    cluster_lookup[cluster_id] = index;
-    ++index;
-  }
-
-  std::vector<std::vector<NodeId>> to_return(cluster_ids.size());
+  // roots are the first member of each cluster, so clusters are ordered by root
+  std::vector<size_t> cluster_lookup(assignments.size(), assignments.size());
+  std::vector<std::vector<NodeId>> to_return;
   for (size_t i = 0; i < assignments.size(); ++i) {
-    auto& cluster = to_return.at(cluster_lookup[assignments[i]]);
-    cluster.push_back(node_lookup.at(i));
+    auto& cluster_index = cluster_lookup[assignments[i]];
+    if (cluster_index == assignments.size()) {
+      cluster_index = to_return.size();
+      to_return.emplace_back();
+    }
+
+    to_return[cluster_index].push_back(node_lookup.at(i));
   }
 
   return to_return;
@@ -0,0 +1,69 @@
+#include "clio/dendrogram.h"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <numeric>
+
+namespace clio {
+
+void Dendrogram::reset(const std::vector<NodeId>& nodes) {
+  nodes_ = nodes;
+  merges_.clear();
+  max_deltas_.clear();
+  // at most one merge per node
+  merges_.reserve(nodes.size());
+  max_deltas_.reserve(nodes.size());
+}
+
+void Dendrogram::addMerge(EdgeKey edge, double delta) {
+  CHECK_LT(edge.k1, edge.k2) << "merges must point the larger index at the smaller";
+  CHECK_LT(edge.k2, nodes_.size()) << "merge outside of workspace";
+  merges_.push_back({edge, delta});
+  max_deltas_.push_back(max_deltas_.empty() ? delta
+                                            : std::max(max_deltas_.back(), delta));
+}
+
+size_t Dendrogram::numMerges(double max_delta) const {
+  // clustering stops at (and skips) the first merge with delta >= max_delta
+  const auto iter = std::lower_bound(max_deltas_.begin(), max_deltas_.end(), max_delta);
+  return std::distance(max_deltas_.begin(), iter);
+}
+
+std::vector<size_t> Dendrogram::getAssignments(double max_delta) const {
+  std::vector<size_t> assignments(nodes_.size());
+  std::iota(assignments.begin(), assignments.end(), 0);
+  const auto num_merges = numMerges(max_delta);
+  for (size_t i = 0; i < num_merges; ++i) {
+    const auto& edge = merges_[i].edge;
+    assignments[edge.k2] = edge.k1;
+  }
+
+  // parents always have smaller indices, so they are resolved before their children
+  for (size_t i = 0; i < assignments.size(); ++i) {
+    assignments[i] = assignments[i] == i ? i : assignments[assignments[i]];
+  }
+
+  return assignments;
+}
+
+std::vector<std::vector<NodeId>> Dendrogram::getClusters(double max_delta) const {
+  const auto assignments = getAssignments(max_delta);
+
+  // roots are the first member of each cluster, so clusters are ordered by root
+  std::vector<size_t> cluster_lookup(assignments.size(), assignments.size());
+  std::vector<std::vector<NodeId>> to_return;
+  for (size_t i = 0; i < assignments.size(); ++i) {
+    auto& cluster_index = cluster_lookup[assignments[i]];
+    if (cluster_index == assignments.size()) {
+      cluster_index = to_return.size();
+      to_return.emplace_back();
+    }
+
+    to_return[cluster_index].push_back(nodes_[i]);
+  }
+
+  return to_return;
+}
+
+}  // namespace clio
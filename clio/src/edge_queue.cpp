@@ -0,0 +1,125 @@
+#include "clio/edge_queue.h"
+
+#include <algorithm>
+
+namespace clio {
+
+EdgeQueue::EdgeQueue(ClusteringWorkspace& ws, const EdgeSelector& selector)
+    : ws_(ws), selector_(selector) {}
+
+bool EdgeQueue::better(const Entry& lhs, const Entry& rhs) const {
+  if (selector_.compareEdges(lhs, rhs)) {
+    return true;
+  }
+
+  if (selector_.compareEdges(rhs, lhs)) {
+    return false;
+  }
+
+  // equivalent scores: match min_element over the ordered edge map
+  return lhs.first < rhs.first;
+}
+
+LinearEdgeQueue::LinearEdgeQueue(ClusteringWorkspace& ws, const EdgeSelector& selector)
+    : EdgeQueue(ws, selector) {}
+
+void LinearEdgeQueue::update(EdgeKey edge, double score) { ws_.edges[edge] = score; }
+
+std::optional<EdgeQueue::Entry> LinearEdgeQueue::top() {
+  if (ws_.edges.empty()) {
+    return std::nullopt;
+  }
+
+  auto iter = std::min_element(
+      ws_.edges.begin(), ws_.edges.end(), [&](const auto& lhs, const auto& rhs) {
+        return selector_.compareEdges(lhs, rhs);
+      });
+  return *iter;
+}
+
+std::optional<double> LinearEdgeQueue::score(EdgeKey edge) const {
+  const auto iter = ws_.edges.find(edge);
+  if (iter == ws_.edges.end()) {
+    return std::nullopt;
+  }
+
+  return iter->second;
+}
+
+HeapEdgeQueue::HeapEdgeQueue(ClusteringWorkspace& ws, const EdgeSelector& selector)
+    : EdgeQueue(ws, selector) {
+  heap_.reserve(ws.edges.size());
+}
+
+bool HeapEdgeQueue::heapCompare(const HeapEntry& lhs, const HeapEntry& rhs) const {
+  // std heaps keep the "largest" element at the front
+  return better(rhs.entry, lhs.entry);
+}
+
+void HeapEdgeQueue::update(EdgeKey edge, double score) {
+  const auto stamp = next_stamp_++;
+  current_[edge] = {score, stamp};
+  heap_.push_back({{edge, score}, stamp});
+  std::push_heap(heap_.begin(), heap_.end(), [this](const auto& lhs, const auto& rhs) {
+    return heapCompare(lhs, rhs);
+  });
+
+  // stale entries accumulate with every rescore
+  if (heap_.size() > 2 * ws_.edges.size() + 16) {
+    compact();
+  }
+}
+
+bool HeapEdgeQueue::isValid(const HeapEntry& entry) const {
+  if (!ws_.edges.count(entry.entry.first)) {
+    return false;
+  }
+
+  const auto iter = current_.find(entry.entry.first);
+  return iter != current_.end() && iter->second.stamp == entry.stamp;
+}
+
+void HeapEdgeQueue::compact() {
+  auto iter = std::remove_if(heap_.begin(), heap_.end(), [this](const auto& entry) {
+    return !isValid(entry);
+  });
+  heap_.erase(iter, heap_.end());
+  std::make_heap(heap_.begin(), heap_.end(), [this](const auto& lhs, const auto& rhs) {
+    return heapCompare(lhs, rhs);
+  });
+}
+
+std::optional<EdgeQueue::Entry> HeapEdgeQueue::top() {
+  while (!heap_.empty()) {
+    const auto& best = heap_.front();
+    if (isValid(best)) {
+      return best.entry;
+    }
+
+    if (!ws_.edges.count(best.entry.first)) {
+      current_.erase(best.entry.first);
+    }
+
+    std::pop_heap(heap_.begin(), heap_.end(), [this](const auto& lhs, const auto& rhs) {
+      return heapCompare(lhs, rhs);
+    });
+    heap_.pop_back();
+  }
+
+  return std::nullopt;
+}
+
+std::optional<double> HeapEdgeQueue::score(EdgeKey edge) const {
+  if (!ws_.edges.count(edge)) {
+    return std::nullopt;
+  }
+
+  const auto iter = current_.find(edge);
+  if (iter == current_.end()) {
+    return std::nullopt;
+  }
+
+  return iter->second.score;
+}
+
+}  // namespace clio
@@ -0,0 +1,35 @@
+#include "clio/edge_selector.h"
+
+#include <algorithm>
+
+#include "clio/thread_pool.h"
+
+namespace clio {
+
+std::vector<double> scoreEdges(const EdgeSelector& selector,
+                               const std::vector<EdgeKey>& edges,
+                               ThreadPool* pool,
+                               size_t grain_size) {
+  std::vector<double> scores(edges.size());
+  const size_t grain = std::max<size_t>(grain_size, 1);
+  if (!pool || pool->numThreads() == 1 || edges.size() <= grain) {
+    for (size_t i = 0; i < edges.size(); ++i) {
+      scores[i] = selector.scoreEdge(edges[i]);
+    }
+
+    return scores;
+  }
+
+  // each chunk writes a disjoint range of scores
+  const size_t num_chunks = (edges.size() + grain - 1) / grain;
+  pool->parallelFor(num_chunks, [&](size_t chunk) {
+    const size_t end = std::min(edges.size(), (chunk + 1) * grain);
+    for (size_t i = chunk * grain; i < end; ++i) {
+      scores[i] = selector.scoreEdge(edges[i]);
+    }
+  });
+
+  return scores;
+}
+
+}  // namespace clio
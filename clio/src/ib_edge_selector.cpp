@@ -6,6 +6,8 @@
 #include <hydra/utils/printing.h>
 #include <spark_dsg/printing.h>
 
+#include <numeric>
+
 #include "clio/probability_utilities.h"
 
 namespace clio {
@@ -17,6 +19,9 @@ void declare_config(IBEdgeSelector::Config& config) {
   name("IBEdgeSelector::Config");
   field(config.max_delta, "max_delta");
   field(config.tolerance, "tolerance");
+  field(config.mi_refresh_interval, "mi_refresh_interval");
+  field(config.sparse, "sparse");
+  field(config.single_precision, "single_precision");
   field(config.py_x.score_threshold, "score_threshold");
   field(config.py_x.top_k, "top_k");
   field(config.py_x.cumulative, "cumulative");
@@ -36,66 +41,131 @@ void IBEdgeSelector::setup(const ClusteringWorkspace& ws,
   const auto fmt = hydra::getDefaultFormat();
   size_t N = ws.size();
 
-  // p(z) = p(x) initially
-  px_ = computeIBpx(ws);
+  // p(z) = p(x) initially (uniform, filled in place so recycled selectors don't
+  // reallocate)
+  px_.setConstant(N, 1.0 / static_cast<double>(N));
   pz_ = px_;
   // p(z|x) is identity
-  pz_x_ = Eigen::MatrixXd::Identity(N, N);
-
-  py_x_ = computeIBpyGivenX(ws, tasks, metric, config.py_x);
+  pz_x_parents_.resize(N);
+  std::iota(pz_x_parents_.begin(), pz_x_parents_.end(), 0);
 
-  // p(y|z) = p(y|x) (as p(z) = p(x) and p(z|x) = I_n
-  py_z_ = py_x_;
   // p(y) is uniform
-  py_ = computeIBpy(tasks);
+  const size_t M = tasks.embeddings.size() + 1;
+  py_.setConstant(M, 1.0 / static_cast<double>(M));
+  // the config is fixed, so only the representation in use is ever non-empty
+  // p(y|z) = p(y|x) (as p(z) = p(x) and p(z|x) = I_n
+  if (config.sparse) {
+    computeSparseIBpyGivenX(ws.features, tasks, metric, config.py_x, sparse_py_z_);
+  } else if (config.single_precision) {
+    // p(y|x) is only kept as scratch space for the conversion
+    computeIBpyGivenX(ws.features, tasks, metric, config.py_x, py_x_);
+    py_z_float_ = py_x_.cast<float>();
+    py_float_ = py_.cast<float>();
+  } else {
+    computeIBpyGivenX(ws.features, tasks, metric, config.py_x, py_x_);
+    py_z_ = py_x_;
+  }
+
+  H_y_z_.resize(N);
+  for (size_t z = 0; z < N; ++z) {
+    H_y_z_(z) = clusterEntropy(z);
+  }
 
   VLOG(10) << "p(x): " << px_.format(fmt);
   VLOG(10) << "p(z): " << pz_.format(fmt);
   VLOG(10) << "p(y): " << py_.format(fmt);
   VLOG(10) << "p(y|x): " << py_x_.format(fmt);
   VLOG(10) << "p(y|z): " << py_z_.format(fmt);
-  VLOG(10) << "p(z|x): " << pz_x_.format(fmt);
 
   // initialize mutual information to starting values;
-  I_xy_ = mutualInformation(py_, px_, py_x_);
-  I_zy_prev_ = I_xy_;
+  if (config.sparse || config.single_precision) {
+    I_xy_ = 0.0;
+    for (size_t x = 0; x < N; ++x) {
+      I_xy_ += px_(x) * clusterInformation(x);
+    }
+  } else {
+    I_xy_ = mutualInformation(py_, px_, py_x_);
+  }
+
+  // reset any previous reweighting (selectors are reused between clusterings)
+  delta_weight_ = 1.0;
   deltas_.clear();
+  reserve(N);
+
+  // I(Z;Y) = sum_z p(z) D(p(y|z) || p(y)), so only merged clusters change per merge
+  I_zy_terms_.resize(N);
+  for (size_t z = 0; z < N; ++z) {
+    I_zy_terms_(z) = pz_(z) * clusterInformation(z);
+  }
+  I_zy_prev_ = I_zy_terms_.sum();
+  merges_since_refresh_ = 0;
+  checkpoint_.reset();
 }
 
-double IBEdgeSelector::scoreEdge(EdgeKey edge) {
-  const auto fmt = hydra::getDefaultFormat();
+void IBEdgeSelector::reserve(size_t num_nodes) {
+  // at most one delta is recorded per merge
+  deltas_.reserve(num_nodes);
+  pz_x_parents_.reserve(num_nodes);
+}
+
+double IBEdgeSelector::scoreEdge(EdgeKey edge) const {
   const auto p_s = pz_(edge.k1);
   const auto p_t = pz_(edge.k2);
   const auto total = p_s + p_t;
-  Eigen::VectorXd prior(2);
-  prior << p_s / total, p_t / total;
-  Eigen::MatrixXd py_z_local(py_z_.rows(), 2);
-  py_z_local.col(0) = py_z_.col(edge.k1);
-  py_z_local.col(1) = py_z_.col(edge.k2);
-  const auto divergence = jensenShannonDivergence(py_z_local, prior);
-  VLOG(20) << "Scoring edge (" << edge << "): prior: " << prior.format(fmt)
-           << ", p(y|z=z): " << py_z_local.format(fmt)
-           << ", divergence: " << divergence;
+  const auto w_s = p_s / total;
+  const auto w_t = p_t / total;
+  const auto divergence = clusterDivergence(edge, w_s, w_t);
+  if (VLOG_IS_ON(20) && py_z_.size()) {
+    const auto fmt = hydra::getDefaultFormat();
+    VLOG(20) << "Scoring edge (" << edge << "): prior: [" << w_s << ", " << w_t
+             << "], p(y|z=s): " << py_z_.col(edge.k1).transpose().format(fmt)
+             << ", p(y|z=t): " << py_z_.col(edge.k2).transpose().format(fmt)
+             << ", divergence: " << divergence;
+  }
+
   return total * divergence;
 }
 
 bool IBEdgeSelector::updateFromEdge(EdgeKey edge) {
+  if (checkpoint_) {
+    checkpoint_->merges.push_back({edge,
+                                   pz_(edge.k1),
+                                   pz_(edge.k2),
+                                   H_y_z_(edge.k1),
+                                   H_y_z_(edge.k2),
+                                   I_zy_terms_(edge.k1),
+                                   I_zy_terms_(edge.k2),
+                                   saveColumn(edge.k1),
+                                   saveColumn(edge.k2)});
+  }
+
   // we merge target -> source
   const auto p_s = pz_(edge.k1);
   const auto p_t = pz_(edge.k2);
   // update new cluster probabilities
   pz_(edge.k1) = p_s + p_t;
-  py_z_.col(edge.k1) =
-      ((p_s * py_z_.col(edge.k1) + p_t * py_z_.col(edge.k2)) / (p_s + p_t)).eval();
-  pz_x_.col(edge.k1) += pz_x_.col(edge.k2);
+  mergeClusters(edge, p_s, p_t);
+  pz_x_parents_[edge.k2] = edge.k1;
 
   // zero-out merged nodes
   pz_(edge.k2) = 0.0;
-  py_z_.col(edge.k2).setConstant(0.0);
-  pz_x_.col(edge.k2).setConstant(0.0);
+  H_y_z_(edge.k1) = clusterEntropy(edge.k1);
+  H_y_z_(edge.k2) = 0.0;
+
+  // update the cached contributions of the merged clusters
+  const auto prev_terms = I_zy_terms_(edge.k1) + I_zy_terms_(edge.k2);
+  I_zy_terms_(edge.k1) = pz_(edge.k1) * clusterInformation(edge.k1);
+  I_zy_terms_(edge.k2) = 0.0;
+
+  double I_zy = I_zy_prev_ - prev_terms + I_zy_terms_(edge.k1);
+  ++merges_since_refresh_;
+  if (config.mi_refresh_interval &&
+      merges_since_refresh_ >= config.mi_refresh_interval) {
+    // guard against accumulated rounding error
+    I_zy = I_zy_terms_.sum();
+    merges_since_refresh_ = 0;
+  }
 
-  // for I[a; b] order is p(a), p(b), p(a|b)
-  const auto I_zy = mutualInformation(py_, pz_, py_z_);
   const auto d_I_zy = I_zy_prev_ - I_zy;
 
   // avoid divide-by-zero and other weirdness with precision
@@ -117,6 +187,148 @@ void IBEdgeSelector::onlineReweighting(double Ixy, double delta_weight) {
   delta_weight_ = delta_weight;
 }
 
+bool IBEdgeSelector::checkpoint() {
+  checkpoint_ = Checkpoint{I_zy_prev_, merges_since_refresh_, deltas_.size(), {}};
+  return true;
+}
+
+void IBEdgeSelector::rollback() {
+  if (!checkpoint_) {
+    return;
+  }
+
+  // undo in reverse order in case an edge touched a previously merged cluster
+  auto& merges = checkpoint_->merges;
+  for (auto iter = merges.rbegin(); iter != merges.rend(); ++iter) {
+    const auto k1 = iter->edge.k1;
+    const auto k2 = iter->edge.k2;
+    pz_(k1) = iter->p_s;
+    pz_(k2) = iter->p_t;
+    H_y_z_(k1) = iter->H_s;
+    H_y_z_(k2) = iter->H_t;
+    I_zy_terms_(k1) = iter->I_s;
+    I_zy_terms_(k2) = iter->I_t;
+    pz_x_parents_[k2] = k2;
+    restoreColumn(k1, std::move(iter->py_s));
+    restoreColumn(k2, std::move(iter->py_t));
+  }
+
+  I_zy_prev_ = checkpoint_->I_zy_prev;
+  merges_since_refresh_ = checkpoint_->merges_since_refresh;
+  deltas_.resize(checkpoint_->num_deltas);
+  checkpoint_.reset();
+}
+
+void IBEdgeSelector::commit() { checkpoint_.reset(); }
+
+std::optional<double> IBEdgeSelector::lastMergeDelta() const {
+  if (deltas_.empty()) {
+    return std::nullopt;
+  }
+
+  return deltas_.back();
+}
+
+IBEdgeSelector::ClusterColumn IBEdgeSelector::saveColumn(size_t z) const {
+  ClusterColumn column;
+  if (config.sparse) {
+    column.sparse = sparse_py_z_[z];
+  } else if (config.single_precision) {
+    column.single = py_z_float_.col(z);
+  } else {
+    column.dense = py_z_.col(z);
+  }
+
+  return column;
+}
+
+void IBEdgeSelector::restoreColumn(size_t z, ClusterColumn&& column) {
+  if (config.sparse) {
+    sparse_py_z_[z] = std::move(column.sparse);
+  } else if (config.single_precision) {
+    py_z_float_.col(z) = column.single;
+  } else {
+    py_z_.col(z) = column.dense;
+  }
+}
+
+Eigen::SparseMatrix<double> IBEdgeSelector::getPzGivenX() const {
+  // merges always point the larger index at the smaller index
+  const size_t N = pz_x_parents_.size();
+  std::vector<size_t> clusters(N);
+  std::vector<Eigen::Triplet<double>> entries;
+  entries.reserve(N);
+  for (size_t x = 0; x < N; ++x) {
+    const auto parent = pz_x_parents_[x];
+    clusters[x] = parent == x ? x : clusters[parent];
+    entries.emplace_back(x, clusters[x], 1.0);
+  }
+
+  Eigen::SparseMatrix<double> pz_x(N, N);
+  pz_x.setFromTriplets(entries.begin(), entries.end());
+  return pz_x;
+}
+
+double IBEdgeSelector::clusterEntropy(size_t z) const {
+  if (config.sparse) {
+    return mixtureEntropy(sparse_py_z_[z], sparse_py_z_[z], 1.0, 0.0);
+  }
+
+  if (config.single_precision) {
+    return mixtureEntropy(py_z_float_.col(z), py_z_float_.col(z), 1.0, 0.0);
+  }
+
+  return mixtureEntropy(py_z_.col(z), py_z_.col(z), 1.0, 0.0);
+}
+
+double IBEdgeSelector::clusterInformation(size_t z) const {
+  if (config.sparse) {
+    return klDivergence(sparse_py_z_[z], py_);
+  }
+
+  if (config.single_precision) {
+    return klDivergence(py_z_float_.col(z), py_float_);
+  }
+
+  return klDivergence(py_z_.col(z), py_);
+}
+
+double IBEdgeSelector::clusterDivergence(EdgeKey edge, double w_s, double w_t) const {
+  const auto H_s = H_y_z_(edge.k1);
+  const auto H_t = H_y_z_(edge.k2);
+  if (config.sparse) {
+    return pairwiseJensenShannonDivergence(
+        sparse_py_z_[edge.k1], sparse_py_z_[edge.k2], w_s, w_t, H_s, H_t);
+  }
+
+  if (config.single_precision) {
+    return pairwiseJensenShannonDivergence(
+        py_z_float_.col(edge.k1), py_z_float_.col(edge.k2), w_s, w_t, H_s, H_t);
+  }
+
+  return pairwiseJensenShannonDivergence(
+      py_z_.col(edge.k1), py_z_.col(edge.k2), w_s, w_t, H_s, H_t);
+}
+
+void IBEdgeSelector::mergeClusters(EdgeKey edge, double p_s, double p_t) {
+  const auto w_s = p_s / (p_s + p_t);
+  const auto w_t = p_t / (p_s + p_t);
+  if (config.sparse) {
+    sparse_py_z_[edge.k1] =
+        mixPmfs(sparse_py_z_[edge.k1], sparse_py_z_[edge.k2], w_s, w_t);
+    sparse_py_z_[edge.k2] = SparsePmf();
+  } else if (config.single_precision) {
+    py_z_float_.col(edge.k1) = (static_cast<float>(w_s) * py_z_float_.col(edge.k1) +
+                                static_cast<float>(w_t) * py_z_float_.col(edge.k2))
+                                   .eval();
+    py_z_float_.col(edge.k2).setConstant(0.0f);
+  } else {
+    py_z_.col(edge.k1) =
+        ((p_s * py_z_.col(edge.k1) + p_t * py_z_.col(edge.k2)) / (p_s + p_t)).eval();
+    py_z_.col(edge.k2).setConstant(0.0);
+  }
+}
+
 std::string IBEdgeSelector::summarize() const {
   if (deltas_.empty()) {
     return "0 merge(s), δ_0=N/A, δ_n=N/A";
@@ -4,82 +4,167 @@
 #include <glog/logging.h>
 #include <hydra/utils/printing.h>
 
+#include <algorithm>
 #include <numeric>
 #include <vector>
 
 namespace clio {
 
 using namespace spark_dsg;
-using Indices = std::vector<std::pair<size_t, size_t>>;
-
-Indices findTopKIndicesCols(const Eigen::MatrixXd& m, size_t top_k) {
-  // Find top k indices for each column
-  size_t k = std::min(top_k, static_cast<size_t>(m.rows()));
-  Indices top_indices;
-  for (Eigen::Index c = 0; c < m.cols(); c++) {
-    const auto& col = m.col(c);
-
-    std::vector<size_t> idx(m.rows(), 0);
-    std::iota(idx.begin(), idx.end(), 0);
-    // Sort the indices according to their respective value
-    std::sort(idx.begin(), idx.end(), [&col](auto& lhv, auto& rhv) {
-      return col(lhv) > col(rhv);
-    });
-
-    for (size_t i = 0; i < k; i++) {
-      top_indices.push_back({idx[i], c});
+
+// Rank the top k entries of a column (ties go to the lower index)
+void findTopKIndices(const Eigen::Ref<const Eigen::VectorXd>& col,
+                     size_t k,
+                     std::vector<size_t>& idx) {
+  idx.resize(col.rows());
+  std::iota(idx.begin(), idx.end(), 0);
+  std::partial_sort(
+      idx.begin(), idx.begin() + k, idx.end(), [&col](auto lhs, auto rhs) {
+        return col(lhs) > col(rhs) || (col(lhs) == col(rhs) && lhs < rhs);
+      });
+}
+
+bool computeCosineScores(const Eigen::MatrixXf& features,
+                         const hydra::EmbeddingGroup& tasks,
+                         const hydra::EmbeddingDistance& metric,
+                         Eigen::MatrixXf& scores) {
+  const size_t dim = features.rows();
+  Eigen::MatrixXf task_matrix(dim, tasks.embeddings.size());
+  for (size_t i = 0; i < tasks.embeddings.size(); ++i) {
+    const Eigen::VectorXf task = tasks.embeddings[i].cast<float>();
+    const auto norm = task.norm();
+    if (static_cast<size_t>(task.rows()) != dim || norm <= 0.0f) {
+      return false;
+    }
+
+    task_matrix.col(i) = task / norm;
+  }
+
+  Eigen::VectorXf inv_norms = features.colwise().norm().transpose();
+  std::vector<size_t> degenerate;
+  for (Eigen::Index i = 0; i < inv_norms.rows(); ++i) {
+    if (inv_norms(i) > 0.0f) {
+      inv_norms(i) = 1.0f / inv_norms(i);
+    } else {
+      degenerate.push_back(i);
     }
   }
 
-  return top_indices;
+  scores.noalias() = task_matrix.transpose() * features * inv_norms.asDiagonal();
+  // leave metric-specific handling of zero-norm features to the metric
+  for (const auto idx : degenerate) {
+    scores.col(idx) = tasks.getScores(metric, features.col(idx));
+  }
+
+  // spot-check a column against the metric in case it is not the plain cosine
+  Eigen::Index check_idx = 0;
+  for (Eigen::Index i = 0; i < inv_norms.rows(); ++i) {
+    if (inv_norms(i) > 0.0f) {
+      check_idx = i;
+      break;
+    }
+  }
+
+  const Eigen::VectorXf expected = tasks.getScores(metric, features.col(check_idx));
+  const auto error = (expected - scores.col(check_idx)).cwiseAbs().maxCoeff();
+  if (error > kBatchScoreTolerance) {
+    LOG_FIRST_N(WARNING, 1) << "Batched cosine scores disagree with metric (error: "
+                            << error << "), falling back to per-node scoring";
+    return false;
+  }
+
+  return true;
+}
+
+Eigen::MatrixXf computeTaskScores(const ClusteringWorkspace& ws,
+                                  const hydra::EmbeddingGroup& tasks,
+                                  const hydra::EmbeddingDistance& metric,
+                                  bool batched) {
+  return computeTaskScores(ws.features, tasks, metric, batched);
+}
+
+Eigen::MatrixXf computeTaskScores(const Eigen::MatrixXf& features,
+                                  const hydra::EmbeddingGroup& tasks,
+                                  const hydra::EmbeddingDistance& metric,
+                                  bool batched) {
+  const size_t N = features.cols();
+  Eigen::MatrixXf scores(tasks.embeddings.size(), N);
+  if (N == 0 || tasks.embeddings.empty()) {
+    return scores;
+  }
+
+  const auto cosine = dynamic_cast<const hydra::CosineDistance*>(&metric);
+  if (batched && cosine && computeCosineScores(features, tasks, metric, scores)) {
+    return scores;
+  }
+
+  for (size_t idx = 0; idx < N; ++idx) {
+    scores.col(idx) = tasks.getScores(metric, features.col(idx));
+  }
+
+  return scores;
 }
 
 Eigen::MatrixXd computeIBpyGivenX(const ClusteringWorkspace& ws,
                                   const hydra::EmbeddingGroup& tasks,
                                   const hydra::EmbeddingDistance& metric,
                                   const PyGivenXConfig& config) {
+  return computeIBpyGivenX(ws.features, tasks, metric, config);
+}
+
+Eigen::MatrixXd computeIBpyGivenX(const Eigen::MatrixXf& features,
+                                  const hydra::EmbeddingGroup& tasks,
+                                  const hydra::EmbeddingDistance& metric,
+                                  const PyGivenXConfig& config) {
+  Eigen::MatrixXd py_x;
+  computeIBpyGivenX(features, tasks, metric, config, py_x);
+  return py_x;
+}
+
+void computeIBpyGivenX(const Eigen::MatrixXf& features,
+                       const hydra::EmbeddingGroup& tasks,
+                       const hydra::EmbeddingDistance& metric,
+                       const PyGivenXConfig& config,
+                       Eigen::MatrixXd& py_x) {
   const auto fmt = hydra::getDefaultFormat();
 
-  size_t N = ws.size();
+  size_t N = features.cols();
   size_t M = tasks.embeddings.size() + 1;
 
-  Eigen::MatrixXd py_x = Eigen::MatrixXd::Ones(M, N) * 1e-12;
-  Eigen::MatrixXd py_x_temp = Eigen::MatrixXd::Zero(M, N);
-  py_x_temp.row(0).setConstant(config.score_threshold);
-  VLOG(15) << "----------------------------------------";
-  VLOG(15) << "Computing workspace feature scores";
-  VLOG(15) << "----------------------------------------";
-  for (auto&& [idx, feature] : ws.features) {
-    const auto scores = tasks.getScores(metric, feature);
-    VLOG(15) << "scores @ " << idx << ": " << scores.format(fmt);
-    py_x_temp.block(1, idx, M - 1, 1) = scores.cast<double>();
-  }
-  VLOG(15) << "----------------------------------------";
-
-  size_t k = std::min(M, config.top_k);
-  size_t l = k;
-  if (config.cumulative) {
-    l = 1;
-  }
-  while (l <= k) {
-    const auto top_k_inds = findTopKIndicesCols(py_x_temp, l);
-    for (const auto& idx : top_k_inds) {
-      py_x(idx.first, idx.second) =
-          py_x(idx.first, idx.second) + py_x_temp(idx.first, idx.second);
+  py_x.setConstant(M, N, 1e-12);
+  const auto scores = computeTaskScores(features, tasks, metric);
+  if (VLOG_IS_ON(15)) {
+    VLOG(15) << "----------------------------------------";
+    VLOG(15) << "Computing workspace feature scores";
+    VLOG(15) << "----------------------------------------";
+    for (size_t idx = 0; idx < N; ++idx) {
+      VLOG(15) << "scores @ " << idx << ": " << scores.col(idx).transpose().format(fmt);
     }
-    l++;
+    VLOG(15) << "----------------------------------------";
   }
 
-  if (config.null_task_preprune) {
-    // Null task processing
-    const auto top_inds = findTopKIndicesCols(py_x_temp, 1);
-    for (const auto& idx : top_inds) {
-      // Null task corresponds to first row
-      if (idx.first == 0) {
-        py_x.block(1, idx.second, M - 1, 1).setConstant(1e-12);
-        // Essentially 0 (but not 0 to avoid NaN error)
+  // one ranking per column covers both top-k accumulation and null task pruning
+  const size_t k = std::min(M, config.top_k);
+  Eigen::VectorXd column(M);
+  std::vector<size_t> ranked;
+  for (size_t c = 0; c < N; ++c) {
+    column(0) = config.score_threshold;
+    column.tail(M - 1) = scores.col(c).cast<double>();
+    findTopKIndices(column, k, ranked);
+    for (size_t r = 0; r < k; ++r) {
+      const auto idx = ranked[r];
+      // cumulative: the r-th best score is part of the top-l set for l = r + 1...k
+      const size_t repeats = config.cumulative ? k - r : 1;
+      for (size_t i = 0; i < repeats; ++i) {
+        py_x(idx, c) += column(idx);
       }
     }
+
+    // Null task corresponds to first row
+    if (config.null_task_preprune && ranked.front() == 0) {
+      // Essentially 0 (but not 0 to avoid NaN error)
+      py_x.block(1, c, M - 1, 1).setConstant(1e-12);
+    }
   }
 
   VLOG(10) << "raw: p(y|x): " << py_x.format(fmt);
@@ -94,10 +179,69 @@ Eigen::MatrixXd computeIBpyGivenX(const ClusteringWorkspace& ws,
   py_x.array().rowwise() /= norm_factor.array();
 
   VLOG(10) << "p(y|x): " << py_x.format(fmt);
+}
 
+std::vector<SparsePmf> computeSparseIBpyGivenX(const Eigen::MatrixXf& features,
+                                               const hydra::EmbeddingGroup& tasks,
+                                               const hydra::EmbeddingDistance& metric,
+                                               const PyGivenXConfig& config) {
+  std::vector<SparsePmf> py_x;
+  computeSparseIBpyGivenX(features, tasks, metric, config, py_x);
   return py_x;
 }
 
+void computeSparseIBpyGivenX(const Eigen::MatrixXf& features,
+                             const hydra::EmbeddingGroup& tasks,
+                             const hydra::EmbeddingDistance& metric,
+                             const PyGivenXConfig& config,
+                             std::vector<SparsePmf>& py_x) {
+  constexpr double floor = 1e-12;
+  const size_t N = features.cols();
+  const size_t M = tasks.embeddings.size() + 1;
+  const auto scores = computeTaskScores(features, tasks, metric);
+
+  const size_t k = std::min(M, config.top_k);
+  py_x.resize(N);
+  Eigen::VectorXd column(M);
+  std::vector<size_t> ranked;
+  std::vector<std::pair<Eigen::Index, double>> entries;
+  for (size_t c = 0; c < N; ++c) {
+    column(0) = config.score_threshold;
+    column.tail(M - 1) = scores.col(c).cast<double>();
+    findTopKIndices(column, k, ranked);
+
+    // same accumulation as the dense version, starting from the floor
+    entries.clear();
+    const bool pruned = config.null_task_preprune && ranked.front() == 0;
+    for (size_t r = 0; r < (pruned ? 1 : k); ++r) {
+      const auto idx = ranked[r];
+      const size_t repeats = config.cumulative ? k - r : 1;
+      double value = floor;
+      for (size_t i = 0; i < repeats; ++i) {
+        value += column(idx);
+      }
+
+      entries.emplace_back(idx, value);
+    }
+
+    std::sort(entries.begin(), entries.end());
+    double norm = static_cast<double>(M - entries.size()) * floor;
+    for (const auto& entry : entries) {
+      norm += entry.second;
+    }
+
+    auto& pmf = py_x[c];
+    pmf.dim = M;
+    pmf.floor = floor / norm;
+    pmf.indices.clear();
+    pmf.values.clear();
+    for (const auto& [idx, value] : entries) {
+      pmf.indices.push_back(idx);
+      pmf.values.push_back(value / norm);
+    }
+  }
+}
+
 Eigen::VectorXd computeIBpx(const ClusteringWorkspace& ws) {
   // p(x) is uniform
   size_t N = ws.size();
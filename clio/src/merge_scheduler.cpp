@@ -0,0 +1,157 @@
+#include "clio/merge_scheduler.h"
+
+#include <glog/logging.h>
+#include <spark_dsg/printing.h>
+
+#include <algorithm>
+
+namespace clio {
+
+MergeScheduler::MergeScheduler(ThreadPool* pool, size_t grain_size)
+    : pool_(pool), grain_size_(grain_size) {}
+
+void MergeScheduler::rescore(const std::vector<EdgeKey>& edges,
+                             const EdgeSelector& selector,
+                             EdgeQueue& queue,
+                             ClusteringStats& stats) const {
+  const auto scores = scoreEdges(selector, edges, pool_, grain_size_);
+  for (size_t i = 0; i < edges.size(); ++i) {
+    VLOG(10) << "edge " << edges[i] << ": " << scores[i];
+    queue.update(edges[i], scores[i]);
+  }
+
+  stats.edges_scored += edges.size();
+}
+
+void SequentialMergeScheduler::run(ClusteringWorkspace& ws,
+                                   EdgeSelector& selector,
+                                   EdgeQueue& queue,
+                                   ClusteringStats& stats) const {
+  for (size_t i = 0; i < ws.size(); ++i) {
+    // only empty if |connected components| > 1
+    const auto best = queue.top();
+    if (!best) {
+      break;
+    }
+
+    if (VLOG_IS_ON(15)) {
+      VLOG(15) << "***********************************";
+      VLOG(15) << "Candidates";
+      VLOG(15) << "***********************************";
+      for (const auto& edge_weight : ws.edges) {
+        const auto weight = queue.score(edge_weight.first);
+        VLOG(15) << "edge (" << edge_weight.first << "): " << weight.value_or(0.0);
+      }
+      VLOG(15) << "***********************************";
+    }
+
+    const EdgeKey best_edge = best->first;
+    if (!selector.updateFromEdge(best_edge)) {
+      // we've hit a stop criteria
+      break;
+    }
+
+    const auto changed_edges = ws.addMerge(best_edge);
+    ++stats.merges;
+    ++stats.rounds;
+    VLOG(10) << "-----------------------------------";
+    VLOG(10) << "Scoring changed edges";
+    VLOG(10) << "-----------------------------------";
+    rescore({changed_edges.begin(), changed_edges.end()}, selector, queue, stats);
+    VLOG(10) << "-----------------------------------";
+  }
+}
+
+void BatchMergeScheduler::run(ClusteringWorkspace& ws,
+                              EdgeSelector& selector,
+                              EdgeQueue& queue,
+                              ClusteringStats& stats) const {
+  while (selector.checkpoint()) {
+    const auto batch = getBatch(ws, selector, queue);
+    if (batch.size() <= 1) {
+      // nothing gained over merging sequentially
+      selector.commit();
+      break;
+    }
+
+    bool valid = true;
+    for (const auto edge : batch) {
+      if (!selector.updateFromEdge(edge)) {
+        valid = false;
+        break;
+      }
+    }
+
+    if (!valid) {
+      VLOG(10) << "Rolling back batch of " << batch.size() << " merge(s)";
+      selector.rollback();
+      break;
+    }
+
+    selector.commit();
+    ++stats.rounds;
+    stats.merges += batch.size();
+
+    // changed edges only connect merged clusters to clusters outside the batch, so
+    // every changed edge is still valid once the whole batch is merged
+    std::vector<EdgeKey> changed;
+    for (const auto edge : batch) {
+      const auto edges = ws.addMerge(edge);
+      changed.insert(changed.end(), edges.begin(), edges.end());
+    }
+
+    VLOG(10) << "Merged batch of " << batch.size() << " edge(s), rescoring "
+             << changed.size() << " edge(s)";
+    rescore(changed, selector, queue, stats);
+  }
+
+  SequentialMergeScheduler(pool_, grain_size_).run(ws, selector, queue, stats);
+}
+
+std::vector<EdgeKey> BatchMergeScheduler::getBatch(const ClusteringWorkspace& ws,
+                                                   const EdgeSelector& selector,
+                                                   const EdgeQueue& queue) {
+  std::vector<EdgeQueue::Entry> candidates;
+  candidates.reserve(ws.edges.size());
+  for (const auto& edge_weight : ws.edges) {
+    const auto score = queue.score(edge_weight.first);
+    if (score) {
+      candidates.emplace_back(edge_weight.first, *score);
+    }
+  }
+
+  // same order as the edge queues (equivalent scores are ordered by edge key)
+  std::sort(
+      candidates.begin(), candidates.end(), [&](const auto& lhs, const auto& rhs) {
+        if (selector.compareEdges(lhs, rhs)) {
+          return true;
+        }
+
+        if (selector.compareEdges(rhs, lhs)) {
+          return false;
+        }
+
+        return lhs.first < rhs.first;
+      });
+
+  // clusters in the batch and their neighbors can't be part of another batch edge
+  std::vector<bool> blocked(ws.size(), false);
+  std::vector<EdgeKey> batch;
+  for (const auto& [edge, score] : candidates) {
+    if (blocked[edge.k1] || blocked[edge.k2]) {
+      continue;
+    }
+
+    batch.push_back(edge);
+    for (const auto cluster : {edge.k1, edge.k2}) {
+      blocked[cluster] = true;
+      for (const auto neighbor : ws.neighbors[cluster]) {
+        blocked[neighbor] = true;
+      }
+    }
+  }
+
+  return batch;
+}
+
+}  // namespace clio
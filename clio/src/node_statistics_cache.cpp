@@ -0,0 +1,138 @@
+#include "clio/node_statistics_cache.h"
+
+#include <glog/logging.h>
+
+#include "clio/probability_utilities.h"
+
+namespace clio {
+
+using namespace spark_dsg;
+
+NodeStatisticsCache::NodeStatisticsCache(const PyGivenXConfig& config)
+    : config_(config) {}
+
+size_t NodeStatisticsCache::update(const PooledEmbeddingCache& embeddings,
+                                   const hydra::EmbeddingGroup& tasks,
+                                   const hydra::EmbeddingDistance& metric) {
+  size_t num_removed = 0;
+  auto iter = entries_.begin();
+  while (iter != entries_.end()) {
+    if (embeddings.getEntry(iter->first)) {
+      ++iter;
+      continue;
+    }
+
+    information_sum_ -= iter->second.information;
+    iter = entries_.erase(iter);
+    ++num_removed;
+  }
+
+  std::vector<NodeId> changed;
+  for (const auto& [node_id, pooled] : embeddings.entries()) {
+    const auto entry = getEntry(node_id);
+    if (entry && entry->feature.rows() == pooled.feature.rows() &&
+        entry->feature == pooled.feature) {
+      continue;
+    }
+
+    changed.push_back(node_id);
+  }
+
+  addChanges(num_removed);
+  if (!changed.empty()) {
+    insert(changed, embeddings.getFeatures(changed), tasks, metric);
+  }
+
+  VLOG(5) << "Node statistics: " << changed.size() << " rescored, " << num_removed
+          << " removed, " << entries_.size() << " total";
+  return changed.size();
+}
+
+void NodeStatisticsCache::insert(const std::vector<NodeId>& nodes,
+                                 const Eigen::MatrixXf& features,
+                                 const hydra::EmbeddingGroup& tasks,
+                                 const hydra::EmbeddingDistance& metric) {
+  CHECK_EQ(nodes.size(), static_cast<size_t>(features.cols()));
+  if (nodes.empty()) {
+    return;
+  }
+
+  const auto py = computeIBpy(tasks);
+  const auto py_x = computeIBpyGivenX(features, tasks, metric, config_);
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    auto iter = entries_.find(nodes[i]);
+    if (iter == entries_.end()) {
+      iter = entries_.emplace(nodes[i], Entry()).first;
+    } else {
+      information_sum_ -= iter->second.information;
+    }
+
+    auto& entry = iter->second;
+    entry.feature = features.col(i);
+    entry.py_x = py_x.col(i);
+    entry.information = klDivergence(entry.py_x, py);
+    information_sum_ += entry.information;
+  }
+
+  addChanges(nodes.size());
+}
+
+void NodeStatisticsCache::insert(NodeId node, Entry entry) {
+  auto iter = entries_.find(node);
+  if (iter != entries_.end()) {
+    information_sum_ -= iter->second.information;
+  }
+
+  information_sum_ += entry.information;
+  entries_[node] = std::move(entry);
+  addChanges(1);
+}
+
+bool NodeStatisticsCache::erase(NodeId node) {
+  const auto iter = entries_.find(node);
+  if (iter == entries_.end()) {
+    return false;
+  }
+
+  information_sum_ -= iter->second.information;
+  entries_.erase(iter);
+  addChanges(1);
+  return true;
+}
+
+void NodeStatisticsCache::clear() {
+  entries_.clear();
+  information_sum_ = 0.0;
+  changes_since_refresh_ = 0;
+}
+
+double NodeStatisticsCache::mutualInformation() const {
+  if (entries_.empty()) {
+    return 0.0;
+  }
+
+  return information_sum_ / static_cast<double>(entries_.size());
+}
+
+const NodeStatisticsCache::Entry* NodeStatisticsCache::getEntry(NodeId node) const {
+  const auto iter = entries_.find(node);
+  return iter == entries_.end() ? nullptr : &iter->second;
+}
+
+void NodeStatisticsCache::addChanges(size_t num_changes) {
+  changes_since_refresh_ += num_changes;
+  if (changes_since_refresh_ < entries_.size()) {
+    return;
+  }
+
+  // re-sum so that rounding error from add/subtract doesn't accumulate (amortized
+  // constant cost per change)
+  information_sum_ = 0.0;
+  for (const auto& id_entry_pair : entries_) {
+    information_sum_ += id_entry_pair.second.information;
+  }
+
+  changes_since_refresh_ = 0;
+}
+
+}  // namespace clio
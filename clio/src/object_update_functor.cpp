@@ -9,6 +9,10 @@
 #include <spark_dsg/graph_utilities.h>
 #include <spark_dsg/printing.h>
 
+#include <algorithm>
+#include <limits>
+#include <utility>
+
 #include "clio/agglomerative_clustering.h"
 #include "clio/probability_utilities.h"
 
@@ -32,47 +36,145 @@ using hydra::MergeList;
 using hydra::timing::ScopedTimer;
 using namespace spark_dsg;
 
-void mergeObjectAttributes(const KhronosObjectAttributes& from,
+// affine map from points in the frame of one box to points in the frame of another
+Eigen::Affine3f getBoxTransform(const BoundingBox& from, const BoundingBox& to) {
+  const auto map = [&](const Eigen::Vector3f& point) {
+    return to.pointToBoxFrame(from.pointToWorldFrame(point));
+  };
+
+  Eigen::Affine3f transform = Eigen::Affine3f::Identity();
+  transform.translation() = map(Eigen::Vector3f::Zero());
+  for (int i = 0; i < 3; ++i) {
+    transform.linear().col(i) = map(Eigen::Vector3f::Unit(i)) - transform.translation();
+  }
+
+  return transform;
+}
+
+// transform a contiguous range of mesh vertices in a single batched product
+void transformVertices(const Eigen::Affine3f& transform,
+                       const spark_dsg::Mesh::Positions& from,
+                       spark_dsg::Mesh::Positions& into,
+                       size_t offset) {
+  if (from.empty()) {
+    return;
+  }
+
+  static_assert(sizeof(spark_dsg::Mesh::Pos) == 3 * sizeof(float),
+                "vertices must be tightly packed");
+  using PointMatrix = Eigen::Matrix<float, 3, Eigen::Dynamic>;
+  const Eigen::Map<const PointMatrix> source(from.front().data(), 3, from.size());
+  Eigen::Map<PointMatrix> target(into[offset].data(), 3, from.size());
+  if (&from == &into) {
+    // source and target overlap, so the product needs a temporary
+    target = transform.linear() * source;
+  } else {
+    target.noalias() = transform.linear() * source;
+  }
+
+  target.colwise() += transform.translation();
+}
+
+void mergeObjectAttributes(const std::vector<const KhronosObjectAttributes*>& from,
                            KhronosObjectAttributes& into) {
-  // Update the bounding box. Do this first as it is the reference for the mesh.
-  BoundingBox new_box = into.bounding_box;
-  new_box.merge(from.bounding_box);
+  if (from.empty()) {
+    return;
+  }
 
-  // Adjust the old vertex positions.
-  for (auto& vertex : into.mesh.points) {
-    vertex = new_box.pointToBoxFrame(into.bounding_box.pointToWorldFrame(vertex));
+  // Compute the final bounding box once, as it is the reference for the mesh.
+  BoundingBox new_box = into.bounding_box;
+  size_t num_vertices = into.mesh.numVertices();
+  size_t num_faces = into.mesh.faces.size();
+  for (const auto attrs : from) {
+    new_box.merge(attrs->bounding_box);
+    num_vertices += attrs->mesh.numVertices();
+    num_faces += attrs->mesh.faces.size();
   }
 
-  // Merge incoming vertices.
+  // Adjust the old vertex positions.
   const size_t num_previous_vertices = into.mesh.numVertices();
-  into.mesh.resizeVertices(num_previous_vertices + from.mesh.numVertices());
-  for (size_t i = 0; i < from.mesh.numVertices(); ++i) {
-    into.mesh.setPos(
-        num_previous_vertices + i,
-        new_box.pointToBoxFrame(from.bounding_box.pointToWorldFrame(from.mesh.pos(i))));
-    into.mesh.setColor(num_previous_vertices + i, from.mesh.color(i));
-  }
+  transformVertices(getBoxTransform(into.bounding_box, new_box),
+                    into.mesh.points,
+                    into.mesh.points,
+                    0);
 
-  // Merges incoming faces.
-  const size_t idx_offset = into.mesh.numVertices();
-  into.mesh.faces.reserve(from.mesh.faces.size() + into.mesh.faces.size());
-  for (const auto& face : from.mesh.faces) {
-    spark_dsg::Mesh::Face new_face = face;
-    for (size_t i = 0; i < new_face.size(); ++i) {
-      new_face[i] += idx_offset;
+  // Merge incoming vertices and faces (storage only grows once).
+  into.mesh.resizeVertices(num_vertices);
+  into.mesh.faces.reserve(num_faces);
+  size_t offset = num_previous_vertices;
+  for (const auto attrs : from) {
+    const auto& mesh = attrs->mesh;
+    const auto transform = getBoxTransform(attrs->bounding_box, new_box);
+    transformVertices(transform, mesh.points, into.mesh.points, offset);
+    for (size_t i = 0; i < mesh.numVertices(); ++i) {
+      into.mesh.setColor(offset + i, mesh.color(i));
     }
-    into.mesh.faces.emplace_back(new_face);
+
+    for (const auto& face : mesh.faces) {
+      spark_dsg::Mesh::Face new_face = face;
+      for (size_t i = 0; i < new_face.size(); ++i) {
+        new_face[i] += offset;
+      }
+      into.mesh.faces.emplace_back(new_face);
+    }
+
+    offset += mesh.numVertices();
   }
 
   into.bounding_box = new_box;
 }
 
+void mergeObjectAttributes(const KhronosObjectAttributes& from,
+                           KhronosObjectAttributes& into) {
+  mergeObjectAttributes(std::vector<const KhronosObjectAttributes*>{&from}, into);
+}
+
+BoundingBoxIndex::Box getIndexBox(const BoundingBox& box) {
+  // invalid boxes have no well-defined extent so are treated as overlapping anything
+  if (!box.isValid()) {
+    return BoundingBoxIndex::Box(
+        Eigen::Vector3f::Constant(-std::numeric_limits<float>::max()),
+        Eigen::Vector3f::Constant(std::numeric_limits<float>::max()));
+  }
+
+  // padded so that rounding in the corner transforms never drops a true overlap
+  constexpr float padding = 1.0e-3f;
+  const Eigen::Vector3f half_dims = box.dimensions / 2.0f;
+  BoundingBoxIndex::Box world_box;
+  for (size_t i = 0; i < 8; ++i) {
+    const Eigen::Vector3f corner((i & 1) ? half_dims.x() : -half_dims.x(),
+                                 (i & 2) ? half_dims.y() : -half_dims.y(),
+                                 (i & 4) ? half_dims.z() : -half_dims.z());
+    world_box.extend(box.pointToWorldFrame(corner));
+  }
+
+  world_box.min().array() -= padding;
+  world_box.max().array() += padding;
+  return world_box;
+}
+
 bool isNodeActive(const SceneGraphNode& node,
                   const std::map<NodeId, size_t>& node_to_component,
                   const std::set<NodeId>& invalid) {
   return !node_to_component.count(node.id) && !invalid.count(node.id);
 }
 
+std::vector<std::vector<NodeId>> getNewComponents(
+    const SceneGraphLayer& segments,
+    const std::map<NodeId, size_t>& node_to_component,
+    const std::set<NodeId>& ignored) {
+  return graph_utilities::getConnectedComponents(
+      segments,
+      [&](const auto& n) { return isNodeActive(n, node_to_component, ignored); },
+      [&](const auto& edge) {
+        const auto source_active =
+            isNodeActive(segments.getNode(edge.source), node_to_component, ignored);
+        const auto target_active =
+            isNodeActive(segments.getNode(edge.target), node_to_component, ignored);
+        return source_active && target_active;
+      });
+}
+
 void declare_config(OverlapIntersection::Config& config) {
   using namespace config;
   name("OverlapIntersection::Config");
@@ -89,9 +191,20 @@ void declare_config(ObjectUpdateFunctor::Config& config) {
   config.metric.setOptional();
   field(config.metric, "metric");
   field(config.selector, "selector");
+  field(config.agglomeration, "agglomeration");
+  field(config.embeddings, "embeddings");
+  field(config.task_index, "task_index");
   field(config.min_segment_score, "min_segment_score");
   field(config.min_object_score, "min_object_score");
   field(config.neighbor_max_distance, "neighbor_max_distance");
+  field(config.segment_index_resolution, "segment_index_resolution");
+  field(config.num_threads, "num_threads");
+  field(config.reconcile_objects, "reconcile_objects");
+  field(config.component_pool_size, "component_pool_size");
+  field(config.async, "async");
+  field(config.async_max_latency, "async_max_latency");
+  field(config.state_path, "state_path");
+  field(config.state_save_interval, "state_save_interval");
 }
 
 OverlapIntersection::OverlapIntersection(const Config& config)
@@ -102,15 +215,64 @@ bool OverlapIntersection::call(const KhronosObjectAttributes& lhs,
   return lhs.bounding_box.intersects(rhs.bounding_box);
 }
 
+ComponentInfo::ComponentInfo(const IBEdgeSelector::Config& config)
+    : edge_selector(config) {}
+
 ComponentInfo::ComponentInfo(const IBEdgeSelector::Config& config,
+                             const AgglomerationConfig& agglomeration,
                              const hydra::EmbeddingGroup& tasks,
                              const hydra::EmbeddingDistance& metric,
                              const SceneGraphLayer& layer,
+                             const PooledEmbeddingCache& embeddings,
                              const std::vector<NodeId>& nodes,
-                             double I_xy_full)
-    : edge_selector(config), ws(layer, nodes), segments(nodes) {
-  double delta_weight = computeDeltaWeight(layer, nodes);
-  clusterAgglomerative(ws, tasks, edge_selector, metric, true, I_xy_full, delta_weight);
+                             double I_xy_full,
+                             ThreadPool* pool)
+    : ComponentInfo(config) {
+  cluster(agglomeration, tasks, metric, layer, embeddings, nodes, I_xy_full, pool);
+}
+
+void ComponentInfo::cluster(const AgglomerationConfig& agglomeration,
+                            const hydra::EmbeddingGroup& tasks,
+                            const hydra::EmbeddingDistance& metric,
+                            const SceneGraphLayer& layer,
+                            const PooledEmbeddingCache& embeddings,
+                            const std::vector<NodeId>& nodes,
+                            double I_xy_full,
+                            ThreadPool* pool) {
+  cluster(agglomeration,
+          tasks,
+          metric,
+          layer,
+          nodes,
+          embeddings.getFeatures(nodes),
+          I_xy_full,
+          computeDeltaWeight(layer, nodes),
+          pool);
+}
+
+void ComponentInfo::cluster(const AgglomerationConfig& agglomeration,
+                            const hydra::EmbeddingGroup& tasks,
+                            const hydra::EmbeddingDistance& metric,
+                            const SceneGraphLayer& layer,
+                            const std::vector<NodeId>& nodes,
+                            const Eigen::MatrixXf& features,
+                            double I_xy_full,
+                            double delta_weight,
+                            ThreadPool* pool) {
+  ws.reset(layer, nodes, features);
+  segments.assign(nodes.begin(), nodes.end());
+  objects.clear();
+
+  stats = clusterAgglomerative(ws,
+                               tasks,
+                               edge_selector,
+                               metric,
+                               true,
+                               I_xy_full,
+                               delta_weight,
+                               5,
+                               agglomeration,
+                               pool);
 }
 
 ObjectUpdateFunctor::ObjectUpdateFunctor(const Config& config)
@@ -118,28 +280,263 @@ ObjectUpdateFunctor::ObjectUpdateFunctor(const Config& config)
       edge_checker_(config.edge_checker.create()),
       tasks_(config.tasks.create()),
       metric_(config.metric.create()),
-      next_node_id_(config.prefix, 0) {}
+      task_index_(std::make_unique<TaskIndex>(config.task_index, *tasks_, *metric_)),
+      pool_(std::make_unique<ThreadPool>(config.num_threads)),
+      next_node_id_(config.prefix, 0),
+      segment_embeddings_(config.embeddings),
+      segment_stats_(config.selector.py_x),
+      stats_log_("object_clustering") {
+  if (config.segment_index_resolution > 0.0 && edge_checker_->requiresOverlap()) {
+    segment_index_ =
+        std::make_unique<BoundingBoxIndex>(config.segment_index_resolution);
+  }
+
+  if (!config.state_path.empty() && loadState(config.state_path)) {
+    LOG(INFO) << "[Object Clustering] resuming " << components_.size()
+              << " component(s) from '" << config.state_path << "'";
+  }
+}
+
+ObjectUpdateFunctor::~ObjectUpdateFunctor() {
+  if (!config.state_path.empty()) {
+    saveState(config.state_path);
+  }
+
+  // the running pass refers to the tasks, metric and pool
+  clustering_job_.wait();
+}
 
 MergeList ObjectUpdateFunctor::call(const DynamicSceneGraph&,
                                     hydra::SharedDsgInfo& dsg,
                                     const hydra::UpdateInfo::ConstPtr& info) const {
   ScopedTimer timer("backend/object_clustering", info->timestamp_ns);
   auto& graph = *dsg.graph;
+  stats_ = {};
+
+  {  // repair broken edges between objects and places
+    ScopedTimer phase("backend/object_clustering/active_parents", info->timestamp_ns);
+    updateActiveParents(graph);
+  }
+
+  {  // pool segment features once for every consumer below
+    ScopedTimer phase("backend/object_clustering/pool_embeddings",
+                      info->timestamp_ns);
+    segment_embeddings_.update(graph.getLayer(DsgLayers::SEGMENTS));
+  }
+
+  // every component depends on the tasks, so new tasks invalidate all of them
+  const bool tasks_changed = updateTasks();
+  const bool invalidated = std::exchange(invalidated_, false);
+  if (tasks_changed || invalidated) {
+    // cleared before finding edges, so that every segment is scored again
+    ScopedTimer phase("backend/object_clustering/clear_components",
+                      info->timestamp_ns);
+    std::set<size_t> all_components;
+    for (const auto& id_component_pair : components_) {
+      all_components.insert(id_component_pair.first);
+    }
+
+    clearActiveComponents(graph, all_components);
+  }
+
+  std::set<size_t> active_components;
+  {  // detect edges between segments (and active connected components)
+    ScopedTimer phase("backend/object_clustering/segment_edges", info->timestamp_ns);
+    active_components = addSegmentEdges(graph);
+  }
+
+  {  // remove all previous components that are active
+    ScopedTimer phase("backend/object_clustering/clear_components",
+                      info->timestamp_ns);
+    clearActiveComponents(graph, active_components);
+  }
+
+  if (config.async) {
+    // objects from the previous pass are applied before the next pass starts
+    ScopedTimer phase("backend/object_clustering/async_objects", info->timestamp_ns);
+    applyClustering(graph, false);
+    // saved before the next pass starts (snapshots discard the running pass)
+    saveStateIfDue(info->timestamp_ns);
+    launchClustering(graph);
+  } else {
+    {  // construct new components and cluster into objects
+      ScopedTimer phase("backend/object_clustering/detect_objects",
+                        info->timestamp_ns);
+      detectObjects(graph);
+    }
+
+    saveStateIfDue(info->timestamp_ns);
+  }
 
-  // repair broken edges between objects and places
-  updateActiveParents(graph);
-  // detect edges between segments (and active connected components)
-  const auto active_components = addSegmentEdges(graph);
-  // remove all previous components that are active
-  clearActiveComponents(graph, active_components);
-  // construct new components and cluster into objects
-  detectObjects(graph);
+  VLOG(2) << "[Object Clustering] " << stats_;
+  stats_log_.record(info->timestamp_ns, stats_);
   // we never have explict merges (clustering takes care of them)
   return {};
 }
 
+void ObjectUpdateFunctor::setTasks(hydra::EmbeddingGroup::Ptr tasks) {
+  pending_tasks_.set(std::move(tasks));
+}
+
+bool ObjectUpdateFunctor::updateTasks() const {
+  auto tasks = pending_tasks_.take();
+  if (!tasks) {
+    return false;
+  }
+
+  // a running pass refers to the old tasks (and is re-clustered anyways)
+  discardClustering();
+
+  // the index refers to the tasks, so it has to be replaced first
+  task_index_ = std::make_unique<TaskIndex>(config.task_index, *tasks, *metric_);
+  tasks_ = std::move(tasks);
+
+  // segments without features stay ignored once they are examined again
+  segment_stats_.clear();
+  ignored_.clear();
+  VLOG(1) << "[Object Clustering] switched to " << tasks_->embeddings.size()
+          << " task(s), re-clustering " << components_.size() << " component(s)";
+  return true;
+}
+
+ObjectClusteringSnapshot ObjectUpdateFunctor::getSnapshot() const {
+  discardClustering();
+
+  ObjectClusteringSnapshot snapshot;
+  snapshot.task_fingerprint = getTaskFingerprint(*tasks_);
+  snapshot.next_object_id = next_node_id_;
+  for (const auto& id_component_pair : components_) {
+    const auto& info = *id_component_pair.second;
+    snapshot.components.push_back({info.segments, info.objects});
+  }
+
+  snapshot.previous_objects = previous_objects_;
+  snapshot.ignored.assign(ignored_.begin(), ignored_.end());
+  snapshot.active.assign(active_.begin(), active_.end());
+
+  const auto& entries = segment_stats_.entries();
+  if (entries.empty()) {
+    return snapshot;
+  }
+
+  const auto& first = entries.begin()->second;
+  snapshot.features.resize(first.feature.rows(), entries.size());
+  snapshot.py_x.resize(first.py_x.rows(), entries.size());
+  snapshot.information.resize(entries.size());
+  size_t index = 0;
+  for (const auto& [node_id, entry] : entries) {
+    snapshot.stat_nodes.push_back(node_id);
+    snapshot.features.col(index) = entry.feature;
+    snapshot.py_x.col(index) = entry.py_x;
+    snapshot.information(index) = entry.information;
+    ++index;
+  }
+
+  return snapshot;
+}
+
+void ObjectUpdateFunctor::restoreSnapshot(
+    const ObjectClusteringSnapshot& snapshot) const {
+  discardClustering();
+  for (auto& [component_id, component] : components_) {
+    components_ids_.markFree(component_id);
+    releaseComponent(std::move(component));
+  }
+
+  components_.clear();
+  node_to_component_.clear();
+  for (const auto& saved : snapshot.components) {
+    // component IDs are internal, so only object IDs have to match the snapshot
+    const auto component_id = components_ids_.next();
+    auto component = acquireComponent();
+    component->segments = saved.segments;
+    component->objects = saved.objects;
+    component->stats = {};
+    for (const auto node_id : saved.segments) {
+      node_to_component_[node_id] = component_id;
+    }
+
+    components_.emplace(component_id, std::move(component));
+  }
+
+  previous_objects_ = snapshot.previous_objects;
+  segment_to_previous_object_.clear();
+  for (const auto& [object_id, segments] : previous_objects_) {
+    for (const auto segment_id : segments) {
+      segment_to_previous_object_[segment_id] = object_id;
+    }
+  }
+
+  ignored_.clear();
+  active_ = std::set<NodeId>(snapshot.active.begin(), snapshot.active.end());
+  next_node_id_ = NodeSymbol(snapshot.next_object_id);
+  segment_stats_.clear();
+  if (snapshot.task_fingerprint != getTaskFingerprint(*tasks_)) {
+    // like a task swap: scores and clusters depend on the tasks
+    VLOG(1) << "[Object Clustering] snapshot used different tasks, re-clustering "
+            << components_.size() << " component(s)";
+    invalidated_ = true;
+    return;
+  }
+
+  ignored_.insert(snapshot.ignored.begin(), snapshot.ignored.end());
+  for (size_t i = 0; i < snapshot.stat_nodes.size(); ++i) {
+    segment_stats_.insert(snapshot.stat_nodes[i],
+                          {snapshot.features.col(i),
+                           snapshot.py_x.col(i),
+                           snapshot.information(i)});
+  }
+}
+
+bool ObjectUpdateFunctor::saveState(const std::string& filepath) const {
+  return getSnapshot().save(filepath);
+}
+
+void ObjectUpdateFunctor::saveStateIfDue(uint64_t timestamp_ns) const {
+  if (config.state_path.empty() || config.state_save_interval == 0) {
+    return;
+  }
+
+  ++calls_since_save_;
+  // a pass that is still running is left alone and the state is saved once it is
+  // applied
+  if (calls_since_save_ < config.state_save_interval || clustering_job_.running()) {
+    return;
+  }
+
+  // failures are logged by the snapshot and retried after another interval
+  ScopedTimer timer("backend/object_clustering/save_state", timestamp_ns);
+  calls_since_save_ = 0;
+  saveState(config.state_path);
+}
+
+bool ObjectUpdateFunctor::loadState(const std::string& filepath) const {
+  const auto snapshot = ObjectClusteringSnapshot::load(filepath);
+  if (!snapshot) {
+    return false;
+  }
+
+  restoreSnapshot(*snapshot);
+  return true;
+}
+
 void ObjectUpdateFunctor::clearActiveComponents(DynamicSceneGraph& graph,
                                                 const std::set<size_t>& active) const {
+  for (const auto component_id : active) {
+    // results of the running pass are stale for components that changed (the ID is
+    // freed once the pass finishes)
+    const auto pending = pending_components_.find(component_id);
+    if (pending == pending_components_.end()) {
+      continue;
+    }
+
+    for (const auto node_id : pending->second) {
+      node_to_component_.erase(node_id);
+    }
+
+    pending_components_.erase(pending);
+  }
+
   auto iter = components_.begin();
   while (iter != components_.end()) {
     if (!active.count(iter->first)) {
@@ -151,20 +548,103 @@ void ObjectUpdateFunctor::clearActiveComponents(DynamicSceneGraph& graph,
       node_to_component_.erase(node_id);
     }
 
-    for (const auto& node_id : iter->second->objects) {
-      graph.removeNode(node_id);
-      active_.erase(node_id);
+    for (const auto& [object_id, object_segments] : iter->second->objects) {
+      if (config.reconcile_objects) {
+        // kept in the graph until detectObjects decides whether it can be reused
+        for (const auto segment_id : object_segments) {
+          segment_to_previous_object_[segment_id] = object_id;
+        }
+
+        previous_objects_[object_id] = object_segments;
+        continue;
+      }
+
+      graph.removeNode(object_id);
+      active_.erase(object_id);
     }
 
     components_ids_.markFree(iter->first);
+    releaseComponent(std::move(iter->second));
     iter = components_.erase(iter);
   }
 }
 
+ComponentInfo::Ptr ObjectUpdateFunctor::acquireComponent() const {
+  if (free_components_.empty()) {
+    ++stats_.components_allocated;
+    return std::make_unique<ComponentInfo>(config.selector);
+  }
+
+  auto component = std::move(free_components_.back());
+  free_components_.pop_back();
+  return component;
+}
+
+void ObjectUpdateFunctor::releaseComponent(ComponentInfo::Ptr component) const {
+  if (!component || free_components_.size() >= config.component_pool_size) {
+    return;
+  }
+
+  free_components_.push_back(std::move(component));
+}
+
+void ObjectUpdateFunctor::updateSegmentIndex(const SceneGraphLayer& segments) const {
+  if (!segment_index_) {
+    return;
+  }
+
+  auto iter = indexed_segments_.begin();
+  while (iter != indexed_segments_.end()) {
+    if (segments.hasNode(iter->first)) {
+      ++iter;
+      continue;
+    }
+
+    segment_index_->erase(iter->first);
+    iter = indexed_segments_.erase(iter);
+  }
+
+  // only new segments and segments that changed since they were indexed get new boxes
+  for (auto&& [node_id, node] : segments.nodes()) {
+    const auto& attrs = node->attributes<KhronosObjectAttributes>();
+    auto& indexed = indexed_segments_[node_id];
+    if (segment_index_->getBox(node_id) &&
+        indexed.last_update_time_ns == attrs.last_update_time_ns &&
+        indexed.bounding_box == attrs.bounding_box) {
+      continue;
+    }
+
+    segment_index_->insert(node_id, getIndexBox(attrs.bounding_box));
+    indexed = {attrs.last_update_time_ns, attrs.bounding_box};
+  }
+}
+
 std::set<size_t> ObjectUpdateFunctor::addSegmentEdges(DynamicSceneGraph& graph) const {
   const auto& segments = graph.getLayer(DsgLayers::SEGMENTS);
+  // call() pools every segment first, so this only matters when called directly
+  segment_embeddings_.addMissing(segments);
+  updateSegmentIndex(segments);
 
   std::set<size_t> active_components;
+  const auto check_edge = [&](NodeId node_id,
+                              const KhronosObjectAttributes& attrs,
+                              NodeId other_id) {
+    if (other_id == node_id) {
+      return;
+    }
+
+    const auto& other_attrs =
+        segments.getNode(other_id).attributes<KhronosObjectAttributes>();
+    ++stats_.segments_compared;
+    if (edge_checker_->call(attrs, other_attrs)) {
+      graph.insertEdge(node_id, other_id);
+      const auto iter = node_to_component_.find(other_id);
+      if (iter != node_to_component_.end()) {
+        active_components.insert(iter->second);
+      }
+    }
+  };
+
   for (auto&& [node_id, node] : segments.nodes()) {
     auto& attrs = node->attributes<KhronosObjectAttributes>();
     if (ignored_.count(node_id)) {
@@ -176,8 +656,16 @@ std::set<size_t> ObjectUpdateFunctor::addSegmentEdges(DynamicSceneGraph& graph)
       continue;
     }
 
-    const Eigen::VectorXf feature = attrs.semantic_feature.rowwise().mean();
-    const auto result = tasks_->getBestScore(*metric_, feature);
+    const auto entry = segment_embeddings_.getEntry(node_id);
+    if (!entry) {
+      VLOG(1) << "Skipping segment without feature";
+      ignored_.insert(node_id);
+      attrs.is_active = false;
+      continue;
+    }
+
+    const auto result =
+        task_index_->getBestScore(entry->feature, config.min_segment_score);
     if (result.score < config.min_segment_score) {
       VLOG(1) << "Skipping segment with score: " << result.score;
       ignored_.insert(node_id);
@@ -185,20 +673,18 @@ std::set<size_t> ObjectUpdateFunctor::addSegmentEdges(DynamicSceneGraph& graph)
       continue;
     }
 
-    // TODO(nathan) do something smarter than pairwise iteration
-    for (auto&& [other_id, other_node] : segments.nodes()) {
-      if (other_id == node_id) {
-        continue;
+    if (!segment_index_) {
+      for (const auto& id_node_pair : segments.nodes()) {
+        check_edge(node_id, attrs, id_node_pair.first);
       }
 
-      const auto& other_attrs = other_node->attributes<KhronosObjectAttributes>();
-      if (edge_checker_->call(attrs, other_attrs)) {
-        graph.insertEdge(node_id, other_id);
-        const auto iter = node_to_component_.find(other_id);
-        if (iter != node_to_component_.end()) {
-          active_components.insert(iter->second);
-        }
-      }
+      continue;
+    }
+
+    // candidates are exactly the segments whose boxes can overlap this one
+    const auto candidates = segment_index_->query(*segment_index_->getBox(node_id));
+    for (const auto other_id : candidates) {
+      check_edge(node_id, attrs, other_id);
     }
   }
 
@@ -206,7 +692,8 @@ std::set<size_t> ObjectUpdateFunctor::addSegmentEdges(DynamicSceneGraph& graph)
 }
 
 NodeAttributes::Ptr getMergedAttributes(const DynamicSceneGraph& graph,
-                                        const std::vector<NodeId>& nodes) {
+                                        const std::vector<NodeId>& nodes,
+                                        Eigen::VectorXf feature) {
   if (nodes.empty()) {
     return nullptr;
   }
@@ -218,23 +705,59 @@ NodeAttributes::Ptr getMergedAttributes(const DynamicSceneGraph& graph,
 
   auto attrs_ptr = node.attributes().clone();
   auto& attrs = *CHECK_NOTNULL(dynamic_cast<KhronosObjectAttributes*>(attrs_ptr.get()));
-  attrs.semantic_feature = attrs.semantic_feature.rowwise().mean().eval();
+  attrs.semantic_feature = std::move(feature);
 
+  std::vector<const KhronosObjectAttributes*> others;
+  others.reserve(nodes.size() - 1);
   while (iter != nodes.end()) {
     const auto& other = graph.getNode(*iter);
     const auto& other_attrs = other.attributes<KhronosObjectAttributes>();
     attrs.position += other_attrs.position;
-    attrs.semantic_feature += other_attrs.semantic_feature.rowwise().mean();
-    // TODO(nathan) update khronos to add the attribute merging somewhere convenient
-    mergeObjectAttributes(other_attrs, attrs);
+    others.push_back(&other_attrs);
     ++iter;
   }
 
+  // TODO(nathan) update khronos to add the attribute merging somewhere convenient
+  mergeObjectAttributes(others, attrs);
   attrs.position /= nodes.size();
-  attrs.semantic_feature /= nodes.size();
   return attrs_ptr;
 }
 
+void extendObjectAttributes(const DynamicSceneGraph& graph,
+                            const std::vector<NodeId>& to_add,
+                            size_t num_previous,
+                            Eigen::VectorXf feature,
+                            KhronosObjectAttributes& attrs) {
+  // undo the previous averaging
+  attrs.position *= num_previous;
+  std::vector<const KhronosObjectAttributes*> others;
+  others.reserve(to_add.size());
+  for (const auto node_id : to_add) {
+    const auto& other = graph.getNode(node_id);
+    const auto& other_attrs = other.attributes<KhronosObjectAttributes>();
+    attrs.position += other_attrs.position;
+    others.push_back(&other_attrs);
+  }
+
+  mergeObjectAttributes(others, attrs);
+
+  attrs.position /= num_previous + to_add.size();
+  attrs.semantic_feature = std::move(feature);
+}
+
+// total number of mesh vertices of a range of segments
+template <typename Iter>
+size_t getNumVertices(const DynamicSceneGraph& graph, Iter begin, Iter end) {
+  size_t num_vertices = 0;
+  for (auto iter = begin; iter != end; ++iter) {
+    const NodeId node_id = *iter;
+    const auto& attrs = graph.getNode(node_id).attributes<KhronosObjectAttributes>();
+    num_vertices += attrs.mesh.numVertices();
+  }
+
+  return num_vertices;
+}
+
 std::optional<std::pair<NodeId, bool>> getBestParent(const DynamicSceneGraph& graph,
                                                      const std::vector<NodeId>& nodes) {
   std::vector<NodeId> active;
@@ -267,73 +790,363 @@ std::optional<std::pair<NodeId, bool>> getBestParent(const DynamicSceneGraph& gr
 
 void ObjectUpdateFunctor::detectObjects(DynamicSceneGraph& graph) const {
   const auto& segments = graph.getLayer(DsgLayers::SEGMENTS);
+  segment_embeddings_.addMissing(segments);
 
-  const ClusteringWorkspace total_ws(segments);
-  const auto py_all = computeIBpy(*tasks_);
-  const auto px_all = computeIBpx(total_ws);
-  const auto py_x_all =
-      computeIBpyGivenX(total_ws, *tasks_, *metric_, config.selector.py_x);
-  double I_xy_all = mutualInformation(py_all, px_all, py_x_all);
+  // only segments that changed since the last call are rescored
+  segment_stats_.update(segment_embeddings_, *tasks_, *metric_);
+  const double I_xy_all = segment_stats_.mutualInformation();
 
   // connected component search
-  const auto new_components = graph_utilities::getConnectedComponents(
-      segments,
-      [&](const auto& n) { return isNodeActive(n, node_to_component_, ignored_); },
-      [&](const auto& edge) {
-        const auto source_active =
-            isNodeActive(segments.getNode(edge.source), node_to_component_, ignored_);
-        const auto target_active =
-            isNodeActive(segments.getNode(edge.target), node_to_component_, ignored_);
-        return source_active && target_active;
-      });
+  const auto new_components = getNewComponents(segments, node_to_component_, ignored_);
+
+  // components are recycled serially, as the pool of free components isn't shared
+  std::vector<ComponentInfo::Ptr> infos(new_components.size());
+  for (auto& info : infos) {
+    info = acquireComponent();
+  }
+
+  // components are independent (and only read the graph), so cluster in parallel
+  // (large components also score their edges on the pool)
+  pool_->parallelFor(new_components.size(), [&](size_t i) {
+    infos[i]->cluster(config.agglomeration,
+                      *tasks_,
+                      *metric_,
+                      segments,
+                      segment_embeddings_,
+                      new_components[i],
+                      I_xy_all,
+                      pool_.get());
+  });
+
+  // reassign components (graph modifications stay serial)
+  stats_.components_clustered += new_components.size();
+  for (size_t i = 0; i < new_components.size(); ++i) {
+    addComponent(graph, components_ids_.next(), new_components[i], std::move(infos[i]));
+  }
+
+  removePreviousObjects(graph);
+}
+
+void ObjectUpdateFunctor::addComponent(DynamicSceneGraph& graph,
+                                       size_t component_id,
+                                       const std::vector<NodeId>& nodes,
+                                       ComponentInfo::Ptr component) const {
+  stats_ += component->stats;
+  for (const auto node_id : nodes) {
+    node_to_component_[node_id] = component_id;
+  }
+
+  const auto clusters = component->ws.getClusters();
+  for (const auto& cluster : clusters) {
+    VLOG(5) << "Cluster: " << displayNodeSymbolContainer(cluster);
+
+    if (cluster.empty()) {
+      LOG(ERROR) << "empty cluster!";
+      continue;
+    }
+
+    NodeId object_id;
+    const auto reconciled = reconcileObject(graph, cluster, object_id);
+    if (reconciled == Reconciliation::REUSED) {
+      component->objects.emplace(object_id, cluster);
+      continue;
+    }
+
+    if (reconciled == Reconciliation::REJECTED) {
+      continue;
+    }
+
+    // pooled features are cached, so clusters are scored before any mesh is merged
+    auto feature = segment_embeddings_.combine(cluster);
+    const auto result = task_index_->getBestScore(feature, config.min_object_score);
+    if (result.score < config.min_object_score) {
+      VLOG(1) << "Skipping object with score: " << result.score;
+      continue;
+    }
+
+    auto attrs = getMergedAttributes(graph, cluster, std::move(feature));
+    // every other segment is merged into a copy of the first segment
+    stats_.vertices_merged += getNumVertices(graph, cluster.begin() + 1, cluster.end());
+    graph.emplaceNode(DsgLayers::OBJECTS, next_node_id_, std::move(attrs));
+    component->objects.emplace(next_node_id_, cluster);
+    updateObjectParent(graph, next_node_id_, cluster);
+    ++next_node_id_;
+  }
+
+  components_.emplace(component_id, std::move(component));
+}
+
+void ObjectUpdateFunctor::removePreviousObjects(DynamicSceneGraph& graph) const {
+  for (const auto& id_segments_pair : previous_objects_) {
+    graph.removeNode(id_segments_pair.first);
+    active_.erase(id_segments_pair.first);
+  }
 
-  // reassign components
-  for (const auto& nodes : new_components) {
-    size_t new_id = components_ids_.next();
-    auto new_component = std::make_unique<ComponentInfo>(
-        config.selector, *tasks_, *metric_, segments, nodes, I_xy_all);
+  previous_objects_.clear();
+  segment_to_previous_object_.clear();
+}
+
+bool ObjectUpdateFunctor::launchClustering(DynamicSceneGraph& graph) const {
+  if (clustering_job_.running()) {
+    return false;
+  }
+
+  const auto& segments = graph.getLayer(DsgLayers::SEGMENTS);
+  segment_embeddings_.addMissing(segments);
+  segment_stats_.update(segment_embeddings_, *tasks_, *metric_);
+  auto components = getNewComponents(segments, node_to_component_, ignored_);
+  if (components.empty()) {
+    // segments of previous objects can all be ignored
+    removePreviousObjects(graph);
+    return false;
+  }
+
+  auto job = std::make_unique<ClusteringJob>();
+  job->I_xy = segment_stats_.mutualInformation();
+  job->num_segments = segments.numNodes();
+  std::vector<NodeId> all_nodes;
+  for (const auto& nodes : components) {
+    const auto component_id = components_ids_.next();
     for (const auto node_id : nodes) {
-      node_to_component_[node_id] = new_id;
+      node_to_component_[node_id] = component_id;
+    }
+
+    pending_components_[component_id] = nodes;
+    job->ids.push_back(component_id);
+    job->features.push_back(segment_embeddings_.getFeatures(nodes));
+    job->infos.push_back(acquireComponent());
+    all_nodes.insert(all_nodes.end(), nodes.begin(), nodes.end());
+  }
+
+  job->segments = copyLayerTopology(segments, all_nodes);
+  job->components = std::move(components);
+  // every previous object belongs to a component in this pass (or is ignored)
+  job->previous_objects = std::move(previous_objects_);
+  job->segment_to_previous_object = std::move(segment_to_previous_object_);
+  previous_objects_.clear();
+  segment_to_previous_object_.clear();
+
+  VLOG(2) << "[Object Clustering] clustering " << job->components.size()
+          << " component(s) in the background";
+  clustering_job_.start([this, job = std::move(job)]() mutable {
+    pool_->parallelFor(job->components.size(), [&](size_t i) {
+      const auto& nodes = job->components[i];
+      const double delta_weight = static_cast<double>(nodes.size()) / job->num_segments;
+      job->infos[i]->cluster(config.agglomeration,
+                             *tasks_,
+                             *metric_,
+                             *job->segments,
+                             nodes,
+                             job->features[i],
+                             job->I_xy,
+                             delta_weight,
+                             pool_.get());
+    });
+    return std::move(job);
+  });
+  return true;
+}
+
+size_t ObjectUpdateFunctor::applyClustering(DynamicSceneGraph& graph,
+                                            bool block) const {
+  if (!clustering_job_.running()) {
+    return 0;
+  }
+
+  const auto elapsed = clustering_job_.elapsed();
+  const bool overdue =
+      config.async_max_latency > 0.0 && elapsed >= config.async_max_latency;
+  if (overdue && !clustering_job_.ready()) {
+    VLOG(1) << "[Object Clustering] waiting on clustering started " << elapsed
+            << " s ago";
+  }
+
+  auto result = clustering_job_.take(block || overdue);
+  if (!result) {
+    return 0;
+  }
+
+  // objects cleared after the pass started wait for the next pass
+  auto& job = **result;
+  std::swap(previous_objects_, job.previous_objects);
+  std::swap(segment_to_previous_object_, job.segment_to_previous_object);
+
+  const auto& segments = graph.getLayer(DsgLayers::SEGMENTS);
+  size_t num_applied = 0;
+  for (size_t i = 0; i < job.ids.size(); ++i) {
+    const auto component_id = job.ids[i];
+    const auto& nodes = job.components[i];
+    const auto pending = pending_components_.find(component_id);
+    bool valid = pending != pending_components_.end();
+    if (valid) {
+      pending_components_.erase(pending);
+      valid = std::all_of(nodes.begin(), nodes.end(), [&](NodeId node_id) {
+        return segments.hasNode(node_id);
+      });
     }
 
-    const auto clusters = new_component->ws.getClusters();
-    for (const auto& cluster : clusters) {
-      VLOG(5) << "Cluster: " << displayNodeSymbolContainer(cluster);
+    if (valid) {
+      ++stats_.components_clustered;
+      addComponent(graph, component_id, nodes, std::move(job.infos[i]));
+      ++num_applied;
+      continue;
+    }
+
+    // stale: the segments (and their previous objects) go to the next pass
+    for (const auto node_id : nodes) {
+      const auto iter = node_to_component_.find(node_id);
+      if (iter != node_to_component_.end() && iter->second == component_id) {
+        node_to_component_.erase(iter);
+      }
 
-      auto attrs = getMergedAttributes(graph, cluster);
-      if (!attrs) {
-        LOG(ERROR) << "empty cluster!";
+      const auto prev = segment_to_previous_object_.find(node_id);
+      if (prev == segment_to_previous_object_.end()) {
         continue;
       }
 
-      const auto& feature =
-          CHECK_NOTNULL(dynamic_cast<SemanticNodeAttributes*>(attrs.get()))
-              ->semantic_feature;
-      const auto result = tasks_->getBestScore(*metric_, feature);
-      if (result.score < config.min_object_score) {
-        VLOG(1) << "Skipping object with score: " << result.score;
+      auto object = previous_objects_.find(prev->second);
+      if (object == previous_objects_.end()) {
         continue;
       }
 
-      graph.emplaceNode(DsgLayers::OBJECTS, next_node_id_, std::move(attrs));
-      new_component->objects.push_back(next_node_id_);
+      for (const auto segment_id : object->second) {
+        segment_to_previous_object_.erase(segment_id);
+        job.segment_to_previous_object[segment_id] = object->first;
+      }
 
-      const auto parent = getBestParent(graph, cluster);
-      if (!parent) {
-        LOG(WARNING) << "object '" << next_node_id_.getLabel() << "' without parent!";
-        active_.insert(next_node_id_);
-      } else {
-        auto&& [parent_id, parent_active] = *parent;
-        graph.insertEdge(next_node_id_, parent_id);
-        if (parent_active) {
-          active_.insert(next_node_id_);
-        }
+      job.previous_objects.insert(previous_objects_.extract(object));
+    }
+
+    VLOG(2) << "[Object Clustering] discarding stale component " << component_id;
+    components_ids_.markFree(component_id);
+    releaseComponent(std::move(job.infos[i]));
+  }
+
+  removePreviousObjects(graph);
+  previous_objects_ = std::move(job.previous_objects);
+  segment_to_previous_object_ = std::move(job.segment_to_previous_object);
+  return num_applied;
+}
+
+void ObjectUpdateFunctor::discardClustering() const {
+  auto result = clustering_job_.take(true);
+  if (!result) {
+    return;
+  }
+
+  auto& job = **result;
+  for (size_t i = 0; i < job.ids.size(); ++i) {
+    const auto component_id = job.ids[i];
+    for (const auto node_id : job.components[i]) {
+      const auto iter = node_to_component_.find(node_id);
+      if (iter != node_to_component_.end() && iter->second == component_id) {
+        node_to_component_.erase(iter);
       }
+    }
+
+    pending_components_.erase(component_id);
+    components_ids_.markFree(component_id);
+    releaseComponent(std::move(job.infos[i]));
+  }
+
+  // previous objects are reconciled by the next pass instead
+  previous_objects_.merge(job.previous_objects);
+  segment_to_previous_object_.merge(job.segment_to_previous_object);
+}
+
+ObjectUpdateFunctor::Reconciliation ObjectUpdateFunctor::reconcileObject(
+    DynamicSceneGraph& graph,
+    const std::vector<NodeId>& cluster,
+    NodeId& object_id) const {
+  if (previous_objects_.empty()) {
+    return Reconciliation::NO_MATCH;
+  }
 
-      ++next_node_id_;
+  // the cluster has to contain every segment of exactly one previous object
+  std::optional<NodeId> match;
+  std::vector<NodeId> to_add;
+  for (const auto node_id : cluster) {
+    const auto iter = segment_to_previous_object_.find(node_id);
+    if (iter == segment_to_previous_object_.end()) {
+      to_add.push_back(node_id);
+      continue;
     }
 
-    components_.emplace(new_id, std::move(new_component));
+    if (match && *match != iter->second) {
+      return Reconciliation::NO_MATCH;
+    }
+
+    match = iter->second;
+  }
+
+  if (!match) {
+    return Reconciliation::NO_MATCH;
+  }
+
+  const auto prev = previous_objects_.find(*match);
+  if (prev == previous_objects_.end() ||
+      prev->second.size() + to_add.size() != cluster.size()) {
+    return Reconciliation::NO_MATCH;
+  }
+
+  object_id = *match;
+  const auto num_previous = prev->second.size();
+  previous_objects_.erase(prev);
+  for (const auto node_id : cluster) {
+    segment_to_previous_object_.erase(node_id);
+  }
+
+  // tasks can change, so the cluster is always scored again (before the object is
+  // touched)
+  auto feature = segment_embeddings_.combine(cluster);
+  const auto result = task_index_->getBestScore(feature, config.min_object_score);
+  if (result.score < config.min_object_score) {
+    VLOG(1) << "Removing object with score: " << result.score;
+    graph.removeNode(object_id);
+    active_.erase(object_id);
+    return Reconciliation::REJECTED;
+  }
+
+  const auto& node = graph.getLayer(DsgLayers::OBJECTS).nodes().at(object_id);
+  auto& attrs = node->attributes<KhronosObjectAttributes>();
+  if (to_add.empty()) {
+    return Reconciliation::REUSED;
+  }
+
+  VLOG(5) << "Extending object '" << NodeSymbol(object_id).getLabel() << "' with "
+          << to_add.size() << " segment(s)";
+  extendObjectAttributes(graph, to_add, num_previous, std::move(feature), attrs);
+  stats_.vertices_merged += getNumVertices(graph, to_add.begin(), to_add.end());
+  updateObjectParent(graph, object_id, cluster);
+  return Reconciliation::REUSED;
+}
+
+void ObjectUpdateFunctor::updateObjectParent(DynamicSceneGraph& graph,
+                                             NodeId object_id,
+                                             const std::vector<NodeId>& cluster) const {
+  const auto parent = getBestParent(graph, cluster);
+  if (!parent) {
+    if (!graph.getNode(object_id).getParent()) {
+      LOG(WARNING) << "object '" << NodeSymbol(object_id).getLabel()
+                   << "' without parent!";
+      active_.insert(object_id);
+    }
+
+    return;
+  }
+
+  auto&& [parent_id, parent_active] = *parent;
+  const auto prev_parent = graph.getNode(object_id).getParent();
+  if (prev_parent != parent_id) {
+    if (prev_parent) {
+      graph.removeEdge(object_id, *prev_parent);
+    }
+
+    graph.insertEdge(object_id, parent_id);
+  }
+
+  if (parent_active) {
+    active_.insert(object_id);
   }
 }
 
@@ -0,0 +1,362 @@
+#include "clio/online_clustering.h"
+
+#include <config_utilities/config.h>
+#include <config_utilities/validation.h>
+#include <glog/logging.h>
+
+#include <algorithm>
+
+#include "clio/ib_utils.h"
+#include "clio/probability_utilities.h"
+
+namespace clio {
+
+void declare_config(OnlineClustering::Config& config) {
+  using namespace config;
+  name("OnlineClustering::Config");
+  field(config.selector, "selector");
+}
+
+bool OnlineClustering::HeapCompare::operator()(const HeapEntry& lhs,
+                                               const HeapEntry& rhs) const {
+  // min-heap on score with ties broken by edge for deterministic merge order
+  if (lhs.score != rhs.score) {
+    return lhs.score > rhs.score;
+  }
+
+  return rhs.edge < lhs.edge;
+}
+
+OnlineClustering::OnlineClustering(const Config& config,
+                                   const hydra::EmbeddingGroup& tasks,
+                                   const hydra::EmbeddingDistance& metric)
+    : config(config::checkValid(config)),
+      tasks_(tasks),
+      metric_(metric),
+      py_(computeIBpy(tasks)) {}
+
+bool OnlineClustering::addNode(NodeId node, const Eigen::VectorXf& feature) {
+  if (nodes_.count(node)) {
+    return false;
+  }
+
+  auto& info = nodes_[node];
+  info.feature = feature;
+  info.cluster = node;
+  clusters_[node].nodes.insert(node);
+  pending_.insert(node);
+  dirty_.insert(node);
+  return true;
+}
+
+bool OnlineClustering::removeNode(NodeId node) {
+  const auto iter = nodes_.find(node);
+  if (iter == nodes_.end()) {
+    return false;
+  }
+
+  const auto cluster = iter->second.cluster;
+  for (const auto sibling : iter->second.neighbors) {
+    auto& other = nodes_.at(sibling);
+    other.neighbors.erase(node);
+    if (other.cluster != cluster) {
+      unlinkClusters(cluster, other.cluster);
+    }
+  }
+
+  const bool scored = iter->second.scored;
+  if (scored) {
+    information_sum_ -= iter->second.information;
+  }
+
+  pending_.erase(node);
+  nodes_.erase(iter);
+  if (scored) {
+    addChanges(1);
+  }
+
+  // the remaining members are not necessarily connected anymore
+  clusters_.at(cluster).nodes.erase(node);
+  dissolve(cluster);
+  return true;
+}
+
+bool OnlineClustering::addEdge(NodeId source, NodeId target) {
+  auto s_iter = nodes_.find(source);
+  auto t_iter = nodes_.find(target);
+  if (source == target || s_iter == nodes_.end() || t_iter == nodes_.end()) {
+    return false;
+  }
+
+  if (!s_iter->second.neighbors.insert(target).second) {
+    return false;
+  }
+
+  t_iter->second.neighbors.insert(source);
+  const auto s_cluster = s_iter->second.cluster;
+  const auto t_cluster = t_iter->second.cluster;
+  if (s_cluster != t_cluster) {
+    linkClusters(s_cluster, t_cluster);
+    dirty_.insert(s_cluster);
+    dirty_.insert(t_cluster);
+  }
+
+  return true;
+}
+
+bool OnlineClustering::removeEdge(NodeId source, NodeId target) {
+  auto s_iter = nodes_.find(source);
+  auto t_iter = nodes_.find(target);
+  if (s_iter == nodes_.end() || t_iter == nodes_.end()) {
+    return false;
+  }
+
+  if (!s_iter->second.neighbors.erase(target)) {
+    return false;
+  }
+
+  t_iter->second.neighbors.erase(source);
+  const auto s_cluster = s_iter->second.cluster;
+  const auto t_cluster = t_iter->second.cluster;
+  if (s_cluster == t_cluster) {
+    dissolve(s_cluster);
+  } else {
+    unlinkClusters(s_cluster, t_cluster);
+  }
+
+  return true;
+}
+
+size_t OnlineClustering::update() {
+  scorePending();
+  for (const auto cluster : dirty_) {
+    scoreEdges(cluster);
+  }
+  dirty_.clear();
+
+  // max_delta * I(X;Y) with the 1 / N from p(x) folded into cluster sizes
+  const double threshold = config.selector.max_delta * information_sum_;
+  size_t num_merges = 0;
+  while (!heap_.empty()) {
+    std::pop_heap(heap_.begin(), heap_.end(), HeapCompare());
+    const auto entry = heap_.back();
+    heap_.pop_back();
+    const auto iter = scores_.find(entry.edge);
+    if (iter == scores_.end() || iter->second.second != entry.stamp) {
+      continue;
+    }
+
+    if (entry.score >= threshold) {
+      heap_.push_back(entry);
+      std::push_heap(heap_.begin(), heap_.end(), HeapCompare());
+      break;
+    }
+
+    merge(entry.edge);
+    ++num_merges;
+  }
+
+  VLOG(5) << "Online clustering: " << num_merges << " merges, " << clusters_.size()
+          << " clusters, " << nodes_.size() << " nodes";
+  return num_merges;
+}
+
+NodeId OnlineClustering::getCluster(NodeId node) const {
+  return nodes_.at(node).cluster;
+}
+
+std::vector<std::vector<NodeId>> OnlineClustering::getClusters() const {
+  std::vector<std::vector<NodeId>> clusters;
+  clusters.reserve(clusters_.size());
+  for (const auto& id_cluster_pair : clusters_) {
+    const auto& nodes = id_cluster_pair.second.nodes;
+    clusters.emplace_back(nodes.begin(), nodes.end());
+  }
+
+  // same ordering as ClusteringWorkspace::getClusters
+  std::sort(clusters.begin(), clusters.end());
+  return clusters;
+}
+
+double OnlineClustering::mutualInformation() const {
+  const auto num_scored = nodes_.size() - pending_.size();
+  return num_scored ? information_sum_ / static_cast<double>(num_scored) : 0.0;
+}
+
+void OnlineClustering::scorePending() {
+  if (pending_.empty()) {
+    return;
+  }
+
+  const auto dim = nodes_.at(*pending_.begin()).feature.rows();
+  Eigen::MatrixXf features(dim, pending_.size());
+  size_t index = 0;
+  for (const auto node : pending_) {
+    const auto& feature = nodes_.at(node).feature;
+    CHECK_EQ(feature.rows(), dim) << "inconsistent feature size for node " << node;
+    features.col(index) = feature;
+    ++index;
+  }
+
+  const auto py_x = computeIBpyGivenX(features, tasks_, metric_, config.selector.py_x);
+  index = 0;
+  for (const auto node : pending_) {
+    auto& info = nodes_.at(node);
+    info.py_x = py_x.col(index);
+    info.information = klDivergence(info.py_x, py_);
+    info.scored = true;
+    information_sum_ += info.information;
+
+    // unscored nodes are never merged
+    auto& cluster = clusters_.at(info.cluster);
+    cluster.py_z = info.py_x;
+    cluster.entropy = mixtureEntropy(cluster.py_z, cluster.py_z, 1.0, 0.0);
+    ++index;
+  }
+
+  const auto num_scored = pending_.size();
+  pending_.clear();
+  addChanges(num_scored);
+}
+
+void OnlineClustering::makeSingleton(NodeId node) {
+  auto& info = nodes_.at(node);
+  info.cluster = node;
+  auto& cluster = clusters_[node];
+  cluster.nodes.insert(node);
+  if (info.scored) {
+    cluster.py_z = info.py_x;
+    cluster.entropy = mixtureEntropy(cluster.py_z, cluster.py_z, 1.0, 0.0);
+  }
+
+  dirty_.insert(node);
+}
+
+void OnlineClustering::dissolve(NodeId cluster) {
+  auto iter = clusters_.find(cluster);
+  const auto info = std::move(iter->second);
+  clusters_.erase(iter);
+  dirty_.erase(cluster);
+  for (const auto& id_count_pair : info.neighbors) {
+    clusters_.at(id_count_pair.first).neighbors.erase(cluster);
+    scores_.erase(EdgeKey(cluster, id_count_pair.first));
+  }
+
+  for (const auto node : info.nodes) {
+    makeSingleton(node);
+  }
+
+  for (const auto node : info.nodes) {
+    for (const auto sibling : nodes_.at(node).neighbors) {
+      const bool is_member = info.nodes.count(sibling);
+      if (!is_member || node < sibling) {
+        linkClusters(node, nodes_.at(sibling).cluster);
+      }
+    }
+  }
+}
+
+void OnlineClustering::linkClusters(NodeId lhs, NodeId rhs) {
+  ++clusters_.at(lhs).neighbors[rhs];
+  ++clusters_.at(rhs).neighbors[lhs];
+}
+
+void OnlineClustering::unlinkClusters(NodeId lhs, NodeId rhs) {
+  auto& lhs_neighbors = clusters_.at(lhs).neighbors;
+  auto& rhs_neighbors = clusters_.at(rhs).neighbors;
+  auto iter = lhs_neighbors.find(rhs);
+  CHECK(iter != lhs_neighbors.end()) << "missing edge " << lhs << " -> " << rhs;
+  if (--iter->second > 0) {
+    --rhs_neighbors.at(lhs);
+    return;
+  }
+
+  lhs_neighbors.erase(iter);
+  rhs_neighbors.erase(lhs);
+  scores_.erase(EdgeKey(lhs, rhs));
+}
+
+void OnlineClustering::merge(EdgeKey edge) {
+  // relabel the smaller cluster
+  auto root = edge.k1;
+  auto other = edge.k2;
+  if (clusters_.at(other).nodes.size() > clusters_.at(root).nodes.size()) {
+    std::swap(root, other);
+  }
+
+  auto& target = clusters_.at(root);
+  auto& source = clusters_.at(other);
+  scores_.erase(edge);
+  target.neighbors.erase(other);
+  source.neighbors.erase(root);
+
+  const double n_t = target.nodes.size();
+  const double n_s = source.nodes.size();
+  target.py_z = ((n_t * target.py_z + n_s * source.py_z) / (n_t + n_s)).eval();
+  target.entropy = mixtureEntropy(target.py_z, target.py_z, 1.0, 0.0);
+  for (const auto node : source.nodes) {
+    nodes_.at(node).cluster = root;
+    target.nodes.insert(node);
+  }
+
+  for (const auto& [neighbor, count] : source.neighbors) {
+    auto& neighbors = clusters_.at(neighbor).neighbors;
+    neighbors.erase(other);
+    neighbors[root] += count;
+    target.neighbors[neighbor] += count;
+    scores_.erase(EdgeKey(other, neighbor));
+  }
+
+  clusters_.erase(other);
+  scoreEdges(root);
+}
+
+void OnlineClustering::scoreEdges(NodeId cluster) {
+  for (const auto& id_count_pair : clusters_.at(cluster).neighbors) {
+    const EdgeKey edge(cluster, id_count_pair.first);
+    const HeapEntry entry{scoreEdge(edge), edge, next_stamp_++};
+    scores_[edge] = {entry.score, entry.stamp};
+    heap_.push_back(entry);
+    std::push_heap(heap_.begin(), heap_.end(), HeapCompare());
+  }
+
+  if (heap_.size() <= 2 * scores_.size() + 16) {
+    return;
+  }
+
+  // drop stale entries so the heap stays proportional to the number of edges
+  heap_.clear();
+  for (const auto& [edge, score_stamp] : scores_) {
+    heap_.push_back({score_stamp.first, edge, score_stamp.second});
+  }
+
+  std::make_heap(heap_.begin(), heap_.end(), HeapCompare());
+}
+
+double OnlineClustering::scoreEdge(EdgeKey edge) const {
+  const auto& lhs = clusters_.at(edge.k1);
+  const auto& rhs = clusters_.at(edge.k2);
+  const double n_l = lhs.nodes.size();
+  const double n_r = rhs.nodes.size();
+  const double total = n_l + n_r;
+  const auto divergence = pairwiseJensenShannonDivergence(
+      lhs.py_z, rhs.py_z, n_l / total, n_r / total, lhs.entropy, rhs.entropy);
+  return total * divergence;
+}
+
+void OnlineClustering::addChanges(size_t num_changes) {
+  changes_since_refresh_ += num_changes;
+  if (changes_since_refresh_ < nodes_.size()) {
+    return;
+  }
+
+  // same amortized re-summing as NodeStatisticsCache
+  information_sum_ = 0.0;
+  for (const auto& id_node_pair : nodes_) {
+    information_sum_ += id_node_pair.second.information;
+  }
+
+  changes_since_refresh_ = 0;
+}
+
+}  // namespace clio
@@ -0,0 +1,168 @@
+#include "clio/pooled_embedding_cache.h"
+
+#include <config_utilities/config.h>
+#include <config_utilities/validation.h>
+#include <glog/logging.h>
+#include <spark_dsg/node_attributes.h>
+
+namespace clio {
+
+using namespace spark_dsg;
+using Pooling = PooledEmbeddingCache::Pooling;
+
+void declare_config(PooledEmbeddingCache::Config& config) {
+  using namespace config;
+  name("PooledEmbeddingCache::Config");
+  field(config.pooling, "pooling");
+  field(config.weight_by_views, "weight_by_views");
+
+  checkCondition(config.pooling == "mean" || config.pooling == "max" ||
+                     config.pooling == "last",
+                 "pooling must be one of 'mean', 'max' or 'last'");
+}
+
+Pooling getPooling(const std::string& name) {
+  if (name == "max") {
+    return Pooling::MAX;
+  }
+
+  if (name == "last") {
+    return Pooling::LAST;
+  }
+
+  CHECK_EQ(name, "mean") << "unknown pooling operation";
+  return Pooling::MEAN;
+}
+
+PooledEmbeddingCache::PooledEmbeddingCache() : PooledEmbeddingCache(Config()) {}
+
+PooledEmbeddingCache::PooledEmbeddingCache(const Config& config)
+    : config(config::checkValid(config)), pooling_(getPooling(config.pooling)) {}
+
+Eigen::VectorXf PooledEmbeddingCache::pool(const Eigen::MatrixXf& views) const {
+  switch (pooling_) {
+    case Pooling::MAX:
+      return views.rowwise().maxCoeff();
+    case Pooling::LAST:
+      return views.rightCols<1>();
+    case Pooling::MEAN:
+    default:
+      return views.rowwise().mean();
+  }
+}
+
+size_t PooledEmbeddingCache::update(const SceneGraphLayer& layer) {
+  auto iter = entries_.begin();
+  while (iter != entries_.end()) {
+    if (layer.hasNode(iter->first)) {
+      ++iter;
+    } else {
+      iter = entries_.erase(iter);
+    }
+  }
+
+  size_t num_pooled = 0;
+  for (const auto& [node_id, node] : layer.nodes()) {
+    const auto& attrs = node->attributes<SemanticNodeAttributes>();
+    auto prev = entries_.find(node_id);
+    if (prev != entries_.end() && !attrs.is_active) {
+      continue;
+    }
+
+    if (!add(node_id, attrs)) {
+      if (prev != entries_.end()) {
+        entries_.erase(prev);
+      }
+
+      continue;
+    }
+
+    ++num_pooled;
+  }
+
+  VLOG(10) << "Pooled embeddings: " << num_pooled << " pooled, " << entries_.size()
+           << " total";
+  return num_pooled;
+}
+
+size_t PooledEmbeddingCache::addMissing(const SceneGraphLayer& layer) {
+  size_t num_pooled = 0;
+  for (const auto& [node_id, node] : layer.nodes()) {
+    if (entries_.count(node_id)) {
+      continue;
+    }
+
+    if (add(node_id, node->attributes<SemanticNodeAttributes>())) {
+      ++num_pooled;
+    }
+  }
+
+  return num_pooled;
+}
+
+bool PooledEmbeddingCache::add(NodeId node, const SemanticNodeAttributes& attrs) {
+  if (attrs.semantic_feature.size() == 0) {
+    return false;
+  }
+
+  auto& entry = entries_[node];
+  entry.feature = pool(attrs.semantic_feature);
+  entry.num_views = attrs.semantic_feature.cols();
+  return true;
+}
+
+bool PooledEmbeddingCache::erase(NodeId node) { return entries_.erase(node) > 0; }
+
+void PooledEmbeddingCache::clear() { entries_.clear(); }
+
+const PooledEmbeddingCache::Entry* PooledEmbeddingCache::getEntry(NodeId node) const {
+  const auto iter = entries_.find(node);
+  return iter == entries_.end() ? nullptr : &iter->second;
+}
+
+const Eigen::VectorXf& PooledEmbeddingCache::getFeature(NodeId node) const {
+  const auto entry = getEntry(node);
+  CHECK(entry) << "missing pooled feature for node " << NodeSymbol(node).getLabel();
+  return entry->feature;
+}
+
+Eigen::MatrixXf PooledEmbeddingCache::getFeatures(
+    const std::vector<NodeId>& nodes) const {
+  if (nodes.empty()) {
+    return {};
+  }
+
+  Eigen::MatrixXf features(getFeature(nodes.front()).rows(), nodes.size());
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    features.col(i) = getFeature(nodes[i]);
+  }
+
+  return features;
+}
+
+Eigen::VectorXf PooledEmbeddingCache::combine(const std::vector<NodeId>& nodes) const {
+  if (nodes.empty()) {
+    return {};
+  }
+
+  Eigen::VectorXf combined;
+  float total = 0.0f;
+  for (const auto node_id : nodes) {
+    const auto entry = getEntry(node_id);
+    CHECK(entry) << "missing pooled feature for node "
+                 << NodeSymbol(node_id).getLabel();
+    const float weight =
+        config.weight_by_views ? static_cast<float>(entry->num_views) : 1.0f;
+    if (combined.size() == 0) {
+      combined = weight * entry->feature;
+    } else {
+      combined += weight * entry->feature;
+    }
+
+    total += weight;
+  }
+
+  return combined / total;
+}
+
+}  // namespace clio
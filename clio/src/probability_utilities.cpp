@@ -3,6 +3,9 @@
 #include <glog/logging.h>
 #include <hydra/utils/printing.h>
 
+#include <algorithm>
+#include <cmath>
+
 namespace clio {
 
 // -sum(p(x)log(p(x))) over all x
@@ -48,6 +51,98 @@ double jensenShannonDivergence(const Eigen::MatrixXd& pa_b,
   return shannonEntropy(M, tolerance) - total_entropy;
 }
 
+namespace {
+
+template <typename Scalar>
+using VectorRef = Eigen::Ref<const Eigen::Matrix<Scalar, Eigen::Dynamic, 1>>;
+
+// -sum(m(x)log(m(x))) over all x for m = w1 * p1 + w2 * p2
+template <typename Scalar>
+double mixtureEntropyImpl(const VectorRef<Scalar>& p1,
+                          const VectorRef<Scalar>& p2,
+                          double w1,
+                          double w2,
+                          double tolerance) {
+  // lazily evaluated: the mixture, log and sum fuse into one packet loop
+  const auto m =
+      static_cast<Scalar>(w1) * p1.array() + static_cast<Scalar>(w2) * p2.array();
+  const Scalar total =
+      (m >= static_cast<Scalar>(tolerance)).select(m * m.log(), Scalar(0)).sum();
+  return -static_cast<double>(total) / M_LN2;
+}
+
+// sum(p(x)log(p(x) / q(x))) over all x
+template <typename Scalar>
+double klDivergenceImpl(const VectorRef<Scalar>& p,
+                        const VectorRef<Scalar>& q,
+                        double tolerance) {
+  CHECK_EQ(p.rows(), q.rows());
+  const auto threshold = static_cast<Scalar>(tolerance);
+  double total = 0.0;
+  for (int i = 0; i < p.rows(); ++i) {
+    // avoid log blowing up for events that can't occur
+    if (p(i) < threshold || q(i) < threshold) {
+      continue;
+    }
+
+    total += p(i) * std::log2(p(i) / q(i));
+  }
+
+  return total;
+}
+
+}  // namespace
+
+double mixtureEntropy(const Eigen::Ref<const Eigen::VectorXd>& p1,
+                      const Eigen::Ref<const Eigen::VectorXd>& p2,
+                      double w1,
+                      double w2,
+                      double tolerance) {
+  return mixtureEntropyImpl<double>(p1, p2, w1, w2, tolerance);
+}
+
+double mixtureEntropy(const Eigen::Ref<const Eigen::VectorXf>& p1,
+                      const Eigen::Ref<const Eigen::VectorXf>& p2,
+                      double w1,
+                      double w2,
+                      double tolerance) {
+  return mixtureEntropyImpl<float>(p1, p2, w1, w2, tolerance);
+}
+
+double pairwiseJensenShannonDivergence(const Eigen::Ref<const Eigen::VectorXd>& p1,
+                                       const Eigen::Ref<const Eigen::VectorXd>& p2,
+                                       double w1,
+                                       double w2,
+                                       double H1,
+                                       double H2,
+                                       double tolerance) {
+  const auto divergence = mixtureEntropy(p1, p2, w1, w2, tolerance) - w1 * H1 - w2 * H2;
+  return std::max(divergence, 0.0);
+}
+
+double pairwiseJensenShannonDivergence(const Eigen::Ref<const Eigen::VectorXf>& p1,
+                                       const Eigen::Ref<const Eigen::VectorXf>& p2,
+                                       double w1,
+                                       double w2,
+                                       double H1,
+                                       double H2,
+                                       double tolerance) {
+  const auto divergence = mixtureEntropy(p1, p2, w1, w2, tolerance) - w1 * H1 - w2 * H2;
+  return std::max(divergence, 0.0);
+}
+
+double klDivergence(const Eigen::Ref<const Eigen::VectorXd>& p,
+                    const Eigen::Ref<const Eigen::VectorXd>& q,
+                    double tolerance) {
+  return klDivergenceImpl<double>(p, q, tolerance);
+}
+
+double klDivergence(const Eigen::Ref<const Eigen::VectorXf>& p,
+                    const Eigen::Ref<const Eigen::VectorXf>& q,
+                    double tolerance) {
+  return klDivergenceImpl<float>(p, q, tolerance);
+}
+
 // compute the mutual information between two distributions
 double mutualInformation(const Eigen::VectorXd& pa,
                          const Eigen::VectorXd& pb,
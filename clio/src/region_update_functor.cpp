@@ -7,6 +7,9 @@
 #include <hydra/utils/display_utilities.h>
 #include <hydra/utils/timing_utilities.h>
 
+#include <algorithm>
+#include <unordered_set>
+
 namespace clio {
 namespace {
 
@@ -27,43 +30,200 @@ void declare_config(RegionUpdateFunctor::Config& config) {
   using namespace config;
   name("RegionUpdateFunctorConfig::Config");
   field(config.clustering, "clustering");
+  field(config.embeddings, "embeddings");
+  field(config.incremental, "incremental");
+  field(config.diff_update, "diff_update");
+  field(config.async, "async");
+  field(config.async_max_latency, "async_max_latency");
+}
+
+NodeId emplaceRegion(DynamicSceneGraph& graph,
+                     NodeId region_id,
+                     const Cluster& cluster) {
+  auto attrs = std::make_unique<SemanticNodeAttributes>();
+  attrs->semantic_label = 0;
+  attrs->name = cluster.best_task_name;
+  attrs->semantic_feature = cluster.feature;
+  attrs->semantic_label = cluster.best_task_index;
+  graph.emplaceNode(DsgLayers::ROOMS, region_id, std::move(attrs));
+
+  for (const auto node_id : cluster.nodes) {
+    graph.insertEdge(region_id, node_id);
+  }
+
+  return region_id;
+}
+
+bool updateRegionAttributes(SemanticNodeAttributes& attrs, const Cluster& cluster) {
+  const auto& feature = attrs.semantic_feature;
+  const bool same_feature = feature.rows() == cluster.feature.rows() &&
+                            feature.cols() == 1 && feature == cluster.feature;
+  if (same_feature && attrs.name == cluster.best_task_name &&
+      attrs.semantic_label == cluster.best_task_index) {
+    return false;
+  }
+
+  attrs.name = cluster.best_task_name;
+  attrs.semantic_feature = cluster.feature;
+  attrs.semantic_label = cluster.best_task_index;
+  return true;
+}
+
+void updateRegionPosition(DynamicSceneGraph& graph, NodeId region_id) {
+  const auto& places = graph.getLayer(DsgLayers::PLACES);
+  const auto& node = graph.getLayer(DsgLayers::ROOMS).nodes().at(region_id);
+  const std::unordered_set<NodeId> to_use(node->children().begin(),
+                                          node->children().end());
+  node->attributes().position = hydra::getRoomPosition(places, to_use);
 }
 
 RegionUpdateFunctor::RegionUpdateFunctor(const Config& config)
     : config(config::checkValid(config)),
       region_id_('l', 0),
-      clustering_(config.clustering) {}
+      clustering_(config.clustering),
+      place_embeddings_(config.embeddings),
+      place_stats_(config.clustering.selector.py_x),
+      stats_log_("region_clustering") {}
+
+RegionUpdateFunctor::~RegionUpdateFunctor() {
+  // the running pass uses the clustering
+  clustering_job_.wait();
+}
 
 MergeList RegionUpdateFunctor::call(const DynamicSceneGraph&,
                                     hydra::SharedDsgInfo& dsg,
                                     const hydra::UpdateInfo::ConstPtr& info) const {
   ScopedTimer timer("backend/region_clustering", info->timestamp_ns);
+  stats_ = {};
+  if (config.incremental) {
+    updateIncremental(*dsg.graph);
+  } else if (config.async) {
+    // regions from the previous pass are applied before the next pass starts
+    ScopedTimer phase("backend/region_clustering/async_regions", info->timestamp_ns);
+    applyClustering(*dsg.graph, false);
+    launchClustering(*dsg.graph);
+  } else {
+    updateBatch(*dsg.graph, info->timestamp_ns);
+  }
 
-  // TODO(nathan) cache this computation
-  const auto& places = dsg.graph->getLayer(DsgLayers::PLACES);
+  VLOG(2) << "[Region Clustering] " << stats_;
+  stats_log_.record(info->timestamp_ns, stats_);
+  return {};
+}
+
+void RegionUpdateFunctor::updateBatch(DynamicSceneGraph& graph,
+                                      uint64_t timestamp_ns) const {
+  const auto& places = graph.getLayer(DsgLayers::PLACES);
   AgglomerativeClustering::NodeEmbeddingMap valid_features;
+  {  // collect place features (only active places are pooled again)
+    ScopedTimer phase("backend/region_clustering/features", timestamp_ns);
+    place_embeddings_.update(places);
+    for (auto&& [node_id, node] : places.nodes()) {
+      const auto& attrs = node->attributes<SemanticNodeAttributes>();
+      if (attrs.semantic_feature.size() <= 1) {
+        continue;
+      }
+
+      valid_features[node_id] = place_embeddings_.getFeature(node_id);
+    }
+  }
+
+  if (valid_features.empty()) {
+    VLOG(2) << "Need to have at least one valid place feature";
+    return;
+  }
+
+  Clusters clusters;
+  {  // cluster places into regions
+    ScopedTimer phase("backend/region_clustering/cluster", timestamp_ns);
+    clusters = clustering_.cluster(places, valid_features);
+    stats_ = clustering_.stats();
+  }
+
+  {  // apply the new regions to the graph
+    ScopedTimer phase("backend/region_clustering/graph_update", timestamp_ns);
+    updateGraphBatch(graph, clusters);
+  }
+}
+
+bool RegionUpdateFunctor::launchClustering(const DynamicSceneGraph& graph) const {
+  if (clustering_job_.running()) {
+    return false;
+  }
+
+  const auto& places = graph.getLayer(DsgLayers::PLACES);
+  place_embeddings_.update(places);
+  AgglomerativeClustering::NodeEmbeddingMap valid_features;
+  std::vector<NodeId> valid_places;
   for (auto&& [node_id, node] : places.nodes()) {
     const auto& attrs = node->attributes<SemanticNodeAttributes>();
     if (attrs.semantic_feature.size() <= 1) {
       continue;
     }
 
-    valid_features[node_id] = attrs.semantic_feature.rightCols<1>();
+    valid_features[node_id] = place_embeddings_.getFeature(node_id);
+    valid_places.push_back(node_id);
   }
 
   if (valid_features.empty()) {
     VLOG(2) << "Need to have at least one valid place feature";
-    return {};
+    return false;
   }
 
-  const auto clusters = clustering_.cluster(places, valid_features);
-  updateGraphBatch(*dsg.graph, clusters);
-  return {};
+  // the clustering is only used by the worker thread until the pass is applied
+  clustering_job_.start([this,
+                         layer = copyLayerTopology(places, valid_places),
+                         features = std::move(valid_features)]() {
+    ClusteringResult result;
+    result.clusters = clustering_.cluster(*layer, features);
+    result.stats = clustering_.stats();
+    return result;
+  });
+  return true;
+}
+
+bool RegionUpdateFunctor::applyClustering(DynamicSceneGraph& graph, bool block) const {
+  const auto elapsed = clustering_job_.elapsed();
+  const bool overdue =
+      config.async_max_latency > 0.0 && elapsed >= config.async_max_latency;
+  if (overdue && !clustering_job_.ready()) {
+    VLOG(1) << "[Region Clustering] waiting on clustering started " << elapsed
+            << " s ago";
+  }
+
+  auto result = clustering_job_.take(block || overdue);
+  if (!result) {
+    return false;
+  }
+
+  // places can be removed while clustering runs
+  const auto& places = graph.getLayer(DsgLayers::PLACES);
+  Clusters clusters;
+  for (auto& cluster : result->clusters) {
+    for (auto iter = cluster->nodes.begin(); iter != cluster->nodes.end();) {
+      iter = places.hasNode(*iter) ? std::next(iter) : cluster->nodes.erase(iter);
+    }
+
+    if (!cluster->nodes.empty()) {
+      clusters.push_back(std::move(cluster));
+    }
+  }
+
+  stats_ = result->stats;
+  updateGraphBatch(graph, clusters);
+  return true;
+}
+
+void RegionUpdateFunctor::setTasks(hydra::EmbeddingGroup::Ptr tasks) {
+  clustering_.setTasks(std::move(tasks));
 }
 
-void RegionUpdateFunctor::updateGraphBatch(DynamicSceneGraph& graph,
-                                           const Clusters& clusters) const {
+size_t RegionUpdateFunctor::updateGraphBatch(DynamicSceneGraph& graph,
+                                             const Clusters& clusters) const {
   VLOG(2) << "Got " << clusters.size() << " cluster(s)";
+  if (config.diff_update) {
+    return updateGraphDiff(graph, clusters);
+  }
 
   std::vector<NodeId> prev_regions;
   for (const auto& id_node_pair : graph.getLayer(DsgLayers::ROOMS).nodes()) {
@@ -74,31 +234,314 @@ void RegionUpdateFunctor::updateGraphBatch(DynamicSceneGraph& graph,
     graph.removeNode(node);
   }
 
+  size_t num_changes = prev_regions.size();
   std::set<NodeId> new_nodes;
   for (size_t i = 0; i < clusters.size(); ++i) {
     NodeSymbol new_node_id(region_id_.category(), i);
-    auto attrs = std::make_unique<SemanticNodeAttributes>();
-    attrs->semantic_label = 0;
-    attrs->name = clusters[i]->best_task_name;
-    attrs->semantic_feature = clusters[i]->feature;
-    attrs->semantic_label = clusters[i]->best_task_index;
-    graph.emplaceNode(DsgLayers::ROOMS, new_node_id, std::move(attrs));
+    new_nodes.insert(emplaceRegion(graph, new_node_id, *clusters[i]));
+    num_changes += 1 + clusters[i]->nodes.size();
+  }
+
+  for (const auto node_id : new_nodes) {
+    updateRegionPosition(graph, node_id);
+  }
+
+  hydra::addEdgesToRoomLayer(graph, new_nodes);
+  return num_changes;
+}
 
+size_t RegionUpdateFunctor::updateGraphDiff(DynamicSceneGraph& graph,
+                                            const Clusters& clusters) const {
+  const auto& regions = graph.getLayer(DsgLayers::ROOMS);
+
+  // number of places shared between each previous region and new cluster
+  std::map<std::pair<NodeId, size_t>, size_t> overlaps;
+  for (size_t i = 0; i < clusters.size(); ++i) {
     for (const auto node_id : clusters[i]->nodes) {
-      graph.insertEdge(new_node_id, node_id);
+      const auto parent = graph.getNode(node_id).getParent();
+      if (parent && regions.hasNode(*parent)) {
+        ++overlaps[{*parent, i}];
+      }
+    }
+  }
+
+  // greedily match by decreasing overlap (map order breaks ties deterministically)
+  std::vector<std::pair<size_t, std::pair<NodeId, size_t>>> candidates;
+  for (const auto& [key, overlap] : overlaps) {
+    candidates.push_back({overlap, key});
+  }
+
+  std::stable_sort(
+      candidates.begin(), candidates.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.first > rhs.first;
+      });
+
+  std::map<NodeId, size_t> region_to_cluster;
+  std::vector<bool> matched(clusters.size(), false);
+  for (const auto& [overlap, key] : candidates) {
+    auto&& [region_id, index] = key;
+    if (region_to_cluster.count(region_id) || matched[index]) {
+      continue;
+    }
+
+    region_to_cluster[region_id] = index;
+    matched[index] = true;
+  }
+
+  size_t num_removed = 0;
+  std::vector<NodeId> to_remove;
+  for (const auto& id_node_pair : regions.nodes()) {
+    if (!region_to_cluster.count(id_node_pair.first)) {
+      to_remove.push_back(id_node_pair.first);
+    }
+  }
+
+  for (const auto region_id : to_remove) {
+    graph.removeNode(region_id);
+    ++num_removed;
+  }
+
+  // detach places first so that every place is free before it gets a new parent
+  size_t num_updated = 0;
+  size_t num_edges = 0;
+  std::set<NodeId> changed;
+  for (const auto& [region_id, index] : region_to_cluster) {
+    const auto& cluster = *clusters[index];
+    const auto& node = regions.nodes().at(region_id);
+    if (updateRegionAttributes(node->attributes<SemanticNodeAttributes>(), cluster)) {
+      ++num_updated;
+    }
+
+    std::vector<NodeId> removed;
+    for (const auto child : node->children()) {
+      if (!cluster.nodes.count(child)) {
+        removed.push_back(child);
+      }
+    }
+
+    for (const auto child : removed) {
+      graph.removeEdge(region_id, child);
+      changed.insert(region_id);
+      ++num_edges;
+    }
+  }
+
+  for (const auto& [region_id, index] : region_to_cluster) {
+    for (const auto node_id : clusters[index]->nodes) {
+      if (graph.getNode(node_id).getParent() == region_id) {
+        continue;
+      }
+
+      graph.insertEdge(region_id, node_id);
+      changed.insert(region_id);
+      ++num_edges;
+    }
+  }
+
+  size_t num_added = 0;
+  for (size_t i = 0; i < clusters.size(); ++i) {
+    if (matched[i]) {
+      continue;
+    }
+
+    while (graph.hasNode(region_id_)) {
+      ++region_id_;
+    }
+
+    changed.insert(emplaceRegion(graph, region_id_, *clusters[i]));
+    num_edges += clusters[i]->nodes.size();
+    ++num_added;
+    ++region_id_;
+  }
+
+  // only regions with different children need a new position and neighbors
+  for (const auto region_id : changed) {
+    updateRegionPosition(graph, region_id);
+    const auto siblings = regions.getNode(region_id).siblings();
+    for (const auto sibling : siblings) {
+      graph.removeEdge(region_id, sibling);
+    }
+  }
+
+  hydra::addEdgesToRoomLayer(graph, changed);
+
+  const size_t num_changes = num_added + num_removed + num_updated + num_edges;
+  VLOG(2) << "Region update: " << num_added << " added, " << num_removed
+          << " removed, " << num_updated << " updated, " << num_edges
+          << " edge(s) changed (" << region_to_cluster.size() << " kept)";
+  return num_changes;
+}
+
+std::set<NodeId> RegionUpdateFunctor::updatePlaces(
+    const SceneGraphLayer& places) const {
+  place_embeddings_.update(places);
+
+  std::set<NodeId> dirty;
+  const auto mark_dirty = [&](NodeId node_id, const PlaceInfo& info) {
+    dirty.insert(node_id);
+    dirty.insert(info.siblings.begin(), info.siblings.end());
+  };
+
+  auto iter = places_.begin();
+  while (iter != places_.end()) {
+    if (places.hasNode(iter->first)) {
+      ++iter;
+      continue;
+    }
+
+    mark_dirty(iter->first, iter->second);
+    place_stats_.erase(iter->first);
+    iter = places_.erase(iter);
+  }
+
+  std::vector<NodeId> changed;
+  std::vector<Eigen::VectorXf> changed_features;
+  for (auto&& [node_id, node] : places.nodes()) {
+    auto prev = places_.find(node_id);
+    if (prev != places_.end() && !node->attributes().is_active) {
+      // archived places don't change
+      continue;
+    }
+
+    const auto& attrs = node->attributes<SemanticNodeAttributes>();
+    if (attrs.semantic_feature.size() <= 1) {
+      if (prev != places_.end()) {
+        mark_dirty(node_id, prev->second);
+        place_stats_.erase(node_id);
+        places_.erase(prev);
+      }
+
+      continue;
     }
 
-    new_nodes.insert(new_node_id);
+    PlaceInfo info{place_embeddings_.getFeature(node_id), node->siblings()};
+    if (prev != places_.end()) {
+      const auto& prev_feature = prev->second.feature;
+      if (prev_feature.rows() == info.feature.rows() && prev_feature == info.feature &&
+          prev->second.siblings == info.siblings) {
+        continue;
+      }
+
+      // previous neighbors need to be revisited in case an edge was removed
+      mark_dirty(node_id, prev->second);
+    }
+
+    mark_dirty(node_id, info);
+    changed.push_back(node_id);
+    changed_features.push_back(info.feature);
+    places_[node_id] = std::move(info);
+  }
+
+  if (!changed.empty()) {
+    Eigen::MatrixXf features(changed_features.front().rows(), changed.size());
+    for (size_t i = 0; i < changed.size(); ++i) {
+      features.col(i) = changed_features[i];
+    }
+
+    place_stats_.insert(changed, features, clustering_.tasks(), clustering_.metric());
+  }
+
+  return dirty;
+}
+
+size_t RegionUpdateFunctor::updateIncremental(DynamicSceneGraph& graph) const {
+  if (clustering_.updateTasks()) {
+    // every place has to be rescored and re-clustered against the new tasks (and
+    // regions unknown to the incremental state are removed below)
+    VLOG(1) << "[Region Clustering] tasks changed, re-clustering every place";
+    places_.clear();
+    regions_.clear();
+    place_to_region_.clear();
+    place_stats_.clear();
+  }
+
+  if (clustering_.tasks().empty()) {
+    // leave places uncached so that they are all clustered once tasks show up
+    LOG_FIRST_N(ERROR, 5) << "No tasks present: cannot cluster";
+    return 0;
   }
 
   const auto& places = graph.getLayer(DsgLayers::PLACES);
-  for (auto&& [node_id, node] : graph.getLayer(DsgLayers::ROOMS).nodes()) {
-    const std::unordered_set<NodeId> to_use(node->children().begin(),
-                                            node->children().end());
-    node->attributes().position = hydra::getRoomPosition(places, to_use);
+  const auto dirty = updatePlaces(places);
+
+  // regions that this functor didn't create (or that were removed) are invalid
+  std::vector<NodeId> to_remove;
+  for (const auto& id_node_pair : graph.getLayer(DsgLayers::ROOMS).nodes()) {
+    if (!regions_.count(id_node_pair.first)) {
+      to_remove.push_back(id_node_pair.first);
+    }
+  }
+
+  for (auto iter = regions_.begin(); iter != regions_.end(); ++iter) {
+    if (!graph.hasNode(iter->first)) {
+      to_remove.push_back(iter->first);
+    }
+  }
+
+  std::set<NodeId> to_cluster;
+  for (const auto node_id : dirty) {
+    const auto region = place_to_region_.find(node_id);
+    if (region != place_to_region_.end()) {
+      to_remove.push_back(region->second);
+    } else if (places_.count(node_id)) {
+      to_cluster.insert(node_id);
+    }
+  }
+
+  for (const auto region_id : to_remove) {
+    auto region = regions_.find(region_id);
+    if (region != regions_.end()) {
+      for (const auto node_id : region->second) {
+        place_to_region_.erase(node_id);
+        if (places_.count(node_id)) {
+          to_cluster.insert(node_id);
+        }
+      }
+
+      regions_.erase(region);
+    }
+
+    if (graph.hasNode(region_id)) {
+      graph.removeNode(region_id);
+    }
+  }
+
+  if (to_cluster.empty()) {
+    VLOG(2) << "No changed places: keeping " << regions_.size() << " region(s)";
+    return 0;
+  }
+
+  AgglomerativeClustering::NodeEmbeddingMap features;
+  for (const auto node_id : to_cluster) {
+    features.emplace(node_id, places_.at(node_id).feature);
+  }
+
+  // the places being re-clustered are a subset of every valid place (and the tasks
+  // were already switched above, so the place statistics stay consistent)
+  const double delta_weight = static_cast<double>(features.size()) / places_.size();
+  const auto clusters = clustering_.cluster(
+      places, features, place_stats_.mutualInformation(), delta_weight);
+  stats_ = clustering_.stats();
+  VLOG(2) << "Re-clustered " << features.size() << " / " << places_.size()
+          << " place(s) into " << clusters.size() << " cluster(s), kept "
+          << regions_.size() << " region(s)";
+
+  std::set<NodeId> new_nodes;
+  for (const auto& cluster : clusters) {
+    const auto region_id = emplaceRegion(graph, region_id_, *cluster);
+    ++region_id_;
+
+    regions_[region_id].insert(cluster->nodes.begin(), cluster->nodes.end());
+    for (const auto node_id : cluster->nodes) {
+      place_to_region_[node_id] = region_id;
+    }
+
+    updateRegionPosition(graph, region_id);
+    new_nodes.insert(region_id);
   }
 
   hydra::addEdgesToRoomLayer(graph, new_nodes);
+  return features.size();
 }
 
 }  // namespace clio
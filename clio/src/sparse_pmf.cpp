@@ -0,0 +1,155 @@
+#include "clio/sparse_pmf.h"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace clio {
+
+namespace {
+
+// call func(index, w1 * p1(index) + w2 * p2(index)) for every index in either
+// support (ascending) and return the size of the union
+template <typename Func>
+size_t forEachInUnion(const SparsePmf& p1,
+                      const SparsePmf& p2,
+                      double w1,
+                      double w2,
+                      const Func& func) {
+  CHECK_EQ(p1.dim, p2.dim);
+  size_t i = 0;
+  size_t j = 0;
+  size_t num_union = 0;
+  while (i < p1.nnz() || j < p2.nnz()) {
+    if (j == p2.nnz() || (i < p1.nnz() && p1.indices[i] < p2.indices[j])) {
+      func(p1.indices[i], w1 * p1.values[i] + w2 * p2.floor);
+      ++i;
+    } else if (i == p1.nnz() || p2.indices[j] < p1.indices[i]) {
+      func(p2.indices[j], w1 * p1.floor + w2 * p2.values[j]);
+      ++j;
+    } else {
+      func(p1.indices[i], w1 * p1.values[i] + w2 * p2.values[j]);
+      ++i;
+      ++j;
+    }
+
+    ++num_union;
+  }
+
+  return num_union;
+}
+
+}  // namespace
+
+double SparsePmf::operator()(Eigen::Index i) const {
+  const auto iter = std::lower_bound(indices.begin(), indices.end(), i);
+  if (iter == indices.end() || *iter != i) {
+    return floor;
+  }
+
+  return values[iter - indices.begin()];
+}
+
+Eigen::VectorXd SparsePmf::toDense() const {
+  Eigen::VectorXd p = Eigen::VectorXd::Constant(dim, floor);
+  for (size_t i = 0; i < indices.size(); ++i) {
+    p(indices[i]) = values[i];
+  }
+
+  return p;
+}
+
+SparsePmf SparsePmf::fromDense(const Eigen::Ref<const Eigen::VectorXd>& p,
+                               double floor) {
+  SparsePmf pmf;
+  pmf.dim = p.rows();
+  pmf.floor = floor;
+  for (Eigen::Index i = 0; i < p.rows(); ++i) {
+    if (p(i) != floor) {
+      pmf.indices.push_back(i);
+      pmf.values.push_back(p(i));
+    }
+  }
+
+  return pmf;
+}
+
+SparsePmf mixPmfs(const SparsePmf& p1, const SparsePmf& p2, double w1, double w2) {
+  SparsePmf mixture;
+  mixture.dim = p1.dim;
+  mixture.floor = w1 * p1.floor + w2 * p2.floor;
+  mixture.indices.reserve(p1.nnz() + p2.nnz());
+  mixture.values.reserve(p1.nnz() + p2.nnz());
+  forEachInUnion(p1, p2, w1, w2, [&](Eigen::Index index, double value) {
+    mixture.indices.push_back(index);
+    mixture.values.push_back(value);
+  });
+
+  return mixture;
+}
+
+double mixtureEntropy(const SparsePmf& p1,
+                      const SparsePmf& p2,
+                      double w1,
+                      double w2,
+                      double tolerance) {
+  double total = 0.0;
+  const auto num_union = forEachInUnion(p1, p2, w1, w2, [&](Eigen::Index, double m) {
+    if (m >= tolerance) {
+      total += m * std::log(m);
+    }
+  });
+
+  // every index outside both supports shares the same mixed floor
+  const double m = w1 * p1.floor + w2 * p2.floor;
+  if (m >= tolerance) {
+    total += static_cast<double>(p1.dim - num_union) * m * std::log(m);
+  }
+
+  return -total / M_LN2;
+}
+
+double pairwiseJensenShannonDivergence(const SparsePmf& p1,
+                                       const SparsePmf& p2,
+                                       double w1,
+                                       double w2,
+                                       double H1,
+                                       double H2,
+                                       double tolerance) {
+  const auto divergence = mixtureEntropy(p1, p2, w1, w2, tolerance) - w1 * H1 - w2 * H2;
+  return std::max(divergence, 0.0);
+}
+
+double klDivergence(const SparsePmf& p,
+                    const Eigen::Ref<const Eigen::VectorXd>& q,
+                    double tolerance) {
+  CHECK_EQ(p.dim, q.rows());
+  const auto add_term = [&](double p_i, double q_i) {
+    // avoid log blowing up for events that can't occur
+    return p_i < tolerance || q_i < tolerance ? 0.0 : p_i * std::log2(p_i / q_i);
+  };
+
+  double total = 0.0;
+  for (size_t i = 0; i < p.nnz(); ++i) {
+    total += add_term(p.values[i], q(p.indices[i]));
+  }
+
+  if (p.floor < tolerance) {
+    return total;
+  }
+
+  size_t next = 0;
+  for (Eigen::Index i = 0; i < p.dim; ++i) {
+    if (next < p.nnz() && p.indices[next] == i) {
+      ++next;
+      continue;
+    }
+
+    total += add_term(p.floor, q(i));
+  }
+
+  return total;
+}
+
+}  // namespace clio
@@ -0,0 +1,143 @@
+#include "clio/task_index.h"
+
+#include <config_utilities/config.h>
+#include <config_utilities/validation.h>
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace clio {
+
+void declare_config(TaskIndex::Config& config) {
+  using namespace config;
+  name("TaskIndex::Config");
+  field(config.enable, "enable");
+  field(config.min_tasks, "min_tasks");
+  field(config.rerank_k, "rerank_k");
+  field(config.tolerance, "tolerance");
+  check(config.rerank_k, GT, 0, "rerank_k");
+  check(config.tolerance, GE, 0.0, "tolerance");
+}
+
+bool canIndex(const TaskIndex::Config& config,
+              const hydra::EmbeddingGroup& tasks,
+              const hydra::EmbeddingDistance& metric) {
+  if (!config.enable || tasks.embeddings.empty() ||
+      tasks.embeddings.size() < config.min_tasks) {
+    return false;
+  }
+
+  if (!dynamic_cast<const hydra::CosineDistance*>(&metric)) {
+    VLOG(1) << "Task index only supports cosine metrics: scanning tasks instead";
+    return false;
+  }
+
+  const auto dim = tasks.embeddings.front().size();
+  for (const auto& embedding : tasks.embeddings) {
+    if (embedding.size() != dim) {
+      LOG(WARNING) << "Task embeddings have mixed dimensions: scanning tasks instead";
+      return false;
+    }
+  }
+
+  return true;
+}
+
+TaskIndex::TaskIndex(const hydra::EmbeddingGroup& tasks,
+                     const hydra::EmbeddingDistance& metric)
+    : TaskIndex(Config(), tasks, metric) {}
+
+TaskIndex::TaskIndex(const Config& config,
+                     const hydra::EmbeddingGroup& tasks,
+                     const hydra::EmbeddingDistance& metric)
+    : config(config::checkValid(config)),
+      tasks_(tasks),
+      metric_(metric),
+      indexed_(canIndex(config, tasks, metric)) {
+  if (!indexed_) {
+    return;
+  }
+
+  const auto& embeddings = tasks_.embeddings;
+  normalized_.resize(embeddings.size(), embeddings.front().size());
+  for (size_t i = 0; i < embeddings.size(); ++i) {
+    const auto norm = embeddings[i].norm();
+    if (norm > 0.0f) {
+      normalized_.row(i) = embeddings[i].transpose() / norm;
+    } else {
+      normalized_.row(i).setZero();
+    }
+  }
+}
+
+TaskIndex::Score TaskIndex::getBestScore(const Eigen::VectorXf& feature,
+                                         double min_score) const {
+  if (!indexed_ || feature.size() != normalized_.cols()) {
+    return tasks_.getBestScore(metric_, feature);
+  }
+
+  const auto norm = feature.norm();
+  Eigen::VectorXf approx = Eigen::VectorXf::Zero(normalized_.rows());
+  if (norm > 0.0f) {
+    approx.noalias() = normalized_ * (feature / norm);
+  }
+
+  // best approximate tasks in descending order (ties keep the lower task index)
+  const auto k = std::min(config.rerank_k, static_cast<size_t>(approx.size()));
+  std::vector<size_t> candidates;
+  candidates.reserve(k + 1);
+  for (int i = 0; i < approx.size(); ++i) {
+    if (candidates.size() == k && approx(i) <= approx(candidates.back())) {
+      continue;
+    }
+
+    auto pos = candidates.end();
+    while (pos != candidates.begin() && approx(*std::prev(pos)) < approx(i)) {
+      --pos;
+    }
+
+    candidates.insert(pos, i);
+    if (candidates.size() > k) {
+      candidates.pop_back();
+    }
+  }
+
+  Score best;
+  best.index = candidates.front();
+  best.score = approx(best.index);
+  if (best.score + config.tolerance < min_score) {
+    // rescoring can't lift the task over the threshold
+    return best;
+  }
+
+  // rescore in task order so that exact ties resolve like a linear scan
+  std::sort(candidates.begin(), candidates.end());
+  best.score = -std::numeric_limits<double>::infinity();
+  for (const auto index : candidates) {
+    const auto score = metric_.score(tasks_.embeddings[index], feature);
+    if (score > best.score) {
+      best.score = score;
+      best.index = index;
+    }
+  }
+
+  return best;
+}
+
+void PendingTasks::set(hydra::EmbeddingGroup::Ptr tasks) {
+  if (!tasks) {
+    LOG(ERROR) << "Ignoring invalid tasks";
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  tasks_ = std::move(tasks);
+}
+
+hydra::EmbeddingGroup::Ptr PendingTasks::take() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return std::move(tasks_);
+}
+
+}  // namespace clio
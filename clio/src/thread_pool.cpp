@@ -0,0 +1,113 @@
+#include "clio/thread_pool.h"
+
+#include <algorithm>
+
+namespace clio {
+
+ThreadPool::Job::Job(size_t count, const std::function<void(size_t)>& func)
+    : count(count), func(func), next(0), finished(0) {}
+
+ThreadPool::ThreadPool(size_t num_threads) {
+  if (num_threads == 0) {
+    num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+  }
+
+  workers_.reserve(num_threads - 1);
+  for (size_t i = 0; i + 1 < num_threads; ++i) {
+    workers_.emplace_back(&ThreadPool::spin, this);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    should_shutdown_ = true;
+  }
+
+  work_cv_.notify_all();
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& func) {
+  if (count == 0) {
+    return;
+  }
+
+  if (workers_.empty() || count == 1) {
+    for (size_t i = 0; i < count; ++i) {
+      func(i);
+    }
+
+    return;
+  }
+
+  auto job = std::make_shared<Job>(count, func);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    jobs_.push_back(job);
+  }
+
+  work_cv_.notify_all();
+  work(*job);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_cv_.wait(lock, [&]() { return job->finished == job->count; });
+  const auto iter = std::find(jobs_.begin(), jobs_.end(), job);
+  if (iter != jobs_.end()) {
+    jobs_.erase(iter);
+  }
+
+  if (job->error) {
+    std::rethrow_exception(job->error);
+  }
+}
+
+void ThreadPool::spin() {
+  while (true) {
+    std::shared_ptr<Job> job;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      work_cv_.wait(lock, [this]() { return should_shutdown_ || !jobs_.empty(); });
+      if (should_shutdown_) {
+        return;
+      }
+
+      job = jobs_.front();
+      if (job->next >= job->count) {
+        // everything is claimed: stop other workers from picking the job up
+        jobs_.pop_front();
+        continue;
+      }
+    }
+
+    work(*job);
+  }
+}
+
+void ThreadPool::work(Job& job) {
+  while (true) {
+    const size_t index = job.next++;
+    if (index >= job.count) {
+      return;
+    }
+
+    try {
+      job.func(index);
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!job.error) {
+        job.error = std::current_exception();
+      }
+    }
+
+    if (++job.finished == job.count) {
+      // lock so the notification can't slip in before the caller starts waiting
+      std::lock_guard<std::mutex> lock(mutex_);
+      done_cv_.notify_all();
+    }
+  }
+}
+
+}  // namespace clio
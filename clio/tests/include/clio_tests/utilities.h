@@ -1,6 +1,12 @@
 #pragma once
 
+#include <clio/clustering_workspace.h>
+#include <clio/ib_edge_selector.h>
 #include <hydra/openset/embedding_distances.h>
+#include <spark_dsg/dynamic_scene_graph.h>
+
+#include <optional>
+#include <string>
 
 namespace clio::test {
 
@@ -23,4 +29,41 @@ struct TestEmbeddingGroup : public EmbeddingGroup {
 
 void declare_config(TestEmbeddingGroup::Config&);
 
+//! path of a file called name in the system temporary directory
+std::string getTempPath(const std::string& name);
+
+/**
+ * @brief Add a segment spanning [min, max] along the x-axis to the graph
+ *
+ * The segment feature is TestEmbeddingGroup::getEmbedding(onehot_index), where
+ * onehot_index defaults to the segment index.
+ */
+void addSegment(spark_dsg::DynamicSceneGraph& graph,
+                size_t index,
+                double min,
+                double max,
+                std::optional<size_t> onehot_index = std::nullopt);
+
+//! parameters of a GridFixture besides its size and seed
+struct GridConfig {
+  size_t feature_dim = 32;
+  size_t num_tasks = 50;
+  //! max_delta of the selector config
+  double max_delta = 1.0e-3;
+};
+
+//! nodes on a grid with features drawn around one of a few centers per grid block
+struct GridFixture {
+  GridFixture(size_t side,
+              size_t num_centers,
+              unsigned seed,
+              const GridConfig& grid = {});
+
+  spark_dsg::IsolatedSceneGraphLayer layer;
+  ClusteringWorkspace::NodeEmbeddings embeddings;
+  hydra::EmbeddingGroup tasks;
+  hydra::CosineDistance metric;
+  IBEdgeSelector::Config config;
+};
+
 }  // namespace clio::test
@@ -1,13 +1,15 @@
 #include "clio_tests/utilities.h"
 
 #include <algorithm>
+#include <cstdlib>
+#include <filesystem>
 
 namespace clio::test {
 
 TestEmbeddingGroup::TestEmbeddingGroup(const Config& config) {
-  embeddings.push_back(Eigen::VectorXd::Zero(10));
+  embeddings.push_back(Eigen::VectorXf::Zero(10));
   for (size_t i = 0; i < config.num_embeddings; ++i) {
-    embeddings.push_back(TestEmbeddingGroup::getEmbedding(i));
+    embeddings.push_back(TestEmbeddingGroup::getEmbedding(i).cast<float>());
   }
 }
 
@@ -30,4 +32,59 @@ void declare_config(TestEmbeddingGroup::Config& config) {
   field(config.num_embeddings, "num_embeddings");
 }
 
+std::string getTempPath(const std::string& name) {
+  return (std::filesystem::temp_directory_path() / name).string();
+}
+
+void addSegment(spark_dsg::DynamicSceneGraph& graph,
+                size_t index,
+                double min,
+                double max,
+                std::optional<size_t> onehot_index) {
+  using namespace spark_dsg;
+  auto attrs = std::make_unique<KhronosObjectAttributes>();
+  attrs->position << (min + max) / 2.0, 0.0, 0.0;
+  attrs->bounding_box =
+      BoundingBox(Eigen::Vector3f(min, -1.0, -1.0), Eigen::Vector3f(max, 1.0, 1.0));
+  attrs->semantic_feature =
+      TestEmbeddingGroup::getEmbedding(onehot_index.value_or(index)).cast<float>();
+  graph.emplaceNode(DsgLayers::SEGMENTS, NodeSymbol('s', index), std::move(attrs));
+}
+
+GridFixture::GridFixture(size_t side,
+                         size_t num_centers,
+                         unsigned seed,
+                         const GridConfig& grid)
+    : layer(2) {
+  std::srand(seed);
+  std::vector<Eigen::VectorXf> centers;
+  for (size_t i = 0; i < num_centers; ++i) {
+    centers.push_back(Eigen::VectorXf::Random(grid.feature_dim));
+  }
+
+  for (size_t r = 0; r < side; ++r) {
+    for (size_t c = 0; c < side; ++c) {
+      const NodeId node_id = r * side + c;
+      layer.emplaceNode(node_id, std::make_unique<spark_dsg::NodeAttributes>());
+      const auto center = (r * num_centers / side) % num_centers;
+      embeddings[node_id] =
+          centers[center] + 0.3 * Eigen::VectorXf::Random(grid.feature_dim);
+      if (c > 0) {
+        layer.insertEdge(node_id - 1, node_id);
+      }
+      if (r > 0) {
+        layer.insertEdge(node_id - side, node_id);
+      }
+    }
+  }
+
+  for (size_t i = 0; i < grid.num_tasks; ++i) {
+    tasks.embeddings.push_back(Eigen::VectorXf::Random(grid.feature_dim));
+    tasks.names.push_back(std::to_string(i));
+  }
+
+  config.max_delta = grid.max_delta;
+  config.py_x.score_threshold = 0.1;
+}
+
 }  // namespace clio::test
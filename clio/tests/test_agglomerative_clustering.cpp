@@ -1,4 +1,5 @@
 #include <clio/agglomerative_clustering.h>
+#include <clio/clustering_stats.h>
 #include <clio/clustering_workspace.h>
 #include <clio/common.h>
 #include <clio/embedding_distances.h>
@@ -53,8 +54,8 @@ std::map<NodeId, size_t> getNodeAssignments(const std::vector<Cluster::Ptr>& clu
   return assignments;
 }
 
-template <typename K, typename V>
-std::string printMap(const std::map<K, V>& values) {
+template <typename Map>
+std::string printMap(const Map& values) {
   std::stringstream ss;
   ss << "{";
   auto iter = values.begin();
@@ -87,9 +88,8 @@ std::string printVec(const std::vector<T>& values) {
 
 std::string workspaceState(const ClusteringWorkspace& ws) {
   std::stringstream ss;
-  ss << "lookup: " << printMap(ws.node_lookup) << std::endl;
-  ss << "order: " << printMap(ws.order) << std::endl;
-  ss << "assignments: " << printVec(ws.assignments) << std::endl;
+  ss << "lookup: " << printVec(ws.node_lookup) << std::endl;
+  ss << "assignments: " << printVec(ws.getAssignments()) << std::endl;
   ss << "edges: " << printMap(ws.edges) << std::endl;
   return ss.str();
 }
@@ -162,4 +162,48 @@ TEST(AgglomerativeClustering, GetClustersCorrect) {
   }
 }
 
+TEST(AgglomerativeClustering, ClusteringStatsCounted) {
+  // chain of two groups of similar nodes
+  IsolatedSceneGraphLayer layer(2);
+  ClusteringWorkspace::NodeEmbeddings embeddings;
+  for (size_t i = 0; i < 20; ++i) {
+    layer.emplaceNode(i, std::make_unique<NodeAttributes>());
+    const Eigen::VectorXd feature =
+        getOneHot(i < 10 ? 0 : 1, 10) + 0.1 * getOneHot(i % 10, 10);
+    embeddings[i] = feature.cast<float>();
+    if (i > 0) {
+      layer.insertEdge(i - 1, i);
+    }
+  }
+
+  hydra::EmbeddingGroup tasks;
+  for (size_t i = 0; i < 3; ++i) {
+    tasks.embeddings.push_back(getOneHot(i, 10).cast<float>());
+    tasks.names.push_back(std::to_string(i));
+  }
+
+  hydra::CosineDistance metric;
+  IBEdgeSelector::Config config;
+  config.max_delta = 0.1;
+
+  ClusteringWorkspace ws(layer, embeddings);
+  const size_t num_edges = ws.edges.size();
+  IBEdgeSelector selector(config);
+  const auto stats = clusterAgglomerative(ws, tasks, selector, metric);
+
+  // every merge removes exactly one cluster
+  EXPECT_EQ(stats.merges, ws.size() - ws.getClusters().size());
+  EXPECT_GT(stats.merges, 0u);
+  EXPECT_GE(stats.edges_scored, num_edges);
+  EXPECT_EQ(stats.components_clustered, 0u);
+  EXPECT_GT(stats.setup_time.count(), 0);
+
+  ClusteringStats total;
+  total += stats;
+  total += stats;
+  EXPECT_EQ(total.merges, 2 * stats.merges);
+  EXPECT_EQ(total.edges_scored, 2 * stats.edges_scored);
+  EXPECT_EQ(total.merge_time, 2 * stats.merge_time);
+}
+
 }  // namespace clio
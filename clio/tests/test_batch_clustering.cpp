@@ -0,0 +1,134 @@
+#include <clio/batch_clustering.h>
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+
+#include "clio_tests/utilities.h"
+
+namespace clio {
+
+struct BatchClusteringTests : public ::testing::Test {
+  BatchClusteringTests()
+      : graph_info({{DsgLayers::SEGMENTS, 's'},
+                    {DsgLayers::OBJECTS, 'o'},
+                    {DsgLayers::PLACES, 'p'}}),
+        tasks(test::TestEmbeddingGroup::Config{2}) {
+    config.selector.max_delta = 1.0e-3;
+    config.prune_threshold = 0.5;
+    config.recompute_edges = true;
+  }
+
+  void addSegment(size_t index, double min, double max, size_t onehot_index) {
+    test::addSegment(graph(), index, min, max, onehot_index);
+  }
+
+  // segments of every object in the graph
+  std::set<std::set<NodeId>> getObjects(const DynamicSceneGraph& graph) const {
+    std::set<std::set<NodeId>> objects;
+    const auto& segments = graph.getLayer(DsgLayers::SEGMENTS);
+    for (const auto& id_node : graph.getLayer(DsgLayers::OBJECTS).nodes()) {
+      std::set<NodeId> children;
+      for (const auto& segment_node : segments.nodes()) {
+        if (graph.hasEdge(id_node.first, segment_node.first)) {
+          children.insert(segment_node.first);
+        }
+      }
+
+      objects.insert(children);
+    }
+
+    return objects;
+  }
+
+  DynamicSceneGraph& graph() { return *graph_info.graph; }
+
+  SharedDsgInfo graph_info;
+  test::TestEmbeddingGroup tasks;
+  hydra::CosineDistance metric;
+  BatchClusteringConfig config;
+};
+
+TEST_F(BatchClusteringTests, ClustersSegmentsIntoObjects) {
+  addSegment(0, -1.0, 1.0, 1);
+  addSegment(1, 0.5, 1.5, 1);
+  addSegment(2, 3.0, 4.0, 0);
+  addSegment(3, 3.5, 4.5, 1);
+  graph().emplaceNode(
+      DsgLayers::OBJECTS, "o5"_id, std::make_unique<KhronosObjectAttributes>());
+
+  const auto result = clusterSegments(graph(), tasks, metric, config);
+  ASSERT_TRUE(result.graph);
+  EXPECT_EQ(result.num_clusters, 3u);
+  EXPECT_EQ(result.num_objects, 3u);
+
+  const std::set<std::set<NodeId>> expected{
+      {"s0"_id, "s1"_id}, {"s2"_id}, {"s3"_id}};
+  EXPECT_EQ(getObjects(*result.graph), expected);
+  EXPECT_FALSE(result.graph->hasNode("o5"_id));
+
+  // the input graph is left untouched (including the segment edges)
+  EXPECT_TRUE(graph().hasNode("o5"_id));
+  EXPECT_EQ(graph().getLayer(DsgLayers::SEGMENTS).numEdges(), 0u);
+  EXPECT_EQ(result.graph->getLayer(DsgLayers::SEGMENTS).numEdges(), 0u);
+}
+
+TEST_F(BatchClusteringTests, PrunesObjectsBelowThreshold) {
+  addSegment(0, -1.0, 1.0, 1);
+  addSegment(1, 0.5, 1.5, 0);
+
+  // merging both segments gives a score of ~0.7 against either task
+  config.selector.max_delta = 1.0;
+  config.prune_threshold = 0.9;
+  const auto result = clusterSegments(graph(), tasks, metric, config);
+  EXPECT_EQ(result.num_clusters, 1u);
+  EXPECT_EQ(result.num_objects, 0u);
+  EXPECT_EQ(result.graph->getLayer(DsgLayers::OBJECTS).numNodes(), 0u);
+}
+
+TEST_F(BatchClusteringTests, PartitionMatchesFullClustering) {
+  for (size_t i = 0; i < 12; ++i) {
+    // groups of three overlapping segments separated by gaps
+    const double min = 3.0 * (i / 3) + 0.6 * (i % 3);
+    addSegment(i, min, min + 1.0, (i % 4 == 0) ? 0 : 1);
+  }
+
+  const auto full = clusterSegments(graph(), tasks, metric, config);
+  config.partition = true;
+  const auto partitioned = clusterSegments(graph(), tasks, metric, config);
+  EXPECT_EQ(partitioned.stats.components_clustered, 4u);
+  EXPECT_EQ(partitioned.num_clusters, full.num_clusters);
+  EXPECT_EQ(getObjects(*partitioned.graph), getObjects(*full.graph));
+}
+
+TEST(FileEmbeddingGroup, LoadsTasks) {
+  const auto path = test::getTempPath("clio_task_embeddings.yaml");
+  {
+    std::ofstream file(path);
+    file << "names: [chair, table]\n"
+         << "embeddings:\n"
+         << "  - [1.0, 0.0, 0.0]\n"
+         << "  - [0.0, 0.5, 0.5]\n";
+  }
+
+  FileEmbeddingGroup::Config config;
+  config.path = path;
+  const FileEmbeddingGroup tasks(config);
+  ASSERT_EQ(tasks.embeddings.size(), 2u);
+  EXPECT_EQ(tasks.names, (std::vector<std::string>{"chair", "table"}));
+  EXPECT_NEAR(tasks.embeddings[1](2), 0.5, 1.0e-9);
+
+  {
+    std::ofstream file(path);
+    file << "names: [chair]\n"
+         << "embeddings:\n"
+         << "  - [1.0, 0.0, 0.0]\n"
+         << "  - [0.0, 0.5, 0.5]\n";
+  }
+
+  const FileEmbeddingGroup invalid(config);
+  EXPECT_TRUE(invalid.embeddings.empty());
+  std::filesystem::remove(path);
+}
+
+}  // namespace clio
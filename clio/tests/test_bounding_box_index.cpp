@@ -0,0 +1,97 @@
+#include <clio/bounding_box_index.h>
+#include <gtest/gtest.h>
+
+#include <limits>
+
+namespace clio {
+
+namespace {
+
+using Box = BoundingBoxIndex::Box;
+
+Box getRandomBox(float extent, float max_size) {
+  const Eigen::Vector3f min = extent * Eigen::Vector3f::Random();
+  const Eigen::Vector3f size =
+      max_size * (Eigen::Vector3f::Random() + Eigen::Vector3f::Ones()) / 2.0f;
+  return Box(min, min + size);
+}
+
+std::vector<NodeId> bruteForce(const BoundingBoxIndex& index, const Box& query) {
+  std::vector<NodeId> result;
+  for (const auto& [node, box] : index.boxes()) {
+    if (box.intersects(query)) {
+      result.push_back(node);
+    }
+  }
+
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+}  // namespace
+
+TEST(BoundingBoxIndex, QueryCorrect) {
+  BoundingBoxIndex index(1.0);
+  index.insert(0, Box(Eigen::Vector3f(0, 0, 0), Eigen::Vector3f(1, 1, 1)));
+  index.insert(1, Box(Eigen::Vector3f(0.5, 0.5, 0.5), Eigen::Vector3f(2, 2, 2)));
+  index.insert(2, Box(Eigen::Vector3f(3, 3, 3), Eigen::Vector3f(4, 4, 4)));
+  // touching boxes count as overlapping
+  index.insert(3, Box(Eigen::Vector3f(-1, 0, 0), Eigen::Vector3f(0, 1, 1)));
+
+  EXPECT_EQ(index.query(*index.getBox(0)), std::vector<NodeId>({0, 1, 3}));
+  EXPECT_EQ(index.query(*index.getBox(2)), std::vector<NodeId>({2}));
+  EXPECT_EQ(index.query(Box(Eigen::Vector3f(10, 10, 10), Eigen::Vector3f(11, 11, 11))),
+            std::vector<NodeId>());
+
+  // moving a box removes it from its old cells
+  index.insert(2, Box(Eigen::Vector3f(-0.5, -0.5, -0.5), Eigen::Vector3f(0, 0, 0)));
+  EXPECT_EQ(index.size(), 4u);
+  EXPECT_EQ(index.query(*index.getBox(0)), std::vector<NodeId>({0, 1, 2, 3}));
+  EXPECT_EQ(index.query(Box(Eigen::Vector3f(3, 3, 3), Eigen::Vector3f(4, 4, 4))),
+            std::vector<NodeId>());
+
+  EXPECT_TRUE(index.erase(1));
+  EXPECT_FALSE(index.erase(1));
+  EXPECT_EQ(index.getBox(1), nullptr);
+  EXPECT_EQ(index.query(*index.getBox(0)), std::vector<NodeId>({0, 2, 3}));
+}
+
+TEST(BoundingBoxIndex, OversizedBoxes) {
+  BoundingBoxIndex index(0.1, 8);
+  index.insert(0, Box(Eigen::Vector3f(0, 0, 0), Eigen::Vector3f(0.05, 0.05, 0.05)));
+  index.insert(1, Box(Eigen::Vector3f(-5, -5, -5), Eigen::Vector3f(5, 5, 5)));
+  const auto max = std::numeric_limits<float>::max();
+  index.insert(2, Box(Eigen::Vector3f::Constant(-max), Eigen::Vector3f::Constant(max)));
+
+  EXPECT_EQ(index.query(*index.getBox(0)), std::vector<NodeId>({0, 1, 2}));
+  EXPECT_EQ(index.query(*index.getBox(2)), std::vector<NodeId>({0, 1, 2}));
+  EXPECT_EQ(index.query(Box(Eigen::Vector3f(6, 6, 6), Eigen::Vector3f(7, 7, 7))),
+            std::vector<NodeId>({2}));
+
+  EXPECT_TRUE(index.erase(1));
+  EXPECT_EQ(index.query(*index.getBox(0)), std::vector<NodeId>({0, 2}));
+}
+
+TEST(BoundingBoxIndex, MatchesBruteForce) {
+  std::srand(12345);
+  BoundingBoxIndex index(0.5, 64);
+  for (size_t i = 0; i < 500; ++i) {
+    index.insert(i, getRandomBox(10.0f, i % 50 == 0 ? 8.0f : 1.0f));
+  }
+
+  // move and remove some boxes to exercise the incremental updates
+  for (size_t i = 0; i < 500; i += 7) {
+    index.insert(i, getRandomBox(10.0f, 1.0f));
+  }
+
+  for (size_t i = 0; i < 500; i += 11) {
+    index.erase(i);
+  }
+
+  for (size_t i = 0; i < 200; ++i) {
+    const auto query = getRandomBox(12.0f, i % 20 == 0 ? 20.0f : 2.0f);
+    EXPECT_EQ(index.query(query), bruteForce(index, query)) << "query " << i;
+  }
+}
+
+}  // namespace clio
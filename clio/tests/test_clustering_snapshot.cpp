@@ -0,0 +1,113 @@
+#include <clio/clustering_snapshot.h>
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+#include "clio_tests/utilities.h"
+
+namespace clio {
+
+TEST(ClusteringSnapshot, RoundTrip) {
+  ObjectClusteringSnapshot snapshot;
+  snapshot.task_fingerprint = 42;
+  snapshot.next_object_id = NodeSymbol('O', 7);
+  snapshot.components.push_back({{1, 2, 3}, {{100, {1, 2}}, {101, {3}}}});
+  snapshot.components.push_back({{4}, {}});
+  snapshot.previous_objects[102] = {5};
+  snapshot.ignored = {6};
+  snapshot.active = {100};
+  snapshot.stat_nodes = {1, 2, 3};
+  // odd number of floats so that the feature matrix needs padding
+  snapshot.features = Eigen::MatrixXf::Random(5, 3);
+  snapshot.py_x = Eigen::MatrixXd::Random(4, 3);
+  snapshot.information = Eigen::VectorXd::Random(3);
+
+  const auto path = test::getTempPath("clio_snapshot_round_trip.bin");
+  ASSERT_TRUE(snapshot.save(path));
+  const auto result = ObjectClusteringSnapshot::load(path);
+  ASSERT_TRUE(result);
+  EXPECT_EQ(result->task_fingerprint, snapshot.task_fingerprint);
+  EXPECT_EQ(result->next_object_id, snapshot.next_object_id);
+  ASSERT_EQ(result->components.size(), 2u);
+  EXPECT_EQ(result->components[0].segments, snapshot.components[0].segments);
+  EXPECT_EQ(result->components[0].objects, snapshot.components[0].objects);
+  EXPECT_EQ(result->components[1].segments, snapshot.components[1].segments);
+  EXPECT_TRUE(result->components[1].objects.empty());
+  EXPECT_EQ(result->previous_objects, snapshot.previous_objects);
+  EXPECT_EQ(result->ignored, snapshot.ignored);
+  EXPECT_EQ(result->active, snapshot.active);
+  EXPECT_EQ(result->stat_nodes, snapshot.stat_nodes);
+  EXPECT_EQ(result->features, snapshot.features);
+  EXPECT_EQ(result->py_x, snapshot.py_x);
+  EXPECT_EQ(result->information, snapshot.information);
+  std::filesystem::remove(path);
+}
+
+TEST(ClusteringSnapshot, RejectsInvalidFiles) {
+  const auto missing = test::getTempPath("clio_missing_snapshot.bin");
+  EXPECT_FALSE(ObjectClusteringSnapshot::load(missing));
+
+  ObjectClusteringSnapshot snapshot;
+  snapshot.components.push_back({{1, 2}, {{100, {1, 2}}}});
+  const auto path = test::getTempPath("clio_snapshot_truncated.bin");
+  ASSERT_TRUE(snapshot.save(path));
+
+  std::string contents;
+  {
+    std::ifstream in(path, std::ios::binary);
+    contents.assign(std::istreambuf_iterator<char>(in), {});
+  }
+
+  // every prefix of the file is invalid
+  for (size_t size = 0; size < contents.size(); ++size) {
+    {
+      std::ofstream out(path, std::ios::binary | std::ios::trunc);
+      out.write(contents.data(), size);
+    }
+
+    EXPECT_FALSE(ObjectClusteringSnapshot::load(path)) << "size: " << size;
+  }
+
+  {  // other versions are rejected
+    contents[8] += 1;
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(contents.data(), contents.size());
+  }
+
+  EXPECT_FALSE(ObjectClusteringSnapshot::load(path));
+  std::filesystem::remove(path);
+}
+
+TEST(ClusteringSnapshot, SaveReplacesExistingFile) {
+  const auto path = test::getTempPath("clio_snapshot_replace.bin");
+  ObjectClusteringSnapshot snapshot;
+  snapshot.next_object_id = 1;
+  ASSERT_TRUE(snapshot.save(path));
+
+  snapshot.next_object_id = 2;
+  snapshot.ignored = {3, 4};
+  ASSERT_TRUE(snapshot.save(path));
+  const auto result = ObjectClusteringSnapshot::load(path);
+  ASSERT_TRUE(result);
+  EXPECT_EQ(result->next_object_id, 2u);
+  EXPECT_EQ(result->ignored, snapshot.ignored);
+
+  // the temporary file is moved over the snapshot
+  EXPECT_FALSE(std::filesystem::exists(path + ".tmp"));
+  std::filesystem::remove(path);
+}
+
+TEST(ClusteringSnapshot, TaskFingerprint) {
+  test::TestEmbeddingGroup::Config config;
+  config.num_embeddings = 2;
+  const test::TestEmbeddingGroup tasks(config);
+  const test::TestEmbeddingGroup same(config);
+  config.num_embeddings = 3;
+  const test::TestEmbeddingGroup other(config);
+  EXPECT_EQ(getTaskFingerprint(tasks), getTaskFingerprint(same));
+  EXPECT_NE(getTaskFingerprint(tasks), getTaskFingerprint(other));
+}
+
+}  // namespace clio
@@ -32,13 +32,17 @@ TEST(ClusteringWorkspace, InitCorrect) {
     EXPECT_EQ(ws.size(), 5);
     EXPECT_EQ(ws.featureDim(), 10);
     EXPECT_TRUE(ws.edges.empty());
+    EXPECT_EQ(ws.features.cols(), 5);
+    EXPECT_EQ(ws.features.col(3), map.at(6));
 
-    std::map<size_t, NodeId> expected_lookup{{0, 0}, {1, 2}, {2, 4}, {3, 6}, {4, 8}};
+    std::vector<NodeId> expected_lookup{0, 2, 4, 6, 8};
     EXPECT_EQ(ws.node_lookup, expected_lookup);
-    std::map<NodeId, size_t> expected_order{{0, 0}, {2, 1}, {4, 2}, {6, 3}, {8, 4}};
-    EXPECT_EQ(ws.order, expected_order);
+    for (size_t i = 0; i < expected_lookup.size(); ++i) {
+      EXPECT_EQ(ws.getIndex(expected_lookup[i]), i);
+    }
+    EXPECT_FALSE(ws.getIndex(1));
     std::vector<size_t> expected_assignments{0, 1, 2, 3, 4};
-    EXPECT_EQ(ws.assignments, expected_assignments);
+    EXPECT_EQ(ws.getAssignments(), expected_assignments);
   }
 
   for (size_t i = 0; i < 9; ++i) {
@@ -51,12 +55,14 @@ TEST(ClusteringWorkspace, InitCorrect) {
     EXPECT_EQ(ws.featureDim(), 10);
     EXPECT_TRUE(ws.edges.empty());
 
-    std::map<size_t, NodeId> expected_lookup{{0, 0}, {1, 2}, {2, 4}, {3, 6}, {4, 8}};
+    std::vector<NodeId> expected_lookup{0, 2, 4, 6, 8};
     EXPECT_EQ(ws.node_lookup, expected_lookup);
-    std::map<NodeId, size_t> expected_order{{0, 0}, {2, 1}, {4, 2}, {6, 3}, {8, 4}};
-    EXPECT_EQ(ws.order, expected_order);
+    for (size_t i = 0; i < expected_lookup.size(); ++i) {
+      EXPECT_EQ(ws.getIndex(expected_lookup[i]), i);
+    }
+    EXPECT_FALSE(ws.getIndex(1));
     std::vector<size_t> expected_assignments{0, 1, 2, 3, 4};
-    EXPECT_EQ(ws.assignments, expected_assignments);
+    EXPECT_EQ(ws.getAssignments(), expected_assignments);
   }
 
   for (size_t i = 0; i < 4; ++i) {
@@ -72,15 +78,84 @@ TEST(ClusteringWorkspace, InitCorrect) {
         {{0, 1}, 0.0}, {{1, 2}, 0.0}, {{2, 3}, 0.0}, {{3, 4}, 0.0}};
     EXPECT_EQ(ws.edges, expected_edges);
 
-    std::map<size_t, NodeId> expected_lookup{{0, 0}, {1, 2}, {2, 4}, {3, 6}, {4, 8}};
+    std::vector<NodeId> expected_lookup{0, 2, 4, 6, 8};
     EXPECT_EQ(ws.node_lookup, expected_lookup);
-    std::map<NodeId, size_t> expected_order{{0, 0}, {2, 1}, {4, 2}, {6, 3}, {8, 4}};
-    EXPECT_EQ(ws.order, expected_order);
+    for (size_t i = 0; i < expected_lookup.size(); ++i) {
+      EXPECT_EQ(ws.getIndex(expected_lookup[i]), i);
+    }
+    EXPECT_FALSE(ws.getIndex(1));
     std::vector<size_t> expected_assignments{0, 1, 2, 3, 4};
-    EXPECT_EQ(ws.assignments, expected_assignments);
+    EXPECT_EQ(ws.getAssignments(), expected_assignments);
   }
 }
 
+TEST(ClusteringWorkspace, InitFromFeaturesCorrect) {
+  IsolatedSceneGraphLayer layer(2);
+  for (size_t i = 0; i < 4; ++i) {
+    layer.emplaceNode(i, std::make_unique<NodeAttributes>());
+  }
+
+  layer.insertEdge(0, 3);
+  layer.insertEdge(1, 2);
+
+  // nodes out of order: workspace should still be in node ID order
+  const std::vector<NodeId> nodes{3, 0, 2, 1};
+  Eigen::MatrixXf features(10, 4);
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    features.col(i) = getOneHot(nodes[i], 10);
+  }
+
+  ClusteringWorkspace ws(layer, nodes, features);
+  EXPECT_EQ(ws.size(), 4);
+  EXPECT_EQ(ws.featureDim(), 10);
+  std::vector<NodeId> expected_lookup{0, 1, 2, 3};
+  EXPECT_EQ(ws.node_lookup, expected_lookup);
+  for (size_t i = 0; i < 4; ++i) {
+    EXPECT_EQ(ws.features.col(i), getOneHot(i, 10));
+    EXPECT_EQ(ws.getIndex(i), i);
+  }
+
+  std::map<EdgeKey, double> expected_edges{{{0, 3}, 0.0}, {{1, 2}, 0.0}};
+  EXPECT_EQ(ws.edges, expected_edges);
+}
+
+TEST(ClusteringWorkspace, ResetMatchesConstructor) {
+  IsolatedSceneGraphLayer layer(2);
+  for (size_t i = 0; i < 6; ++i) {
+    layer.emplaceNode(i, std::make_unique<NodeAttributes>());
+  }
+
+  for (size_t i = 0; i < 5; ++i) {
+    layer.insertEdge(i, i + 1);
+  }
+
+  const std::vector<NodeId> nodes{0, 1, 2, 3, 4, 5};
+  Eigen::MatrixXf features(10, 6);
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    features.col(i) = getOneHot(i, 10);
+  }
+
+  // merged workspace with more nodes than the next set
+  ClusteringWorkspace ws(layer, nodes, features);
+  ws.addMerge({0, 1});
+  ws.addMerge({0, 2});
+
+  const std::vector<NodeId> subset{4, 3, 5};
+  Eigen::MatrixXf subset_features(10, 3);
+  for (size_t i = 0; i < subset.size(); ++i) {
+    subset_features.col(i) = getOneHot(subset[i], 10);
+  }
+
+  ws.reset(layer, subset, subset_features);
+  const ClusteringWorkspace expected(layer, subset, subset_features);
+  EXPECT_EQ(ws.size(), 3);
+  EXPECT_EQ(ws.features, expected.features);
+  EXPECT_EQ(ws.node_lookup, expected.node_lookup);
+  EXPECT_EQ(ws.edges, expected.edges);
+  EXPECT_EQ(ws.parents, expected.parents);
+  EXPECT_EQ(ws.neighbors, expected.neighbors);
+}
+
 TEST(ClusteringWorkspace, MergeCorrect) {
   IsolatedSceneGraphLayer layer(2);
 
@@ -108,7 +183,7 @@ TEST(ClusteringWorkspace, MergeCorrect) {
   std::map<EdgeKey, double> expected_edges{{{0, 1}, 0.0}, {{1, 3}, 0.0}, {{3, 4}, 0.0}};
   EXPECT_EQ(ws.edges, expected_edges);
   std::vector<size_t> expected_assignments{0, 1, 1, 3, 4};
-  EXPECT_EQ(ws.assignments, expected_assignments);
+  EXPECT_EQ(ws.getAssignments(), expected_assignments);
 
   // note: edge keys are ordered
   updated_edges = ws.addMerge({4, 3});
@@ -119,7 +194,7 @@ TEST(ClusteringWorkspace, MergeCorrect) {
   expected_edges = {{{0, 1}, 0.0}, {{1, 3}, 0.0}};
   EXPECT_EQ(ws.edges, expected_edges);
   expected_assignments = {0, 1, 1, 3, 3};
-  EXPECT_EQ(ws.assignments, expected_assignments);
+  EXPECT_EQ(ws.getAssignments(), expected_assignments);
 
   updated_edges = ws.addMerge({0, 1});
   expected_updates = {{0, 3}};
@@ -129,7 +204,7 @@ TEST(ClusteringWorkspace, MergeCorrect) {
   expected_edges = {{{0, 3}, 0.0}};
   EXPECT_EQ(ws.edges, expected_edges);
   expected_assignments = {0, 0, 0, 3, 3};
-  EXPECT_EQ(ws.assignments, expected_assignments);
+  EXPECT_EQ(ws.getAssignments(), expected_assignments);
 
   // note: edge keys are ordered
   updated_edges = ws.addMerge({3, 0});
@@ -139,7 +214,49 @@ TEST(ClusteringWorkspace, MergeCorrect) {
   expected_edges = {};
   EXPECT_EQ(ws.edges, expected_edges);
   expected_assignments = {0, 0, 0, 0, 0};
-  EXPECT_EQ(ws.assignments, expected_assignments);
+  EXPECT_EQ(ws.getAssignments(), expected_assignments);
+}
+
+TEST(ClusteringWorkspace, MergeCycleCorrect) {
+  IsolatedSceneGraphLayer layer(2);
+
+  NodeEmbeddingMap map;
+  for (size_t i = 0; i < 4; ++i) {
+    layer.emplaceNode(i, std::make_unique<NodeAttributes>());
+    map[i] = getOneHot(i, 10);
+  }
+
+  // square with one diagonal
+  layer.insertEdge(0, 1);
+  layer.insertEdge(1, 2);
+  layer.insertEdge(2, 3);
+  layer.insertEdge(3, 0);
+  layer.insertEdge(0, 2);
+
+  ClusteringWorkspace ws(layer, map);
+
+  // 1 and 3 both neighbor 0 and 2: merged edges should collapse
+  auto updated_edges = ws.addMerge({0, 2});
+  std::list<EdgeKey> expected_updates{{0, 1}, {0, 3}};
+  EXPECT_EQ(updated_edges, expected_updates);
+  std::map<EdgeKey, double> expected_edges{{{0, 1}, 0.0}, {{0, 3}, 0.0}};
+  EXPECT_EQ(ws.edges, expected_edges);
+  std::vector<std::vector<size_t>> expected_neighbors{{1, 3}, {0}, {}, {0}};
+  EXPECT_EQ(ws.neighbors, expected_neighbors);
+
+  updated_edges = ws.addMerge({1, 0});
+  expected_updates = {{0, 3}};
+  EXPECT_EQ(updated_edges, expected_updates);
+
+  updated_edges = ws.addMerge({0, 3});
+  EXPECT_TRUE(updated_edges.empty());
+  EXPECT_TRUE(ws.edges.empty());
+
+  std::vector<size_t> expected_assignments{0, 0, 0, 0};
+  EXPECT_EQ(ws.getAssignments(), expected_assignments);
+  EXPECT_EQ(ws.findRoot(2), 0);
+  const std::vector<std::vector<NodeId>> expected_clusters{{0, 1, 2, 3}};
+  EXPECT_EQ(ws.getClusters(), expected_clusters);
 }
 
 }  // namespace clio
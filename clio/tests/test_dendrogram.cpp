@@ -0,0 +1,99 @@
+#include <clio/agglomerative_clustering.h>
+#include <clio/dendrogram.h>
+#include <clio/ib_edge_selector.h>
+#include <gtest/gtest.h>
+
+#include "clio_tests/utilities.h"
+
+namespace clio {
+
+using namespace spark_dsg;
+
+namespace {
+
+const test::GridConfig kGrid{16, 20};
+
+}  // namespace
+
+TEST(Dendrogram, CutsAtFirstLargeDelta) {
+  Dendrogram dendrogram;
+  dendrogram.reset({10, 11, 12, 13});
+  dendrogram.addMerge(EdgeKey(0, 1), 0.1);
+  dendrogram.addMerge(EdgeKey(2, 3), 0.05);
+  dendrogram.addMerge(EdgeKey(0, 2), 0.3);
+
+  EXPECT_EQ(dendrogram.numMerges(0.01), 0u);
+  // clustering stops at the first merge that reaches the threshold
+  EXPECT_EQ(dendrogram.numMerges(0.08), 0u);
+  EXPECT_EQ(dendrogram.numMerges(0.1), 0u);
+  EXPECT_EQ(dendrogram.numMerges(0.2), 2u);
+  EXPECT_EQ(dendrogram.numMerges(1.0), 3u);
+
+  using Clusters = std::vector<std::vector<NodeId>>;
+  EXPECT_EQ(dendrogram.getClusters(0.01), (Clusters{{10}, {11}, {12}, {13}}));
+  EXPECT_EQ(dendrogram.getClusters(0.2), (Clusters{{10, 11}, {12, 13}}));
+  EXPECT_EQ(dendrogram.getClusters(1.0), (Clusters{{10, 11, 12, 13}}));
+  EXPECT_EQ(dendrogram.getAssignments(0.2), (std::vector<size_t>{0, 0, 2, 2}));
+}
+
+TEST(Dendrogram, MatchesClusteringAtEachThreshold) {
+  test::GridFixture fixture(8, 3, 4321, kGrid);
+  Dendrogram dendrogram;
+  {
+    ClusteringWorkspace ws(fixture.layer, fixture.embeddings);
+    IBEdgeSelector selector(fixture.config);
+    const auto stats = clusterAgglomerative(ws,
+                                            fixture.tasks,
+                                            selector,
+                                            fixture.metric,
+                                            false,
+                                            -1,
+                                            1,
+                                            5,
+                                            {},
+                                            nullptr,
+                                            &dendrogram);
+
+    // the grid is connected, so clustering runs until a single cluster is left
+    EXPECT_EQ(dendrogram.size(), 64u);
+    EXPECT_EQ(dendrogram.merges().size(), 63u);
+    EXPECT_EQ(stats.merges, 63u);
+    EXPECT_EQ(ws.getClusters().size(), 1u);
+  }
+
+  for (const double max_delta : {1.0e-4, 1.0e-3, 1.0e-2, 5.0e-2, 0.2, 1.0}) {
+    auto config = fixture.config;
+    config.max_delta = max_delta;
+    ClusteringWorkspace ws(fixture.layer, fixture.embeddings);
+    IBEdgeSelector selector(config);
+    const auto stats =
+        clusterAgglomerative(ws, fixture.tasks, selector, fixture.metric);
+    EXPECT_EQ(stats.merges, dendrogram.numMerges(max_delta)) << "delta: " << max_delta;
+    EXPECT_EQ(ws.getClusters(), dendrogram.getClusters(max_delta))
+        << "delta: " << max_delta;
+  }
+}
+
+TEST(Dendrogram, AgglomerativeClusteringCut) {
+  test::GridFixture fixture(6, 2, 1234, kGrid);
+  std::map<NodeId, Eigen::VectorXf> embeddings;
+  for (const auto& [node_id, feature] : fixture.embeddings) {
+    embeddings[node_id] = feature.head(10);
+  }
+
+  AgglomerativeClustering::Config config;
+  config.tasks = test::TestEmbeddingGroup::getDefault(3);
+  config.selector.max_delta = 0.01;
+  const AgglomerativeClustering clustering(config);
+
+  const auto expected = clustering.cluster(fixture.layer, embeddings);
+  const auto dendrogram = clustering.buildDendrogram(fixture.layer, embeddings);
+  const auto result = clustering.getClusters(dendrogram, 0.01, embeddings);
+  ASSERT_EQ(result.size(), expected.size());
+  for (size_t i = 0; i < result.size(); ++i) {
+    EXPECT_EQ(result[i]->nodes, expected[i]->nodes);
+    EXPECT_EQ(result[i]->best_task_index, expected[i]->best_task_index);
+  }
+}
+
+}  // namespace clio
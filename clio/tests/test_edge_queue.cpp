@@ -0,0 +1,149 @@
+#include <clio/agglomerative_clustering.h>
+#include <clio/clustering_workspace.h>
+#include <clio/edge_queue.h>
+#include <clio/ib_edge_selector.h>
+#include <gtest/gtest.h>
+
+namespace clio {
+
+using namespace spark_dsg;
+
+namespace {
+
+inline Eigen::VectorXf getOneHot(size_t i, size_t dim) {
+  Eigen::VectorXf p = Eigen::VectorXf::Zero(dim);
+  p(i) = 1.0f;
+  return p;
+}
+
+struct ChainFixture {
+  explicit ChainFixture(size_t num_nodes) : layer(2) {
+    for (size_t i = 0; i < num_nodes; ++i) {
+      layer.emplaceNode(i, std::make_unique<NodeAttributes>());
+      embeddings[i] = getOneHot(i % 10, 10);
+    }
+
+    for (size_t i = 0; i + 1 < num_nodes; ++i) {
+      layer.insertEdge(i, i + 1);
+    }
+  }
+
+  IsolatedSceneGraphLayer layer;
+  ClusteringWorkspace::NodeEmbeddings embeddings;
+};
+
+}  // namespace
+
+TEST(EdgeQueue, TopMatchesScan) {
+  ChainFixture fixture(5);
+  IBEdgeSelector selector({});
+
+  ClusteringWorkspace linear_ws(fixture.layer, fixture.embeddings);
+  ClusteringWorkspace heap_ws(fixture.layer, fixture.embeddings);
+  LinearEdgeQueue linear(linear_ws, selector);
+  HeapEdgeQueue heap(heap_ws, selector);
+
+  // includes a tie between (0, 1) and (2, 3)
+  const std::map<EdgeKey, double> scores{
+      {{0, 1}, 0.3}, {{1, 2}, 0.5}, {{2, 3}, 0.3}, {{3, 4}, 0.4}};
+  for (auto&& [edge, score] : scores) {
+    linear.update(edge, score);
+    heap.update(edge, score);
+  }
+
+  auto linear_best = linear.top();
+  auto heap_best = heap.top();
+  ASSERT_TRUE(linear_best);
+  ASSERT_TRUE(heap_best);
+  EXPECT_EQ(linear_best->first, EdgeKey(0, 1));
+  EXPECT_EQ(heap_best->first, EdgeKey(0, 1));
+  EXPECT_EQ(heap_best->second, 0.3);
+
+  // rescoring an edge invalidates the old entry
+  linear.update({0, 1}, 0.6);
+  heap.update({0, 1}, 0.6);
+  linear_best = linear.top();
+  heap_best = heap.top();
+  ASSERT_TRUE(linear_best);
+  ASSERT_TRUE(heap_best);
+  EXPECT_EQ(linear_best->first, EdgeKey(2, 3));
+  EXPECT_EQ(heap_best->first, EdgeKey(2, 3));
+  EXPECT_EQ(heap.score({0, 1}), 0.6);
+
+  // merged edges disappear from the queue
+  for (const auto edge : heap_ws.addMerge({2, 3})) {
+    heap.update(edge, 0.1);
+  }
+
+  heap_best = heap.top();
+  ASSERT_TRUE(heap_best);
+  EXPECT_EQ(heap_best->first, EdgeKey(1, 2));
+  EXPECT_EQ(heap_best->second, 0.1);
+  EXPECT_FALSE(heap.score({2, 3}));
+}
+
+TEST(EdgeQueue, EmptyQueue) {
+  ChainFixture fixture(1);
+  IBEdgeSelector selector({});
+
+  ClusteringWorkspace ws(fixture.layer, fixture.embeddings);
+  LinearEdgeQueue linear(ws, selector);
+  HeapEdgeQueue heap(ws, selector);
+  EXPECT_FALSE(linear.top());
+  EXPECT_FALSE(heap.top());
+}
+
+TEST(EdgeQueue, HeapStaysCompact) {
+  ChainFixture fixture(10);
+  IBEdgeSelector selector({});
+
+  ClusteringWorkspace ws(fixture.layer, fixture.embeddings);
+  HeapEdgeQueue heap(ws, selector);
+  for (size_t i = 0; i < 1000; ++i) {
+    heap.update({0, 1}, static_cast<double>(i));
+  }
+
+  EXPECT_LE(heap.heapSize(), 2 * ws.edges.size() + 16);
+  const auto best = heap.top();
+  ASSERT_TRUE(best);
+  EXPECT_EQ(best->first, EdgeKey(0, 1));
+  EXPECT_EQ(best->second, 999.0);
+}
+
+TEST(EdgeQueue, ClusteringMatchesScan) {
+  ChainFixture fixture(20);
+  for (size_t i = 0; i < 20; ++i) {
+    // two groups of similar nodes
+    fixture.embeddings[i] =
+        getOneHot(i < 10 ? 0 : 1, 10) + 0.1f * getOneHot(i % 10, 10);
+  }
+
+  hydra::EmbeddingGroup tasks;
+  for (size_t i = 0; i < 3; ++i) {
+    tasks.embeddings.push_back(getOneHot(i, 10));
+    tasks.names.push_back(std::to_string(i));
+  }
+
+  hydra::CosineDistance metric;
+  IBEdgeSelector::Config config;
+  config.max_delta = 0.1;
+
+  AgglomerationConfig linear_config;
+  linear_config.use_edge_queue = false;
+  ClusteringWorkspace linear_ws(fixture.layer, fixture.embeddings);
+  IBEdgeSelector linear_selector(config);
+  clusterAgglomerative(
+      linear_ws, tasks, linear_selector, metric, false, -1, 1, 5, linear_config);
+
+  AgglomerationConfig heap_config;
+  heap_config.use_edge_queue = true;
+  ClusteringWorkspace heap_ws(fixture.layer, fixture.embeddings);
+  IBEdgeSelector heap_selector(config);
+  clusterAgglomerative(
+      heap_ws, tasks, heap_selector, metric, false, -1, 1, 5, heap_config);
+
+  EXPECT_EQ(linear_ws.getClusters(), heap_ws.getClusters());
+  EXPECT_EQ(linear_selector.summarize(), heap_selector.summarize());
+}
+
+}  // namespace clio
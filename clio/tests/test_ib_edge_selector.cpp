@@ -2,6 +2,7 @@
 #include <clio/embedding_distances.h>
 #include <clio/ib_edge_selector.h>
 #include <clio/ib_utils.h>
+#include <clio/probability_utilities.h>
 #include <gtest/gtest.h>
 
 namespace clio {
@@ -10,12 +11,12 @@ struct TestableIBEdgeSelector : public IBEdgeSelector {
   explicit TestableIBEdgeSelector(const IBEdgeSelector::Config& config)
       : IBEdgeSelector(config) {}
 
+  using IBEdgeSelector::I_zy_prev_;
   using IBEdgeSelector::px_;
   using IBEdgeSelector::py_;
   using IBEdgeSelector::py_x_;
   using IBEdgeSelector::py_z_;
   using IBEdgeSelector::pz_;
-  using IBEdgeSelector::pz_x_;
 };
 
 namespace {
@@ -66,8 +67,10 @@ TEST(IBEdgeSelector, SetupSimpleCorrect) {
   ASSERT_EQ(selector.px_.rows(), 5);
   ASSERT_EQ(selector.pz_.rows(), 5);
   ASSERT_EQ(selector.py_.rows(), 4);
-  ASSERT_EQ(selector.pz_x_.rows(), 5);
-  ASSERT_EQ(selector.pz_x_.cols(), 5);
+  const auto pz_x = selector.getPzGivenX();
+  ASSERT_EQ(pz_x.rows(), 5);
+  ASSERT_EQ(pz_x.cols(), 5);
+  EXPECT_EQ(pz_x.nonZeros(), 5);
   ASSERT_EQ(selector.py_x_.rows(), 4);
   ASSERT_EQ(selector.py_x_.cols(), 5);
   ASSERT_EQ(selector.py_z_.rows(), 4);
@@ -276,9 +279,10 @@ TEST(IBEdgeSelector, UpdateCorrect) {
   // check that hard-cluster assumptions hold
   EXPECT_EQ(selector.pz_(1), 0.0);
   EXPECT_EQ(selector.pz_(0), 0.4);
-  EXPECT_EQ(selector.pz_x_(1, 1), 0.0);
-  EXPECT_EQ(selector.pz_x_(0, 0), 1.0);
-  EXPECT_EQ(selector.pz_x_(1, 0), 1.0) << "p(z|x): " << selector.pz_x_.format(fmt);
+  const Eigen::MatrixXd pz_x = selector.getPzGivenX();
+  EXPECT_EQ(pz_x(1, 1), 0.0);
+  EXPECT_EQ(pz_x(0, 0), 1.0);
+  EXPECT_EQ(pz_x(1, 0), 1.0) << "p(z|x): " << pz_x.format(fmt);
 
   Eigen::VectorXd py_0(4);
   py_0 << 0.5, 0.25, 0.25, 0.0;
@@ -290,6 +294,47 @@ TEST(IBEdgeSelector, UpdateCorrect) {
       << "p(y|z=1): " << selector.py_z_.col(1).format(fmt);
 }
 
+TEST(IBEdgeSelector, IncrementalMutualInformationCorrect) {
+  IsolatedSceneGraphLayer layer(2);
+
+  NodeEmbeddingMap x_segments;
+  for (size_t i = 0; i < 8; ++i) {
+    layer.emplaceNode(i, std::make_unique<NodeAttributes>());
+    x_segments[i] = getOneHot(i % 4, 10) + 0.5 * getOneHot((i + 1) % 4, 10);
+  }
+
+  for (size_t i = 0; i < 7; ++i) {
+    layer.insertEdge(i, i + 1);
+  }
+
+  EmbeddingGroup y_tasks;
+  for (size_t i = 0; i < 4; ++i) {
+    y_tasks.embeddings.push_back(getOneHot(i, 10));
+    y_tasks.tasks.push_back(std::to_string(i));
+  }
+
+  ClusteringWorkspace ws(layer, x_segments);
+  CosineDistance dist;
+
+  IBEdgeSelector::Config config;
+  config.max_delta = 1.0;
+  config.mi_refresh_interval = 0;
+  TestableIBEdgeSelector selector(config);
+  selector.setup(ws, y_tasks, dist);
+  EXPECT_NEAR(selector.I_zy_prev_,
+              mutualInformation(selector.py_, selector.pz_, selector.py_z_),
+              1.0e-12);
+
+  for (const auto edge : std::vector<EdgeKey>{{0, 1}, {2, 3}, {0, 2}, {5, 6}}) {
+    selector.updateFromEdge(edge);
+    ws.addMerge(edge);
+    EXPECT_NEAR(selector.I_zy_prev_,
+                mutualInformation(selector.py_, selector.pz_, selector.py_z_),
+                1.0e-12)
+        << "after merging " << edge;
+  }
+}
+
 TEST(IBEdgeSelector, CompareEdgesCorrect) {
   IBEdgeSelector::Config config;
   TestableIBEdgeSelector selector(config);
@@ -0,0 +1,169 @@
+#include <clio/clustering_workspace.h>
+#include <clio/ib_utils.h>
+#include <gtest/gtest.h>
+
+#include <numeric>
+
+namespace clio {
+
+using namespace spark_dsg;
+
+namespace {
+
+struct NegativeL2Distance : public hydra::EmbeddingDistance {
+  double dist(const Eigen::VectorXf& lhs, const Eigen::VectorXf& rhs) const override {
+    return (lhs - rhs).norm();
+  }
+
+  double score(const Eigen::VectorXf& lhs, const Eigen::VectorXf& rhs) const override {
+    return -dist(lhs, rhs);
+  }
+};
+
+struct WrappedCosineDistance : public hydra::EmbeddingDistance {
+  double dist(const Eigen::VectorXf& lhs, const Eigen::VectorXf& rhs) const override {
+    return cosine.dist(lhs, rhs);
+  }
+
+  double score(const Eigen::VectorXf& lhs, const Eigen::VectorXf& rhs) const override {
+    return cosine.score(lhs, rhs);
+  }
+
+  hydra::CosineDistance cosine;
+};
+
+struct RandomFixture {
+  RandomFixture(size_t num_nodes, size_t num_tasks, size_t dim) : layer(2) {
+    std::srand(12345);
+    for (size_t i = 0; i < num_nodes; ++i) {
+      layer.emplaceNode(i, std::make_unique<NodeAttributes>());
+      embeddings[i] = Eigen::VectorXf::Random(dim);
+    }
+
+    for (size_t i = 0; i + 1 < num_nodes; ++i) {
+      layer.insertEdge(i, i + 1);
+    }
+
+    for (size_t i = 0; i < num_tasks; ++i) {
+      tasks.embeddings.push_back(Eigen::VectorXf::Random(dim));
+      tasks.names.push_back(std::to_string(i));
+    }
+  }
+
+  IsolatedSceneGraphLayer layer;
+  ClusteringWorkspace::NodeEmbeddings embeddings;
+  hydra::EmbeddingGroup tasks;
+};
+
+// previous implementation: repeated full sorts of every column
+Eigen::MatrixXd referencePyGivenX(const Eigen::MatrixXf& scores,
+                                  const PyGivenXConfig& config) {
+  const size_t M = scores.rows() + 1;
+  const size_t N = scores.cols();
+  Eigen::MatrixXd py_x = Eigen::MatrixXd::Ones(M, N) * 1e-12;
+  Eigen::MatrixXd py_x_temp = Eigen::MatrixXd::Zero(M, N);
+  py_x_temp.row(0).setConstant(config.score_threshold);
+  py_x_temp.bottomRows(M - 1) = scores.cast<double>();
+
+  const auto top_k = [&](size_t c, size_t k) {
+    std::vector<size_t> idx(M);
+    std::iota(idx.begin(), idx.end(), 0);
+    std::stable_sort(idx.begin(), idx.end(), [&](auto lhs, auto rhs) {
+      return py_x_temp(lhs, c) > py_x_temp(rhs, c);
+    });
+    idx.resize(k);
+    return idx;
+  };
+
+  const size_t k = std::min(M, config.top_k);
+  for (size_t l = config.cumulative ? 1 : k; l <= k; ++l) {
+    for (size_t c = 0; c < N; ++c) {
+      for (const auto idx : top_k(c, l)) {
+        py_x(idx, c) = py_x(idx, c) + py_x_temp(idx, c);
+      }
+    }
+  }
+
+  if (config.null_task_preprune) {
+    for (size_t c = 0; c < N; ++c) {
+      if (top_k(c, 1).front() == 0) {
+        py_x.block(1, c, M - 1, 1).setConstant(1e-12);
+      }
+    }
+  }
+
+  const auto norm_factor = py_x.colwise().sum();
+  py_x.array().rowwise() /= norm_factor.array();
+  return py_x;
+}
+
+}  // namespace
+
+TEST(IBUtilities, PyGivenXMatchesFullSort) {
+  RandomFixture fixture(30, 200, 16);
+  ClusteringWorkspace ws(fixture.layer, fixture.embeddings);
+  hydra::CosineDistance metric;
+  const auto scores = computeTaskScores(ws, fixture.tasks, metric);
+
+  for (const bool cumulative : {true, false}) {
+    for (const bool preprune : {true, false}) {
+      for (const size_t top_k : {1, 3, 500}) {
+        PyGivenXConfig config;
+        config.score_threshold = 0.3;
+        config.cumulative = cumulative;
+        config.null_task_preprune = preprune;
+        config.top_k = top_k;
+        const auto py_x = computeIBpyGivenX(ws, fixture.tasks, metric, config);
+        const auto expected = referencePyGivenX(scores, config);
+        EXPECT_EQ(py_x, expected) << "cumulative: " << cumulative
+                                  << ", preprune: " << preprune << ", k: " << top_k;
+      }
+    }
+  }
+}
+
+TEST(IBUtilities, BatchedScoresMatchPerNode) {
+  RandomFixture fixture(50, 30, 64);
+  // zero-norm features are left to the metric
+  fixture.embeddings[7] = Eigen::VectorXf::Zero(64);
+  ClusteringWorkspace ws(fixture.layer, fixture.embeddings);
+
+  hydra::CosineDistance metric;
+  const auto batched = computeTaskScores(ws, fixture.tasks, metric, true);
+  const auto expected = computeTaskScores(ws, fixture.tasks, metric, false);
+  ASSERT_EQ(batched.rows(), 30);
+  ASSERT_EQ(batched.cols(), 50);
+  EXPECT_LE((batched - expected).cwiseAbs().maxCoeff(), kBatchScoreTolerance);
+  EXPECT_EQ(batched.col(7), expected.col(7));
+}
+
+TEST(IBUtilities, PyGivenXMatchesPerNode) {
+  RandomFixture fixture(40, 20, 32);
+  ClusteringWorkspace ws(fixture.layer, fixture.embeddings);
+
+  PyGivenXConfig config;
+  config.score_threshold = 0.1;
+  hydra::CosineDistance metric;
+  const auto py_x = computeIBpyGivenX(ws, fixture.tasks, metric, config);
+  // same scores, but not a CosineDistance so always scored per-node
+  WrappedCosineDistance wrapped;
+  const auto expected = computeIBpyGivenX(ws, fixture.tasks, wrapped, config);
+  ASSERT_EQ(py_x.rows(), expected.rows());
+  ASSERT_EQ(py_x.cols(), expected.cols());
+  EXPECT_LE((py_x - expected).cwiseAbs().maxCoeff(), 1.0e-5);
+}
+
+TEST(IBUtilities, OtherMetricsUsePerNode) {
+  RandomFixture fixture(10, 5, 8);
+  ClusteringWorkspace ws(fixture.layer, fixture.embeddings);
+
+  NegativeL2Distance metric;
+  const auto scores = computeTaskScores(ws, fixture.tasks, metric);
+  for (size_t i = 0; i < ws.size(); ++i) {
+    const Eigen::VectorXf expected =
+        fixture.tasks.getScores(metric, ws.features.col(i));
+    EXPECT_EQ(scores.col(i), expected);
+  }
+}
+
+}  // namespace clio
@@ -0,0 +1,227 @@
+#include <clio/agglomerative_clustering.h>
+#include <clio/clustering_workspace.h>
+#include <clio/edge_queue.h>
+#include <clio/ib_edge_selector.h>
+#include <clio/merge_scheduler.h>
+#include <clio/thread_pool.h>
+#include <gtest/gtest.h>
+
+#include "clio_tests/utilities.h"
+
+namespace clio {
+
+using namespace spark_dsg;
+
+namespace {
+
+// clustering stops before the grid collapses into a single cluster
+const test::GridConfig kGrid{32, 50, 0.05};
+
+// fraction of node pairs that both partitions agree on (Rand index)
+double getPairAgreement(const std::vector<std::vector<NodeId>>& lhs,
+                        const std::vector<std::vector<NodeId>>& rhs) {
+  std::map<NodeId, size_t> lhs_labels;
+  std::map<NodeId, size_t> rhs_labels;
+  for (size_t i = 0; i < lhs.size(); ++i) {
+    for (const auto node : lhs[i]) {
+      lhs_labels[node] = i;
+    }
+  }
+
+  for (size_t i = 0; i < rhs.size(); ++i) {
+    for (const auto node : rhs[i]) {
+      rhs_labels[node] = i;
+    }
+  }
+
+  size_t num_pairs = 0;
+  size_t num_agree = 0;
+  for (auto i = lhs_labels.begin(); i != lhs_labels.end(); ++i) {
+    for (auto j = std::next(i); j != lhs_labels.end(); ++j) {
+      const bool lhs_same = i->second == j->second;
+      const bool rhs_same = rhs_labels.at(i->first) == rhs_labels.at(j->first);
+      num_agree += lhs_same == rhs_same ? 1 : 0;
+      ++num_pairs;
+    }
+  }
+
+  return num_pairs ? static_cast<double>(num_agree) / num_pairs : 1.0;
+}
+
+}  // namespace
+
+TEST(MergeScheduler, BatchIsDisjointAndNonAdjacent) {
+  test::GridFixture fixture(8, 2, 12345, kGrid);
+  ClusteringWorkspace ws(fixture.layer, fixture.embeddings);
+  IBEdgeSelector selector(fixture.config);
+  selector.setup(ws, fixture.tasks, fixture.metric);
+  HeapEdgeQueue queue(ws, selector);
+  for (const auto& edge_weight : ws.edges) {
+    queue.update(edge_weight.first, selector.scoreEdge(edge_weight.first));
+  }
+
+  const auto batch = BatchMergeScheduler::getBatch(ws, selector, queue);
+  ASSERT_GT(batch.size(), 1u);
+  // the best edge always starts the batch
+  EXPECT_EQ(batch.front(), queue.top()->first);
+
+  std::set<size_t> clusters;
+  for (size_t i = 0; i < batch.size(); ++i) {
+    EXPECT_TRUE(clusters.insert(batch[i].k1).second);
+    EXPECT_TRUE(clusters.insert(batch[i].k2).second);
+    if (i > 0) {
+      EXPECT_LE(*queue.score(batch[i - 1]), *queue.score(batch[i]));
+    }
+  }
+
+  for (const auto& edge : batch) {
+    for (const auto cluster : {edge.k1, edge.k2}) {
+      for (const auto neighbor : ws.neighbors[cluster]) {
+        if (neighbor != edge.k1 && neighbor != edge.k2) {
+          EXPECT_FALSE(clusters.count(neighbor)) << edge << " -> " << neighbor;
+        }
+      }
+    }
+  }
+}
+
+TEST(MergeScheduler, RollbackRestoresSelector) {
+  test::GridFixture fixture(4, 2, 12345, kGrid);
+  for (const bool sparse : {false, true}) {
+    for (const bool single_precision : {false, true}) {
+      auto config = fixture.config;
+      config.sparse = sparse;
+      config.single_precision = single_precision;
+      ClusteringWorkspace ws(fixture.layer, fixture.embeddings);
+      IBEdgeSelector selector(config);
+      selector.setup(ws, fixture.tasks, fixture.metric);
+
+      std::map<EdgeKey, double> expected;
+      for (const auto& edge_weight : ws.edges) {
+        expected[edge_weight.first] = selector.scoreEdge(edge_weight.first);
+      }
+
+      const auto summary = selector.summarize();
+      ASSERT_TRUE(selector.checkpoint());
+      // a chain of merges that reuses merged clusters
+      selector.updateFromEdge({0, 1});
+      selector.updateFromEdge({0, 4});
+      selector.updateFromEdge({2, 3});
+      selector.rollback();
+
+      EXPECT_EQ(selector.summarize(), summary);
+      for (const auto& [edge, score] : expected) {
+        EXPECT_EQ(selector.scoreEdge(edge), score)
+            << "sparse: " << sparse << ", float: " << single_precision;
+      }
+
+      // committed merges stay
+      ASSERT_TRUE(selector.checkpoint());
+      selector.updateFromEdge({0, 1});
+      selector.commit();
+      selector.rollback();
+      EXPECT_NE(selector.summarize(), summary);
+    }
+  }
+}
+
+TEST(MergeScheduler, BatchMatchesSequentialQuality) {
+  for (const unsigned seed : {1u, 2u, 3u}) {
+    test::GridFixture fixture(12, 3, seed, kGrid);
+
+    AgglomerationConfig sequential_config;
+    ClusteringWorkspace sequential_ws(fixture.layer, fixture.embeddings);
+    IBEdgeSelector sequential_selector(fixture.config);
+    const auto sequential_stats = clusterAgglomerative(sequential_ws,
+                                                       fixture.tasks,
+                                                       sequential_selector,
+                                                       fixture.metric,
+                                                       false,
+                                                       -1,
+                                                       1,
+                                                       5,
+                                                       sequential_config);
+
+    AgglomerationConfig batch_config;
+    batch_config.batch_merges = true;
+    ClusteringWorkspace batch_ws(fixture.layer, fixture.embeddings);
+    IBEdgeSelector batch_selector(fixture.config);
+    const auto batch_stats = clusterAgglomerative(batch_ws,
+                                                  fixture.tasks,
+                                                  batch_selector,
+                                                  fixture.metric,
+                                                  false,
+                                                  -1,
+                                                  1,
+                                                  5,
+                                                  batch_config);
+
+    const auto expected = sequential_ws.getClusters();
+    const auto result = batch_ws.getClusters();
+    ASSERT_GT(expected.size(), 1u) << "seed: " << seed;
+    EXPECT_EQ(sequential_stats.rounds, sequential_stats.merges);
+    EXPECT_LT(batch_stats.rounds, sequential_stats.rounds / 2) << "seed: " << seed;
+    EXPECT_EQ(batch_stats.merges, batch_ws.size() - result.size());
+
+    const auto num_expected = static_cast<int>(expected.size());
+    const auto num_result = static_cast<int>(result.size());
+    EXPECT_LE(std::abs(num_expected - num_result), 2) << "seed: " << seed;
+    // batches commit to pairs before merged clusters can grow, so boundaries shift
+    EXPECT_GE(getPairAgreement(expected, result), 0.85) << "seed: " << seed;
+  }
+}
+
+TEST(MergeScheduler, ParallelScoringMatchesSerial) {
+  test::GridFixture fixture(10, 3, 12345, kGrid);
+  ThreadPool pool(4);
+
+  ClusteringWorkspace ws(fixture.layer, fixture.embeddings);
+  IBEdgeSelector selector(fixture.config);
+  selector.setup(ws, fixture.tasks, fixture.metric);
+  std::vector<EdgeKey> edges;
+  for (const auto& edge_weight : ws.edges) {
+    edges.push_back(edge_weight.first);
+  }
+
+  const auto expected = scoreEdges(selector, edges);
+  ASSERT_EQ(expected.size(), edges.size());
+  for (const size_t grain_size : {1, 7, 1000}) {
+    EXPECT_EQ(scoreEdges(selector, edges, &pool, grain_size), expected);
+  }
+
+  for (const bool batch_merges : {false, true}) {
+    AgglomerationConfig config;
+    config.batch_merges = batch_merges;
+    config.scoring_grain_size = 3;
+
+    ClusteringWorkspace serial_ws(fixture.layer, fixture.embeddings);
+    IBEdgeSelector serial_selector(fixture.config);
+    clusterAgglomerative(serial_ws,
+                         fixture.tasks,
+                         serial_selector,
+                         fixture.metric,
+                         false,
+                         -1,
+                         1,
+                         5,
+                         config);
+
+    ClusteringWorkspace parallel_ws(fixture.layer, fixture.embeddings);
+    IBEdgeSelector parallel_selector(fixture.config);
+    clusterAgglomerative(parallel_ws,
+                         fixture.tasks,
+                         parallel_selector,
+                         fixture.metric,
+                         false,
+                         -1,
+                         1,
+                         5,
+                         config,
+                         &pool);
+
+    EXPECT_EQ(serial_ws.getClusters(), parallel_ws.getClusters());
+    EXPECT_EQ(serial_selector.summarize(), parallel_selector.summarize());
+  }
+}
+
+}  // namespace clio
@@ -0,0 +1,127 @@
+#include <clio/clustering_workspace.h>
+#include <clio/ib_utils.h>
+#include <clio/node_statistics_cache.h>
+#include <clio/probability_utilities.h>
+#include <gtest/gtest.h>
+
+namespace clio {
+
+using namespace spark_dsg;
+
+namespace {
+
+struct LayerFixture {
+  LayerFixture(size_t num_nodes, size_t num_tasks, size_t dim) : layer(2), dim(dim) {
+    std::srand(12345);
+    for (size_t i = 0; i < num_nodes; ++i) {
+      addNode(i);
+    }
+
+    for (size_t i = 0; i < num_tasks; ++i) {
+      tasks.embeddings.push_back(Eigen::VectorXf::Random(dim));
+      tasks.names.push_back(std::to_string(i));
+    }
+  }
+
+  void addNode(NodeId node_id) {
+    auto attrs = std::make_unique<SemanticNodeAttributes>();
+    attrs->semantic_feature = Eigen::MatrixXf::Random(dim, 3);
+    attrs->is_active = false;
+    layer.emplaceNode(node_id, std::move(attrs));
+  }
+
+  SemanticNodeAttributes& getAttrs(NodeId node_id) {
+    return layer.getNode(node_id).attributes<SemanticNodeAttributes>();
+  }
+
+  size_t update(NodeStatisticsCache& cache) {
+    embeddings.update(layer);
+    return cache.update(embeddings, tasks, metric);
+  }
+
+  double getExpected() const {
+    const ClusteringWorkspace ws(layer);
+    const auto py_x = computeIBpyGivenX(ws, tasks, metric, config);
+    return mutualInformation(computeIBpy(tasks), computeIBpx(ws), py_x);
+  }
+
+  IsolatedSceneGraphLayer layer;
+  const size_t dim;
+  PooledEmbeddingCache embeddings;
+  hydra::EmbeddingGroup tasks;
+  hydra::CosineDistance metric;
+  PyGivenXConfig config;
+};
+
+}  // namespace
+
+TEST(NodeStatisticsCache, MatchesFullComputation) {
+  LayerFixture fixture(30, 10, 16);
+  NodeStatisticsCache cache(fixture.config);
+  EXPECT_EQ(cache.mutualInformation(), 0.0);
+
+  EXPECT_EQ(fixture.update(cache), 30u);
+  EXPECT_EQ(cache.size(), 30u);
+  EXPECT_NEAR(cache.mutualInformation(), fixture.getExpected(), 1.0e-9);
+
+  // nothing changed
+  EXPECT_EQ(fixture.update(cache), 0u);
+
+  // new, removed and modified nodes
+  fixture.addNode(30);
+  fixture.addNode(31);
+  fixture.layer.removeNode(3);
+  auto& attrs = fixture.getAttrs(5);
+  attrs.is_active = true;
+  attrs.semantic_feature = Eigen::MatrixXf::Random(16, 2);
+  // active but unchanged
+  fixture.getAttrs(6).is_active = true;
+
+  EXPECT_EQ(fixture.update(cache), 3u);
+  EXPECT_EQ(cache.size(), 31u);
+  EXPECT_EQ(cache.getEntry(3), nullptr);
+  ASSERT_NE(cache.getEntry(5), nullptr);
+  const Eigen::VectorXf expected_feature = attrs.semantic_feature.rowwise().mean();
+  EXPECT_EQ(cache.getEntry(5)->feature, expected_feature);
+  EXPECT_NEAR(cache.mutualInformation(), fixture.getExpected(), 1.0e-9);
+}
+
+TEST(NodeStatisticsCache, ManyUpdatesStayAccurate) {
+  LayerFixture fixture(20, 5, 8);
+  NodeStatisticsCache cache(fixture.config);
+  fixture.update(cache);
+
+  for (size_t i = 0; i < 200; ++i) {
+    auto& attrs = fixture.getAttrs(i % 20);
+    attrs.is_active = true;
+    attrs.semantic_feature = Eigen::MatrixXf::Random(8, 3);
+    EXPECT_EQ(fixture.update(cache), 1u);
+    attrs.is_active = false;
+  }
+
+  EXPECT_NEAR(cache.mutualInformation(), fixture.getExpected(), 1.0e-9);
+  EXPECT_TRUE(cache.erase(0));
+  EXPECT_FALSE(cache.erase(0));
+  EXPECT_EQ(cache.size(), 19u);
+}
+
+TEST(NodeStatisticsCache, ClearRescoresWithNewTasks) {
+  LayerFixture fixture(10, 5, 8);
+  NodeStatisticsCache cache(fixture.config);
+  fixture.update(cache);
+
+  // entries are kept until the owner clears them
+  fixture.tasks.embeddings.push_back(Eigen::VectorXf::Random(8));
+  fixture.tasks.names.push_back("new");
+  EXPECT_EQ(fixture.update(cache), 0u);
+  EXPECT_EQ(cache.getEntry(0)->py_x.rows(), 6);
+
+  cache.clear();
+  EXPECT_EQ(cache.mutualInformation(), 0.0);
+  EXPECT_EQ(fixture.update(cache), 10u);
+  EXPECT_EQ(cache.getEntry(0)->py_x.rows(), 7);
+  EXPECT_NEAR(cache.mutualInformation(), fixture.getExpected(), 1.0e-9);
+  EXPECT_EQ(fixture.update(cache), 0u);
+}
+
+}  // namespace clio
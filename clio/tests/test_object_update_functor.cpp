@@ -1,6 +1,8 @@
 #include <clio/object_update_functor.h>
 #include <gtest/gtest.h>
 
+#include <filesystem>
+
 #include "clio_tests/utilities.h"
 
 namespace clio {
@@ -25,6 +27,47 @@ TEST(IntersectionPolicy, TestOverlap) {
   EXPECT_TRUE(checker(attrs1, attrs2));
 }
 
+TEST(ObjectAttributes, MergeMeshes) {
+  std::vector<KhronosObjectAttributes> attrs(3);
+  std::vector<Eigen::Vector3f> expected;
+  for (size_t i = 0; i < attrs.size(); ++i) {
+    auto& mesh = attrs[i].mesh;
+    attrs[i].bounding_box = BoundingBox(Eigen::Vector3f(i, 0.0f, 0.0f),
+                                        Eigen::Vector3f(i + 1.5f, 1.0f, 1.0f));
+    mesh.resizeVertices(3);
+    for (size_t v = 0; v < 3; ++v) {
+      mesh.setPos(v, Eigen::Vector3f(0.1f * v, 0.2f, -0.1f * i));
+      expected.push_back(attrs[i].bounding_box.pointToWorldFrame(mesh.pos(v)));
+    }
+
+    mesh.faces.push_back({0, 1, 2});
+  }
+
+  KhronosObjectAttributes merged = attrs[0];
+  mergeObjectAttributes({&attrs[1], &attrs[2]}, merged);
+  ASSERT_EQ(merged.mesh.numVertices(), 9u);
+  ASSERT_EQ(merged.mesh.faces.size(), 3u);
+  for (size_t v = 0; v < 9; ++v) {
+    const auto world_pos = merged.bounding_box.pointToWorldFrame(merged.mesh.pos(v));
+    EXPECT_NEAR((world_pos - expected[v]).norm(), 0.0, 1.0e-5) << "vertex " << v;
+  }
+
+  for (size_t f = 0; f < 3; ++f) {
+    const spark_dsg::Mesh::Face face{3 * f, 3 * f + 1, 3 * f + 2};
+    EXPECT_EQ(merged.mesh.faces[f], face);
+  }
+
+  // merging one object at a time gives the same mesh
+  KhronosObjectAttributes pairwise = attrs[0];
+  mergeObjectAttributes(attrs[1], pairwise);
+  mergeObjectAttributes(attrs[2], pairwise);
+  ASSERT_EQ(pairwise.mesh.numVertices(), 9u);
+  EXPECT_EQ(pairwise.mesh.faces, merged.mesh.faces);
+  for (size_t v = 0; v < 9; ++v) {
+    EXPECT_NEAR((pairwise.mesh.pos(v) - merged.mesh.pos(v)).norm(), 0.0, 1.0e-5);
+  }
+}
+
 struct ObjectUpdateFunctorTests : public ::testing::Test {
   ObjectUpdateFunctorTests()
       : graph_info({{DsgLayers::SEGMENTS, 's'},
@@ -39,16 +82,7 @@ struct ObjectUpdateFunctorTests : public ::testing::Test {
                   double min,
                   double max,
                   std::optional<size_t> onehot_index = std::nullopt) {
-    auto attrs = std::make_unique<KhronosObjectAttributes>();
-    attrs->position << (min + max) / 2.0, 0.0, 0.0;
-
-    Eigen::Vector3f x_min(min, -1.0, -1.0);
-    Eigen::Vector3f x_max(max, 1.0, 1.0);
-    attrs->bounding_box = BoundingBox(x_min, x_max);
-    attrs->semantic_feature =
-        test::TestEmbeddingGroup::getEmbedding(onehot_index.value_or(index));
-
-    graph().emplaceNode(DsgLayers::SEGMENTS, NodeSymbol('s', index), std::move(attrs));
+    test::addSegment(graph(), index, min, max, onehot_index);
   }
 
   DynamicSceneGraph& graph() { return *graph_info.graph; }
@@ -77,4 +111,278 @@ TEST_F(ObjectUpdateFunctorTests, AddEdges) {
   EXPECT_TRUE(graph().hasEdge("s3"_id, "s2"_id));
 }
 
+TEST_F(ObjectUpdateFunctorTests, AddEdgesIndexMatchesPairwise) {
+  config.segment_index_resolution = 0.0;
+  ObjectUpdateFunctor pairwise(config);
+  config.segment_index_resolution = 0.25;
+  ObjectUpdateFunctor indexed(config);
+
+  for (size_t i = 0; i < 20; ++i) {
+    const double min = 0.3 * i;
+    addSegment(i, min, min + (i % 3 == 0 ? 2.0 : 0.4), i % 2);
+  }
+
+  const auto pairwise_active = pairwise.addSegmentEdges(graph());
+  std::set<EdgeKey> expected;
+  for (const auto& [key, edge] : graph().getLayer(DsgLayers::SEGMENTS).edges()) {
+    expected.insert(key);
+  }
+
+  for (const auto& key : expected) {
+    graph().removeEdge(key.k1, key.k2);
+  }
+
+  const auto indexed_active = indexed.addSegmentEdges(graph());
+  std::set<EdgeKey> result;
+  for (const auto& [key, edge] : graph().getLayer(DsgLayers::SEGMENTS).edges()) {
+    result.insert(key);
+  }
+
+  EXPECT_FALSE(expected.empty());
+  EXPECT_EQ(result, expected);
+  EXPECT_EQ(indexed_active, pairwise_active);
+}
+
+TEST_F(ObjectUpdateFunctorTests, AddEdgesReindexesChangedSegments) {
+  ObjectUpdateFunctor functor(config);
+  addSegment(0, -1.0, 1.0, 1);
+  addSegment(1, 2.0, 3.0, 1);
+  functor.addSegmentEdges(graph());
+  EXPECT_FALSE(graph().hasEdge("s0"_id, "s1"_id));
+
+  // a segment that grows keeps its update time, so only the box change is detected
+  auto& attrs = graph().getNode("s1"_id).attributes<KhronosObjectAttributes>();
+  attrs.bounding_box = BoundingBox(Eigen::Vector3f(0.5, -1.0, -1.0),
+                                   Eigen::Vector3f(3.0, 1.0, 1.0));
+  functor.addSegmentEdges(graph());
+  EXPECT_TRUE(graph().hasEdge("s0"_id, "s1"_id));
+}
+
+TEST_F(ObjectUpdateFunctorTests, ReconcileExtendsObjects) {
+  for (const bool reconcile : {true, false}) {
+    graph().clear();
+    config.reconcile_objects = reconcile;
+    ObjectUpdateFunctor functor(config);
+    const auto update = [&]() {
+      const auto active = functor.addSegmentEdges(graph());
+      functor.clearActiveComponents(graph(), active);
+      functor.detectObjects(graph());
+    };
+
+    addSegment(0, -1.0, 1.0, 1);
+    addSegment(1, 0.5, 1.5, 1);
+    update();
+    ASSERT_EQ(graph().getLayer(DsgLayers::OBJECTS).numNodes(), 1u);
+    const auto object_id = graph().getLayer(DsgLayers::OBJECTS).nodes().begin()->first;
+
+    // new segment that joins the existing component
+    addSegment(2, 1.2, 2.0, 1);
+    update();
+    ASSERT_EQ(graph().getLayer(DsgLayers::OBJECTS).numNodes(), 1u);
+    const auto new_id = graph().getLayer(DsgLayers::OBJECTS).nodes().begin()->first;
+    EXPECT_EQ(new_id == object_id, reconcile);
+
+    const auto& attrs = graph().getNode(new_id).attributes<KhronosObjectAttributes>();
+    EXPECT_NEAR(attrs.position.x(), (0.0 + 1.0 + 1.6) / 3.0, 1.0e-6);
+  }
+}
+
+TEST_F(ObjectUpdateFunctorTests, ReusesClearedComponents) {
+  ObjectUpdateFunctor functor(config);
+  const auto update = [&]() {
+    const auto active = functor.addSegmentEdges(graph());
+    functor.clearActiveComponents(graph(), active);
+    functor.detectObjects(graph());
+  };
+
+  addSegment(0, -1.0, 1.0, 1);
+  addSegment(1, 0.5, 1.5, 1);
+  update();
+  EXPECT_EQ(functor.stats().components_allocated, 1u);
+
+  // the component is cleared and re-clustered with the new segment
+  addSegment(2, 1.2, 2.0, 1);
+  functor.call(graph_info, {});
+  EXPECT_EQ(functor.stats().components_clustered, 1u);
+  EXPECT_EQ(functor.stats().components_allocated, 0u);
+  EXPECT_EQ(graph().getLayer(DsgLayers::OBJECTS).numNodes(), 1u);
+
+  // recycled components give the same objects as fresh components
+  const auto& objects = graph().getLayer(DsgLayers::OBJECTS);
+  const Eigen::Vector3d result =
+      objects.nodes().begin()->second->attributes().position;
+
+  graph().clear();
+  ObjectUpdateFunctor fresh(config);
+  addSegment(0, -1.0, 1.0, 1);
+  addSegment(1, 0.5, 1.5, 1);
+  addSegment(2, 1.2, 2.0, 1);
+  fresh.call(graph_info, {});
+  EXPECT_EQ(fresh.stats().components_allocated, 1u);
+  const auto& expected = graph().getLayer(DsgLayers::OBJECTS);
+  ASSERT_EQ(expected.numNodes(), 1u);
+  EXPECT_NEAR((expected.nodes().begin()->second->attributes().position - result).norm(),
+              0.0,
+              1.0e-6);
+}
+
+TEST_F(ObjectUpdateFunctorTests, AsyncDiscardsStaleComponents) {
+  config.async = true;
+  // any running pass is overdue by the next call, which keeps the test deterministic
+  config.async_max_latency = 1.0e-9;
+  ObjectUpdateFunctor functor(config);
+
+  addSegment(0, -1.0, 1.0, 1);
+  addSegment(1, 0.5, 1.5, 1);
+  functor.call(graph_info, {});
+  EXPECT_EQ(graph().getLayer(DsgLayers::OBJECTS).numNodes(), 0u);
+
+  // a new segment joins the component while it is being clustered, so the first
+  // pass is discarded and every segment goes to the next pass
+  addSegment(2, 1.2, 2.0, 1);
+  functor.call(graph_info, {});
+  EXPECT_EQ(functor.stats().components_clustered, 0u);
+  EXPECT_EQ(graph().getLayer(DsgLayers::OBJECTS).numNodes(), 0u);
+
+  EXPECT_EQ(functor.applyClustering(graph(), true), 1u);
+  const auto& objects = graph().getLayer(DsgLayers::OBJECTS);
+  ASSERT_EQ(objects.numNodes(), 1u);
+  const auto& attrs =
+      objects.nodes().begin()->second->attributes<KhronosObjectAttributes>();
+  EXPECT_NEAR(attrs.position.x(), (0.0 + 1.0 + 1.6) / 3.0, 1.0e-6);
+
+  // nothing left to cluster
+  functor.call(graph_info, {});
+  EXPECT_FALSE(functor.launchClustering(graph()));
+  EXPECT_EQ(functor.applyClustering(graph(), true), 0u);
+  EXPECT_EQ(objects.numNodes(), 1u);
+}
+
+TEST_F(ObjectUpdateFunctorTests, TaskSwapRescoresClusteredSegments) {
+  ObjectUpdateFunctor functor(config);
+  addSegment(0, -1.0, 1.0, 1);
+  addSegment(1, 0.5, 1.5, 1);
+  addSegment(2, 3.0, 4.0, 0);
+  functor.call(graph_info, {});
+  ASSERT_EQ(graph().getLayer(DsgLayers::OBJECTS).numNodes(), 2u);
+
+  // the first two segments are already clustered, but no longer match any task
+  test::TestEmbeddingGroup::Config tasks_config;
+  tasks_config.num_embeddings = 1;
+  functor.setTasks(std::make_shared<test::TestEmbeddingGroup>(tasks_config));
+  functor.call(graph_info, {});
+  EXPECT_EQ(functor.stats().components_clustered, 1u);
+  EXPECT_EQ(graph().getLayer(DsgLayers::OBJECTS).numNodes(), 1u);
+
+  const auto snapshot = functor.getSnapshot();
+  EXPECT_EQ(snapshot.ignored, (std::vector<NodeId>{"s0"_id, "s1"_id}));
+  ASSERT_EQ(snapshot.components.size(), 1u);
+  EXPECT_EQ(snapshot.components[0].segments, std::vector<NodeId>{"s2"_id});
+}
+
+TEST_F(ObjectUpdateFunctorTests, RestoreKeepsObjects) {
+  addSegment(0, -1.0, 1.0, 1);
+  addSegment(1, 0.5, 1.5, 1);
+  addSegment(2, 2.0, 3.0, 0);
+
+  ObjectClusteringSnapshot snapshot;
+  std::set<NodeId> expected;
+  {
+    ObjectUpdateFunctor functor(config);
+    functor.call(graph_info, {});
+    for (const auto& id_node_pair : graph().getLayer(DsgLayers::OBJECTS).nodes()) {
+      expected.insert(id_node_pair.first);
+    }
+
+    snapshot = functor.getSnapshot();
+  }
+
+  ASSERT_FALSE(expected.empty());
+  ObjectUpdateFunctor restored(config);
+  restored.restoreSnapshot(snapshot);
+
+  // nothing changed since the snapshot, so nothing is clustered again
+  restored.call(graph_info, {});
+  EXPECT_EQ(restored.stats().components_clustered, 0u);
+  std::set<NodeId> result;
+  for (const auto& id_node_pair : graph().getLayer(DsgLayers::OBJECTS).nodes()) {
+    result.insert(id_node_pair.first);
+  }
+
+  EXPECT_EQ(result, expected);
+
+  // new objects continue the previous IDs
+  addSegment(3, 5.0, 6.0, 1);
+  restored.call(graph_info, {});
+  EXPECT_EQ(restored.stats().components_clustered, 1u);
+  const auto& objects = graph().getLayer(DsgLayers::OBJECTS);
+  ASSERT_EQ(objects.numNodes(), expected.size() + 1);
+  EXPECT_GT(objects.nodes().rbegin()->first, *expected.rbegin());
+}
+
+TEST_F(ObjectUpdateFunctorTests, CallSavesStatePeriodically) {
+  const auto path = test::getTempPath("clio_object_state_periodic.bin");
+  std::filesystem::remove(path);
+  config.state_path = path;
+  config.state_save_interval = 2;
+  addSegment(0, -1.0, 1.0, 1);
+  addSegment(1, 0.5, 1.5, 1);
+
+  {  // functors also write the state on destruction, so they are scoped
+    ObjectUpdateFunctor functor(config);
+    functor.call(graph_info, {});
+    EXPECT_FALSE(std::filesystem::exists(path));
+
+    // the state is written by the functor while it is still alive
+    addSegment(2, 3.0, 4.0, 0);
+    functor.call(graph_info, {});
+    const auto saved = ObjectClusteringSnapshot::load(path);
+    ASSERT_TRUE(saved);
+
+    const auto expected = functor.getSnapshot();
+    EXPECT_EQ(saved->next_object_id, expected.next_object_id);
+    EXPECT_EQ(saved->active, expected.active);
+    EXPECT_EQ(saved->ignored, expected.ignored);
+    ASSERT_EQ(saved->components.size(), expected.components.size());
+    for (size_t i = 0; i < expected.components.size(); ++i) {
+      EXPECT_EQ(saved->components[i].segments, expected.components[i].segments);
+      EXPECT_EQ(saved->components[i].objects, expected.components[i].objects);
+    }
+
+    // a functor restored from the file picks up the objects without re-clustering
+    ObjectUpdateFunctor restored(config);
+    restored.call(graph_info, {});
+    EXPECT_EQ(restored.stats().components_clustered, 0u);
+  }
+
+  std::filesystem::remove(path);
+}
+
+TEST_F(ObjectUpdateFunctorTests, RestoreWithOtherTasksRescoresSegments) {
+  addSegment(0, -1.0, 1.0, 1);
+  addSegment(1, 0.5, 1.5, 1);
+  addSegment(2, 3.0, 4.0, 0);
+
+  ObjectClusteringSnapshot snapshot;
+  {
+    ObjectUpdateFunctor functor(config);
+    functor.call(graph_info, {});
+    ASSERT_EQ(graph().getLayer(DsgLayers::OBJECTS).numNodes(), 2u);
+    snapshot = functor.getSnapshot();
+  }
+
+  // the first two segments were clustered, but don't match the new tasks
+  config.tasks = test::TestEmbeddingGroup::getDefault(1);
+  ObjectUpdateFunctor restored(config);
+  restored.restoreSnapshot(snapshot);
+  restored.call(graph_info, {});
+  EXPECT_EQ(restored.stats().components_clustered, 1u);
+  EXPECT_EQ(graph().getLayer(DsgLayers::OBJECTS).numNodes(), 1u);
+
+  const auto result = restored.getSnapshot();
+  EXPECT_EQ(result.ignored, (std::vector<NodeId>{"s0"_id, "s1"_id}));
+  ASSERT_EQ(result.components.size(), 1u);
+  EXPECT_EQ(result.components[0].segments, std::vector<NodeId>{"s2"_id});
+}
+
 }  // namespace clio
@@ -0,0 +1,136 @@
+#include <clio/agglomerative_clustering.h>
+#include <clio/clustering_workspace.h>
+#include <clio/ib_edge_selector.h>
+#include <clio/online_clustering.h>
+#include <gtest/gtest.h>
+
+namespace clio {
+
+using namespace spark_dsg;
+
+namespace {
+
+inline Eigen::VectorXf getOneHot(size_t i, size_t dim) {
+  Eigen::VectorXf p = Eigen::VectorXf::Zero(dim);
+  p(i) = 1.0f;
+  return p;
+}
+
+// chain of nodes in two groups of similar features
+inline Eigen::VectorXf getFeature(size_t i) {
+  return getOneHot(i < 10 ? 0 : 1, 10) + 0.1f * getOneHot(i % 10, 10);
+}
+
+struct OnlineFixture {
+  OnlineFixture() {
+    for (size_t i = 0; i < 3; ++i) {
+      tasks.embeddings.push_back(getOneHot(i, 10));
+      tasks.names.push_back(std::to_string(i));
+    }
+
+    config.selector.max_delta = 0.1;
+  }
+
+  hydra::EmbeddingGroup tasks;
+  hydra::CosineDistance metric;
+  OnlineClustering::Config config;
+};
+
+}  // namespace
+
+TEST(OnlineClustering, StreamingMatchesBatch) {
+  OnlineFixture fixture;
+  OnlineClustering online(fixture.config, fixture.tasks, fixture.metric);
+
+  IsolatedSceneGraphLayer layer(2);
+  ClusteringWorkspace::NodeEmbeddings embeddings;
+  for (size_t i = 0; i < 20; ++i) {
+    layer.emplaceNode(i, std::make_unique<NodeAttributes>());
+    embeddings[i] = getFeature(i);
+    EXPECT_TRUE(online.addNode(i, embeddings[i]));
+    if (i > 0) {
+      layer.insertEdge(i - 1, i);
+      EXPECT_TRUE(online.addEdge(i - 1, i));
+    }
+
+    online.update();
+  }
+
+  ClusteringWorkspace ws(layer, embeddings);
+  IBEdgeSelector selector(fixture.config.selector);
+  clusterAgglomerative(ws, fixture.tasks, selector, fixture.metric);
+
+  const std::vector<std::vector<NodeId>> expected{
+      {0, 1, 2, 3, 4, 5, 6, 7, 8, 9}, {10, 11, 12, 13, 14, 15, 16, 17, 18, 19}};
+  EXPECT_EQ(ws.getClusters(), expected);
+  EXPECT_EQ(online.getClusters(), expected);
+  EXPECT_EQ(online.numNodes(), 20u);
+  EXPECT_EQ(online.getCluster(5), online.getCluster(0));
+  EXPECT_NE(online.getCluster(10), online.getCluster(0));
+}
+
+TEST(OnlineClustering, InvalidChanges) {
+  OnlineFixture fixture;
+  OnlineClustering online(fixture.config, fixture.tasks, fixture.metric);
+  EXPECT_TRUE(online.addNode(0, getFeature(0)));
+  EXPECT_FALSE(online.addNode(0, getFeature(0)));
+  EXPECT_FALSE(online.addEdge(0, 0));
+  EXPECT_FALSE(online.addEdge(0, 1));
+  EXPECT_FALSE(online.removeEdge(0, 1));
+  EXPECT_FALSE(online.removeNode(1));
+  EXPECT_EQ(online.update(), 0u);
+  EXPECT_EQ(online.numClusters(), 1u);
+}
+
+TEST(OnlineClustering, RemovalsSplitClusters) {
+  OnlineFixture fixture;
+  OnlineClustering online(fixture.config, fixture.tasks, fixture.metric);
+  for (size_t i = 0; i < 10; ++i) {
+    online.addNode(i, getFeature(i));
+    if (i > 0) {
+      online.addEdge(i - 1, i);
+    }
+  }
+
+  EXPECT_EQ(online.update(), 9u);
+  EXPECT_EQ(online.numClusters(), 1u);
+
+  // removing the middle of the chain disconnects the cluster
+  EXPECT_TRUE(online.removeNode(4));
+  EXPECT_EQ(online.numClusters(), 9u);
+  online.update();
+  std::vector<std::vector<NodeId>> expected{{0, 1, 2, 3}, {5, 6, 7, 8, 9}};
+  EXPECT_EQ(online.getClusters(), expected);
+
+  EXPECT_TRUE(online.removeEdge(6, 7));
+  online.update();
+  expected = {{0, 1, 2, 3}, {5, 6}, {7, 8, 9}};
+  EXPECT_EQ(online.getClusters(), expected);
+
+  // reconnecting only merges the clusters that were touched
+  EXPECT_TRUE(online.addEdge(3, 5));
+  EXPECT_TRUE(online.addEdge(6, 7));
+  EXPECT_EQ(online.update(), 2u);
+  expected = {{0, 1, 2, 3, 5, 6, 7, 8, 9}};
+  EXPECT_EQ(online.getClusters(), expected);
+}
+
+TEST(OnlineClustering, DissimilarNodesStaySeparate) {
+  OnlineFixture fixture;
+  OnlineClustering online(fixture.config, fixture.tasks, fixture.metric);
+  for (size_t i = 0; i < 10; ++i) {
+    online.addNode(2 * i, getFeature(0));
+    online.addNode(2 * i + 1, getFeature(10));
+    online.addEdge(2 * i, 2 * i + 1);
+    if (i > 0) {
+      online.addEdge(2 * i - 2, 2 * i);
+    }
+
+    online.update();
+  }
+
+  EXPECT_EQ(online.numClusters(), 11u);
+  EXPECT_GT(online.mutualInformation(), 0.0);
+}
+
+}  // namespace clio
@@ -0,0 +1,176 @@
+#include <clio/node_statistics_cache.h>
+#include <clio/pooled_embedding_cache.h>
+#include <gtest/gtest.h>
+
+namespace clio {
+
+using namespace spark_dsg;
+
+namespace {
+
+struct LayerFixture {
+  LayerFixture(size_t num_nodes, size_t dim) : layer(2), dim(dim) {
+    std::srand(12345);
+    for (size_t i = 0; i < num_nodes; ++i) {
+      addNode(i, i + 1);
+    }
+  }
+
+  void addNode(NodeId node_id, size_t num_views) {
+    auto attrs = std::make_unique<SemanticNodeAttributes>();
+    attrs->semantic_feature = Eigen::MatrixXf::Random(dim, num_views);
+    attrs->is_active = false;
+    layer.emplaceNode(node_id, std::move(attrs));
+  }
+
+  SemanticNodeAttributes& getAttrs(NodeId node_id) {
+    return layer.getNode(node_id).attributes<SemanticNodeAttributes>();
+  }
+
+  IsolatedSceneGraphLayer layer;
+  const size_t dim;
+};
+
+PooledEmbeddingCache::Config getConfig(const std::string& pooling,
+                                       bool weight_by_views = false) {
+  PooledEmbeddingCache::Config config;
+  config.pooling = pooling;
+  config.weight_by_views = weight_by_views;
+  return config;
+}
+
+}  // namespace
+
+TEST(PooledEmbeddingCache, PoolingOperations) {
+  LayerFixture fixture(5, 8);
+  for (const auto& pooling : {"mean", "max", "last"}) {
+    PooledEmbeddingCache cache(getConfig(pooling));
+    EXPECT_EQ(cache.update(fixture.layer), 5u);
+    for (size_t i = 0; i < 5; ++i) {
+      const auto& views = fixture.getAttrs(i).semantic_feature;
+      Eigen::VectorXf expected;
+      if (std::string(pooling) == "max") {
+        expected = views.rowwise().maxCoeff();
+      } else if (std::string(pooling) == "last") {
+        expected = views.rightCols<1>();
+      } else {
+        expected = views.rowwise().mean();
+      }
+
+      const auto entry = cache.getEntry(i);
+      ASSERT_NE(entry, nullptr);
+      EXPECT_EQ(entry->feature, expected) << "pooling: " << pooling;
+      EXPECT_EQ(entry->num_views, i + 1);
+    }
+  }
+}
+
+TEST(PooledEmbeddingCache, OnlyChangedNodesPooled) {
+  LayerFixture fixture(10, 8);
+  PooledEmbeddingCache cache;
+  EXPECT_EQ(cache.update(fixture.layer), 10u);
+  // archived nodes are only pooled once
+  EXPECT_EQ(cache.update(fixture.layer), 0u);
+
+  fixture.addNode(10, 2);
+  fixture.layer.removeNode(3);
+  auto& attrs = fixture.getAttrs(5);
+  attrs.is_active = true;
+  attrs.semantic_feature = Eigen::MatrixXf::Random(8, 4);
+  EXPECT_EQ(cache.update(fixture.layer), 2u);
+  EXPECT_EQ(cache.size(), 10u);
+  EXPECT_EQ(cache.getEntry(3), nullptr);
+  const Eigen::VectorXf expected = attrs.semantic_feature.rowwise().mean();
+  EXPECT_EQ(cache.getFeature(5), expected);
+  EXPECT_EQ(cache.getEntry(5)->num_views, 4u);
+
+  // erasing forces the node to be pooled again
+  EXPECT_TRUE(cache.erase(0));
+  EXPECT_FALSE(cache.erase(0));
+  EXPECT_EQ(cache.update(fixture.layer), 2u);
+
+  // nodes without features are not cached
+  fixture.getAttrs(5).semantic_feature.resize(0, 0);
+  EXPECT_EQ(cache.update(fixture.layer), 0u);
+  EXPECT_EQ(cache.getEntry(5), nullptr);
+}
+
+TEST(PooledEmbeddingCache, AddMissingKeepsCachedNodes) {
+  LayerFixture fixture(4, 8);
+  PooledEmbeddingCache cache;
+  EXPECT_EQ(cache.addMissing(fixture.layer), 4u);
+  EXPECT_EQ(cache.addMissing(fixture.layer), 0u);
+
+  // only the new node is pooled, even though another node changed
+  fixture.addNode(4, 2);
+  auto& attrs = fixture.getAttrs(1);
+  attrs.is_active = true;
+  const Eigen::VectorXf prev = cache.getFeature(1);
+  attrs.semantic_feature = Eigen::MatrixXf::Random(8, 3);
+  EXPECT_EQ(cache.addMissing(fixture.layer), 1u);
+  EXPECT_EQ(cache.size(), 5u);
+  EXPECT_EQ(cache.getFeature(1), prev);
+
+  // nodes without features are skipped
+  fixture.addNode(5, 0);
+  EXPECT_EQ(cache.addMissing(fixture.layer), 0u);
+  EXPECT_EQ(cache.getEntry(5), nullptr);
+}
+
+TEST(PooledEmbeddingCache, CombineWeights) {
+  LayerFixture fixture(3, 4);
+  const std::vector<NodeId> nodes{0, 2};
+
+  PooledEmbeddingCache uniform;
+  uniform.update(fixture.layer);
+  const Eigen::VectorXf expected_uniform =
+      (uniform.getFeature(0) + uniform.getFeature(2)) / 2.0f;
+  EXPECT_TRUE(uniform.combine(nodes).isApprox(expected_uniform));
+
+  // weighted by views, the mean of pooled features is the mean over every view
+  PooledEmbeddingCache weighted(getConfig("mean", true));
+  weighted.update(fixture.layer);
+  Eigen::MatrixXf views(4, 4);
+  views << fixture.getAttrs(0).semantic_feature, fixture.getAttrs(2).semantic_feature;
+  const Eigen::VectorXf expected_weighted = views.rowwise().mean();
+  EXPECT_TRUE(weighted.combine(nodes).isApprox(expected_weighted));
+
+  const auto features = weighted.getFeatures(nodes);
+  ASSERT_EQ(features.cols(), 2);
+  EXPECT_EQ(features.col(1), weighted.getFeature(2));
+}
+
+TEST(PooledEmbeddingCache, StatisticsMatchRebuild) {
+  LayerFixture fixture(20, 16);
+  hydra::EmbeddingGroup tasks;
+  for (size_t i = 0; i < 5; ++i) {
+    tasks.embeddings.push_back(Eigen::VectorXf::Random(16));
+    tasks.names.push_back(std::to_string(i));
+  }
+
+  hydra::CosineDistance metric;
+  PyGivenXConfig config;
+  NodeStatisticsCache stats(config);
+  PooledEmbeddingCache embeddings;
+  const auto getExpected = [&]() {
+    NodeStatisticsCache expected(config);
+    expected.update(embeddings, tasks, metric);
+    return expected.mutualInformation();
+  };
+
+  embeddings.update(fixture.layer);
+  EXPECT_EQ(stats.update(embeddings, tasks, metric), 20u);
+  EXPECT_EQ(stats.update(embeddings, tasks, metric), 0u);
+  EXPECT_NEAR(stats.mutualInformation(), getExpected(), 1.0e-12);
+
+  fixture.layer.removeNode(4);
+  auto& attrs = fixture.getAttrs(7);
+  attrs.is_active = true;
+  attrs.semantic_feature = Eigen::MatrixXf::Random(16, 2);
+  embeddings.update(fixture.layer);
+  EXPECT_EQ(stats.update(embeddings, tasks, metric), 1u);
+  EXPECT_EQ(stats.size(), 19u);
+  EXPECT_NEAR(stats.mutualInformation(), getExpected(), 1.0e-12);
+}
+
+}  // namespace clio
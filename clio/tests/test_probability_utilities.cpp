@@ -65,6 +65,57 @@ TEST(ProbabilityUtilities, TestJSDivergence) {
   }
 }
 
+TEST(ProbabilityUtilities, TestPairwiseJSDivergence) {
+  std::srand(12345);
+  for (size_t i = 0; i < 20; ++i) {
+    Eigen::MatrixXd dists = Eigen::MatrixXd::Random(50, 2).cwiseAbs();
+    // include some near-zero entries
+    dists.block(0, 0, 5, 1).setConstant(1.0e-12);
+    dists.col(0) /= dists.col(0).sum();
+    dists.col(1) /= dists.col(1).sum();
+    Eigen::VectorXd priors = getBinaryProbability(0.05 * (i + 1));
+
+    const auto H1 = mixtureEntropy(dists.col(0), dists.col(0), 1.0, 0.0);
+    const auto H2 = mixtureEntropy(dists.col(1), dists.col(1), 1.0, 0.0);
+    EXPECT_NEAR(H1, shannonEntropy(dists.col(0)), 1.0e-12);
+    EXPECT_NEAR(H2, shannonEntropy(dists.col(1)), 1.0e-12);
+
+    const auto result = pairwiseJensenShannonDivergence(
+        dists.col(0), dists.col(1), priors(0), priors(1), H1, H2);
+    EXPECT_NEAR(result, jensenShannonDivergence(dists, priors), 1.0e-12);
+  }
+
+  {  // identical distributions never go negative
+    Eigen::VectorXd p = getBinaryProbability(0.3);
+    const auto H = mixtureEntropy(p, p, 1.0, 0.0);
+    EXPECT_GE(pairwiseJensenShannonDivergence(p, p, 0.3, 0.7, H, H), 0.0);
+    EXPECT_NEAR(pairwiseJensenShannonDivergence(p, p, 0.3, 0.7, H, H), 0.0, 1.0e-12);
+  }
+}
+
+TEST(ProbabilityUtilities, TestKLDivergence) {
+  {  // test case 1: identical distributions
+    Eigen::VectorXd p = getBinaryProbability(0.3);
+    EXPECT_NEAR(klDivergence(p, p), 0.0, 1.0e-9);
+  }
+
+  {  // test case 2: deterministic vs. uniform
+    Eigen::VectorXd p = getBinaryProbability(1.0);
+    Eigen::VectorXd q = getBinaryProbability(0.5);
+    EXPECT_NEAR(klDivergence(p, q), 1.0, 1.0e-9);
+  }
+
+  {  // test case 3: matches mutual information for a single column
+    Eigen::MatrixXd pa_b(3, 2);
+    pa_b << 3.0 / 8.0, 2.0 / 8.0, 4.0 / 8.0, 3.0 / 8.0, 1.0 / 8.0, 3.0 / 8.0;
+    Eigen::VectorXd pa = Eigen::VectorXd::Constant(3, 1.0 / 3.0);
+    Eigen::VectorXd pb = getBinaryProbability(0.25);
+    const auto expected = 0.25 * klDivergence(pa_b.col(0), pa) +
+                          0.75 * klDivergence(pa_b.col(1), pa);
+    EXPECT_NEAR(mutualInformation(pa, pb, pa_b), expected, 1.0e-12);
+  }
+}
+
 TEST(ProbabilityUtilities, TestMutualInformation) {
   const auto fmt = getDefaultFormat();
   {  // test case 1: mutual info of 1
@@ -0,0 +1,224 @@
+#include <clio/region_update_functor.h>
+#include <gtest/gtest.h>
+
+#include "clio_tests/utilities.h"
+
+namespace clio {
+
+struct RegionUpdateFunctorTests : public ::testing::Test {
+  RegionUpdateFunctorTests()
+      : graph_info({{DsgLayers::PLACES, 'p'}, {DsgLayers::ROOMS, 'r'}}) {
+    config.clustering.tasks = test::TestEmbeddingGroup::getDefault(3);
+    config.incremental = true;
+  }
+
+  void addPlace(size_t index, size_t onehot_index, bool is_active = false) {
+    auto attrs = std::make_unique<SemanticNodeAttributes>();
+    attrs->position << static_cast<double>(index), 0.0, 0.0;
+    attrs->is_active = is_active;
+    const Eigen::MatrixXf feature =
+        test::TestEmbeddingGroup::getEmbedding(onehot_index).cast<float>();
+    attrs->semantic_feature.resize(feature.rows(), 2);
+    attrs->semantic_feature << feature, feature;
+    graph().emplaceNode(DsgLayers::PLACES, NodeSymbol('p', index), std::move(attrs));
+    if (index > 0) {
+      graph().insertEdge(NodeSymbol('p', index - 1), NodeSymbol('p', index));
+    }
+  }
+
+  std::optional<NodeId> getRegion(size_t index) {
+    return graph().getNode(NodeSymbol('p', index)).getParent();
+  }
+
+  DynamicSceneGraph& graph() { return *graph_info.graph; }
+
+  SharedDsgInfo graph_info;
+  RegionUpdateFunctor::Config config;
+};
+
+TEST_F(RegionUpdateFunctorTests, IncrementalMatchesBatch) {
+  for (size_t i = 0; i < 10; ++i) {
+    addPlace(i, i < 5 ? 1 : 2);
+  }
+
+  AgglomerativeClustering::NodeEmbeddingMap features;
+  for (size_t i = 0; i < 10; ++i) {
+    const auto feature = test::TestEmbeddingGroup::getEmbedding(i < 5 ? 1 : 2);
+    features[NodeSymbol('p', i)] = feature.cast<float>();
+  }
+
+  AgglomerativeClustering clustering(config.clustering);
+  const auto& places = graph().getLayer(DsgLayers::PLACES);
+  const auto num_batch = clustering.cluster(places, features).size();
+
+  RegionUpdateFunctor functor(config);
+  EXPECT_EQ(functor.updateIncremental(graph()), 10u);
+  EXPECT_EQ(graph().getLayer(DsgLayers::ROOMS).numNodes(), num_batch);
+  EXPECT_NE(getRegion(0), getRegion(9));
+}
+
+TEST_F(RegionUpdateFunctorTests, IncrementalKeepsUntouchedRegions) {
+  for (size_t i = 0; i < 10; ++i) {
+    addPlace(i, i < 5 ? 1 : 2);
+  }
+
+  RegionUpdateFunctor functor(config);
+  functor.updateIncremental(graph());
+  const auto first_region = getRegion(0);
+  const auto last_region = getRegion(9);
+  ASSERT_TRUE(first_region);
+  ASSERT_TRUE(last_region);
+  const auto num_last = graph().getNode(*last_region).children().size();
+
+  // no changes: nothing is re-clustered
+  EXPECT_EQ(functor.updateIncremental(graph()), 0u);
+  EXPECT_EQ(getRegion(0), first_region);
+  EXPECT_EQ(getRegion(9), last_region);
+
+  // a new place next to the last region only touches that region
+  addPlace(10, 2, true);
+  EXPECT_EQ(functor.updateIncremental(graph()), num_last + 1);
+  EXPECT_EQ(getRegion(0), first_region);
+  EXPECT_FALSE(graph().hasNode(*last_region));
+  ASSERT_TRUE(getRegion(10));
+  EXPECT_EQ(getRegion(9), getRegion(10));
+}
+
+TEST_F(RegionUpdateFunctorTests, IncrementalReclustersOnNewTasks) {
+  for (size_t i = 0; i < 10; ++i) {
+    addPlace(i, i < 5 ? 1 : 2);
+  }
+
+  RegionUpdateFunctor functor(config);
+  EXPECT_EQ(functor.updateIncremental(graph()), 10u);
+  const auto first_region = getRegion(0);
+  ASSERT_TRUE(first_region);
+
+  test::TestEmbeddingGroup::Config tasks_config;
+  tasks_config.num_embeddings = 4;
+  functor.setTasks(std::make_shared<test::TestEmbeddingGroup>(tasks_config));
+  // nothing changes until the next update
+  EXPECT_TRUE(graph().hasNode(*first_region));
+
+  // every place is re-clustered against the new tasks (without a new functor)
+  EXPECT_EQ(functor.updateIncremental(graph()), 10u);
+  EXPECT_FALSE(graph().hasNode(*first_region));
+  ASSERT_TRUE(getRegion(0));
+  EXPECT_NE(getRegion(0), getRegion(9));
+
+  // and tasks are only swapped once
+  EXPECT_EQ(functor.updateIncremental(graph()), 0u);
+}
+
+TEST_F(RegionUpdateFunctorTests, SubsetClusteringKeepsPendingTasks) {
+  AgglomerativeClustering::NodeEmbeddingMap features;
+  for (size_t i = 0; i < 10; ++i) {
+    addPlace(i, i < 5 ? 1 : 2);
+    const auto feature = test::TestEmbeddingGroup::getEmbedding(i < 5 ? 1 : 2);
+    features[NodeSymbol('p', i)] = feature.cast<float>();
+  }
+
+  AgglomerativeClustering clustering(config.clustering);
+  const auto& places = graph().getLayer(DsgLayers::PLACES);
+  test::TestEmbeddingGroup::Config tasks_config;
+  tasks_config.num_embeddings = 4;
+  clustering.setTasks(std::make_shared<test::TestEmbeddingGroup>(tasks_config));
+
+  // tasks set while a subset is clustered are left to the owner of the subset
+  clustering.cluster(places, features, 1.0, 0.5);
+  EXPECT_EQ(clustering.tasks().embeddings.size(), 3u);
+  EXPECT_TRUE(clustering.updateTasks());
+  EXPECT_EQ(clustering.tasks().embeddings.size(), 4u);
+
+  // clustering every node switches tasks by itself
+  tasks_config.num_embeddings = 2;
+  clustering.setTasks(std::make_shared<test::TestEmbeddingGroup>(tasks_config));
+  clustering.cluster(places, features);
+  EXPECT_EQ(clustering.tasks().embeddings.size(), 2u);
+  EXPECT_FALSE(clustering.updateTasks());
+}
+
+TEST_F(RegionUpdateFunctorTests, DiffUpdateOnlyAppliesChanges) {
+  for (size_t i = 0; i < 6; ++i) {
+    addPlace(i, i < 3 ? 1 : 2);
+  }
+
+  const auto make_cluster = [](const std::vector<size_t>& indices,
+                               const std::string& name) {
+    auto cluster = std::make_shared<Cluster>();
+    for (const auto index : indices) {
+      cluster->nodes.insert(NodeSymbol('p', index));
+    }
+
+    cluster->feature = Eigen::VectorXf::Zero(10);
+    cluster->best_task_name = name;
+    return cluster;
+  };
+
+  config.incremental = false;
+  config.diff_update = true;
+  RegionUpdateFunctor functor(config);
+
+  std::vector<Cluster::Ptr> clusters{make_cluster({0, 1, 2}, "a"),
+                                     make_cluster({3, 4, 5}, "b")};
+  // two new regions and six new edges
+  EXPECT_EQ(functor.updateGraphBatch(graph(), clusters), 8u);
+  const auto first_region = getRegion(0);
+  const auto last_region = getRegion(5);
+  ASSERT_TRUE(first_region);
+  ASSERT_TRUE(last_region);
+
+  // same clusters: nothing to do
+  EXPECT_EQ(functor.updateGraphBatch(graph(), clusters), 0u);
+
+  // moving a place only changes its edges
+  clusters = {make_cluster({0, 1}, "a"), make_cluster({2, 3, 4, 5}, "b")};
+  EXPECT_EQ(functor.updateGraphBatch(graph(), clusters), 2u);
+  EXPECT_EQ(getRegion(0), first_region);
+  EXPECT_EQ(getRegion(2), last_region);
+
+  // renaming a region updates its attributes in place
+  clusters[0]->best_task_name = "c";
+  EXPECT_EQ(functor.updateGraphBatch(graph(), clusters), 1u);
+  EXPECT_EQ(graph().getNode(*first_region).attributes<SemanticNodeAttributes>().name,
+            "c");
+
+  // dropping a cluster removes its region
+  clusters.pop_back();
+  EXPECT_EQ(functor.updateGraphBatch(graph(), clusters), 1u);
+  EXPECT_FALSE(graph().hasNode(*last_region));
+  EXPECT_EQ(graph().getLayer(DsgLayers::ROOMS).numNodes(), 1u);
+}
+
+TEST_F(RegionUpdateFunctorTests, AsyncMatchesSync) {
+  AgglomerativeClustering::NodeEmbeddingMap features;
+  for (size_t i = 0; i < 10; ++i) {
+    addPlace(i, i < 5 ? 1 : 2);
+    const auto feature = test::TestEmbeddingGroup::getEmbedding(i < 5 ? 1 : 2);
+    features[NodeSymbol('p', i)] = feature.cast<float>();
+  }
+
+  AgglomerativeClustering clustering(config.clustering);
+  const auto& places = graph().getLayer(DsgLayers::PLACES);
+  const auto num_sync = clustering.cluster(places, features).size();
+
+  config.incremental = false;
+  config.async = true;
+  RegionUpdateFunctor functor(config);
+
+  // nothing is applied until a pass is started
+  EXPECT_FALSE(functor.applyClustering(graph(), true));
+  EXPECT_TRUE(functor.launchClustering(graph()));
+  EXPECT_FALSE(functor.launchClustering(graph()));
+
+  // places removed while clustering are dropped from the regions
+  graph().removeNode(NodeSymbol('p', 9));
+  EXPECT_TRUE(functor.applyClustering(graph(), true));
+  EXPECT_EQ(graph().getLayer(DsgLayers::ROOMS).numNodes(), num_sync);
+  ASSERT_TRUE(getRegion(0));
+  ASSERT_TRUE(getRegion(8));
+  EXPECT_NE(getRegion(0), getRegion(8));
+  EXPECT_GT(functor.stats().merges, 0u);
+}
+
+}  // namespace clio
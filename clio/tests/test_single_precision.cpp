@@ -0,0 +1,126 @@
+#include <clio/agglomerative_clustering.h>
+#include <clio/clustering_workspace.h>
+#include <clio/ib_edge_selector.h>
+#include <clio/probability_utilities.h>
+#include <gtest/gtest.h>
+
+namespace clio {
+
+using namespace spark_dsg;
+
+namespace {
+
+Eigen::VectorXd getRandomPmf(size_t dim) {
+  Eigen::VectorXd p = Eigen::VectorXd::Random(dim).cwiseAbs();
+  // a few near-zero entries to exercise the tolerance
+  p(0) = 1.0e-12;
+  return p / p.sum();
+}
+
+// fraction of node pairs that both partitions agree on (Rand index)
+double getPairAgreement(const std::vector<std::vector<NodeId>>& lhs,
+                        const std::vector<std::vector<NodeId>>& rhs) {
+  std::map<NodeId, size_t> lhs_labels;
+  std::map<NodeId, size_t> rhs_labels;
+  for (size_t i = 0; i < lhs.size(); ++i) {
+    for (const auto node : lhs[i]) {
+      lhs_labels[node] = i;
+    }
+  }
+
+  for (size_t i = 0; i < rhs.size(); ++i) {
+    for (const auto node : rhs[i]) {
+      rhs_labels[node] = i;
+    }
+  }
+
+  size_t num_pairs = 0;
+  size_t num_agree = 0;
+  for (auto i = lhs_labels.begin(); i != lhs_labels.end(); ++i) {
+    for (auto j = std::next(i); j != lhs_labels.end(); ++j) {
+      const bool lhs_same = i->second == j->second;
+      const bool rhs_same = rhs_labels.at(i->first) == rhs_labels.at(j->first);
+      num_agree += lhs_same == rhs_same ? 1 : 0;
+      ++num_pairs;
+    }
+  }
+
+  return num_pairs ? static_cast<double>(num_agree) / num_pairs : 1.0;
+}
+
+}  // namespace
+
+TEST(SinglePrecision, KernelsMatchDouble) {
+  std::srand(12345);
+  for (size_t trial = 0; trial < 20; ++trial) {
+    const auto p1 = getRandomPmf(300);
+    const auto p2 = getRandomPmf(300);
+    const Eigen::VectorXf f1 = p1.cast<float>();
+    const Eigen::VectorXf f2 = p2.cast<float>();
+    const Eigen::VectorXd q = Eigen::VectorXd::Constant(300, 1.0 / 300.0);
+    const Eigen::VectorXf q_f = q.cast<float>();
+
+    const auto H1 = mixtureEntropy(p1, p1, 1.0, 0.0);
+    const auto H2 = mixtureEntropy(p2, p2, 1.0, 0.0);
+    const auto H1_f = mixtureEntropy(f1, f1, 1.0, 0.0);
+    const auto H2_f = mixtureEntropy(f2, f2, 1.0, 0.0);
+    EXPECT_NEAR(H1, H1_f, 1.0e-5);
+    EXPECT_NEAR(
+        mixtureEntropy(p1, p2, 0.4, 0.6), mixtureEntropy(f1, f2, 0.4, 0.6), 1.0e-5);
+    EXPECT_NEAR(pairwiseJensenShannonDivergence(p1, p2, 0.4, 0.6, H1, H2),
+                pairwiseJensenShannonDivergence(f1, f2, 0.4, 0.6, H1_f, H2_f),
+                1.0e-5);
+    EXPECT_NEAR(klDivergence(p1, q), klDivergence(f1, q_f), 1.0e-5);
+  }
+}
+
+TEST(SinglePrecision, ClusteringMatchesDouble) {
+  hydra::CosineDistance metric;
+  for (const unsigned seed : {1u, 2u, 3u, 4u, 5u}) {
+    std::srand(seed);
+    IsolatedSceneGraphLayer layer(2);
+    ClusteringWorkspace::NodeEmbeddings embeddings;
+    std::vector<Eigen::VectorXf> centers;
+    for (size_t i = 0; i < 3; ++i) {
+      centers.push_back(Eigen::VectorXf::Random(32));
+    }
+
+    for (size_t i = 0; i < 60; ++i) {
+      layer.emplaceNode(i, std::make_unique<NodeAttributes>());
+      embeddings[i] = centers[i / 20] + 0.3 * Eigen::VectorXf::Random(32);
+      if (i > 0) {
+        layer.insertEdge(i - 1, i);
+      }
+    }
+
+    hydra::EmbeddingGroup tasks;
+    for (size_t i = 0; i < 100; ++i) {
+      tasks.embeddings.push_back(Eigen::VectorXf::Random(32));
+      tasks.names.push_back(std::to_string(i));
+    }
+
+    IBEdgeSelector::Config config;
+    config.max_delta = 0.05;
+    config.py_x.score_threshold = 0.1;
+
+    ClusteringWorkspace double_ws(layer, embeddings);
+    IBEdgeSelector double_selector(config);
+    clusterAgglomerative(double_ws, tasks, double_selector, metric);
+
+    config.single_precision = true;
+    ClusteringWorkspace float_ws(layer, embeddings);
+    IBEdgeSelector float_selector(config);
+    clusterAgglomerative(float_ws, tasks, float_selector, metric);
+
+    const auto expected = double_ws.getClusters();
+    const auto result = float_ws.getClusters();
+    ASSERT_GT(expected.size(), 1u) << "seed: " << seed;
+    ASSERT_LT(expected.size(), 60u) << "seed: " << seed;
+    const auto num_expected = static_cast<int>(expected.size());
+    const auto num_result = static_cast<int>(result.size());
+    EXPECT_LE(std::abs(num_expected - num_result), 1) << "seed: " << seed;
+    EXPECT_GE(getPairAgreement(expected, result), 0.95) << "seed: " << seed;
+  }
+}
+
+}  // namespace clio
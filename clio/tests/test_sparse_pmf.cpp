@@ -0,0 +1,147 @@
+#include <clio/agglomerative_clustering.h>
+#include <clio/clustering_workspace.h>
+#include <clio/ib_edge_selector.h>
+#include <clio/ib_utils.h>
+#include <clio/probability_utilities.h>
+#include <clio/sparse_pmf.h>
+#include <gtest/gtest.h>
+
+namespace clio {
+
+using namespace spark_dsg;
+
+namespace {
+
+SparsePmf getRandomPmf(Eigen::Index dim, size_t nnz, double floor) {
+  Eigen::VectorXd p = Eigen::VectorXd::Constant(dim, floor);
+  double mass = 1.0 - floor * (dim - nnz);
+  for (size_t i = 0; i < nnz; ++i) {
+    const auto idx = std::rand() % dim;
+    const double value = i + 1 == nnz ? mass : mass * (std::rand() % 100) / 100.0;
+    p(idx) += value;
+    mass -= value;
+  }
+
+  return SparsePmf::fromDense(p, floor);
+}
+
+}  // namespace
+
+TEST(SparsePmf, DenseRoundTrip) {
+  Eigen::VectorXd p = Eigen::VectorXd::Constant(6, 0.01);
+  p(1) = 0.5;
+  p(4) = 0.46;
+  const auto pmf = SparsePmf::fromDense(p, 0.01);
+  ASSERT_EQ(pmf.nnz(), 2u);
+  EXPECT_EQ(pmf.indices, (std::vector<Eigen::Index>{1, 4}));
+  EXPECT_EQ(pmf(1), 0.5);
+  EXPECT_EQ(pmf(2), 0.01);
+  EXPECT_EQ(pmf.toDense(), p);
+}
+
+TEST(SparsePmf, KernelsMatchDense) {
+  std::srand(12345);
+  // floors below and above the default tolerance
+  for (const double floor : {1.0e-14, 1.0e-3}) {
+    for (size_t trial = 0; trial < 20; ++trial) {
+      const auto p1 = getRandomPmf(50, 1 + trial % 4, floor);
+      const auto p2 = getRandomPmf(50, 1 + trial % 3, floor / 2.0);
+      const Eigen::VectorXd d1 = p1.toDense();
+      const Eigen::VectorXd d2 = p2.toDense();
+      const double w1 = 0.3;
+      const double w2 = 0.7;
+
+      const auto H1 = mixtureEntropy(p1, p1, 1.0, 0.0);
+      const auto H2 = mixtureEntropy(p2, p2, 1.0, 0.0);
+      EXPECT_NEAR(H1, mixtureEntropy(d1, d1, 1.0, 0.0), 1.0e-9);
+      EXPECT_NEAR(mixtureEntropy(p1, p2, w1, w2),
+                  mixtureEntropy(d1, d2, w1, w2),
+                  1.0e-9);
+      EXPECT_NEAR(pairwiseJensenShannonDivergence(p1, p2, w1, w2, H1, H2),
+                  pairwiseJensenShannonDivergence(
+                      d1, d2, w1, w2, mixtureEntropy(d1, d1, 1.0, 0.0), H2),
+                  1.0e-9);
+
+      const Eigen::VectorXd q = Eigen::VectorXd::Constant(50, 1.0 / 50.0);
+      EXPECT_NEAR(klDivergence(p1, q), klDivergence(d1, q), 1.0e-9);
+
+      const auto mixture = mixPmfs(p1, p2, w1, w2);
+      EXPECT_LE(mixture.nnz(), p1.nnz() + p2.nnz());
+      EXPECT_LE((mixture.toDense() - (w1 * d1 + w2 * d2)).cwiseAbs().maxCoeff(),
+                1.0e-15);
+    }
+  }
+}
+
+TEST(SparsePmf, PyGivenXMatchesDense) {
+  std::srand(12345);
+  const Eigen::MatrixXf features = Eigen::MatrixXf::Random(16, 30);
+  hydra::EmbeddingGroup tasks;
+  for (size_t i = 0; i < 200; ++i) {
+    tasks.embeddings.push_back(Eigen::VectorXf::Random(16));
+    tasks.names.push_back(std::to_string(i));
+  }
+
+  hydra::CosineDistance metric;
+  for (const bool cumulative : {true, false}) {
+    for (const bool preprune : {true, false}) {
+      for (const size_t top_k : {1, 3, 500}) {
+        PyGivenXConfig config;
+        config.score_threshold = 0.3;
+        config.cumulative = cumulative;
+        config.null_task_preprune = preprune;
+        config.top_k = top_k;
+        const auto dense = computeIBpyGivenX(features, tasks, metric, config);
+        const auto sparse = computeSparseIBpyGivenX(features, tasks, metric, config);
+        ASSERT_EQ(sparse.size(), 30u);
+        for (size_t c = 0; c < sparse.size(); ++c) {
+          EXPECT_LE(sparse[c].nnz(), std::min<size_t>(top_k, 201));
+          EXPECT_LE((sparse[c].toDense() - dense.col(c)).cwiseAbs().maxCoeff(),
+                    1.0e-12)
+              << "cumulative: " << cumulative << ", preprune: " << preprune
+              << ", k: " << top_k << ", column: " << c;
+        }
+      }
+    }
+  }
+}
+
+TEST(SparsePmf, SelectorMatchesDense) {
+  std::srand(12345);
+  IsolatedSceneGraphLayer layer(2);
+  ClusteringWorkspace::NodeEmbeddings embeddings;
+  const Eigen::VectorXf offset = Eigen::VectorXf::Random(16);
+  for (size_t i = 0; i < 40; ++i) {
+    layer.emplaceNode(i, std::make_unique<NodeAttributes>());
+    embeddings[i] = (i < 20 ? offset : -offset) + 0.2 * Eigen::VectorXf::Random(16);
+    if (i > 0) {
+      layer.insertEdge(i - 1, i);
+    }
+  }
+
+  hydra::EmbeddingGroup tasks;
+  for (size_t i = 0; i < 300; ++i) {
+    tasks.embeddings.push_back(Eigen::VectorXf::Random(16));
+    tasks.names.push_back(std::to_string(i));
+  }
+
+  hydra::CosineDistance metric;
+  IBEdgeSelector::Config config;
+  config.max_delta = 0.1;
+  config.py_x.top_k = 3;
+
+  ClusteringWorkspace dense_ws(layer, embeddings);
+  IBEdgeSelector dense_selector(config);
+  clusterAgglomerative(dense_ws, tasks, dense_selector, metric);
+
+  config.sparse = true;
+  ClusteringWorkspace sparse_ws(layer, embeddings);
+  IBEdgeSelector sparse_selector(config);
+  clusterAgglomerative(sparse_ws, tasks, sparse_selector, metric);
+
+  EXPECT_GT(dense_ws.getClusters().size(), 1u);
+  EXPECT_EQ(dense_ws.getClusters(), sparse_ws.getClusters());
+  EXPECT_EQ(dense_selector.summarize(), sparse_selector.summarize());
+}
+
+}  // namespace clio
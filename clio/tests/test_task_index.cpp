@@ -0,0 +1,140 @@
+#include <clio/task_index.h>
+#include <gtest/gtest.h>
+
+#include <thread>
+
+namespace clio {
+
+namespace {
+
+struct NegativeL2Distance : hydra::EmbeddingDistance {
+  double dist(const Eigen::VectorXf& lhs, const Eigen::VectorXf& rhs) const override {
+    return (lhs - rhs).norm();
+  }
+
+  double score(const Eigen::VectorXf& lhs, const Eigen::VectorXf& rhs) const override {
+    return -dist(lhs, rhs);
+  }
+};
+
+hydra::EmbeddingGroup makeTasks(size_t num_tasks, size_t dim) {
+  hydra::EmbeddingGroup tasks;
+  for (size_t i = 0; i < num_tasks; ++i) {
+    tasks.embeddings.push_back(Eigen::VectorXf::Random(dim));
+    tasks.names.push_back(std::to_string(i));
+  }
+
+  return tasks;
+}
+
+}  // namespace
+
+TEST(TaskIndex, MatchesLinearScan) {
+  std::srand(12345);
+  const auto tasks = makeTasks(1000, 64);
+  hydra::CosineDistance metric;
+  TaskIndex index(tasks, metric);
+  ASSERT_TRUE(index.indexed());
+  EXPECT_EQ(index.size(), 1000u);
+
+  for (size_t i = 0; i < 100; ++i) {
+    // features close to a task as well as unrelated features
+    Eigen::VectorXf feature = Eigen::VectorXf::Random(64);
+    if (i % 2 == 0) {
+      feature = tasks.embeddings[i * 7] + 0.1 * feature;
+    }
+
+    const auto expected = tasks.getBestScore(metric, feature);
+    const auto result = index.getBestScore(feature);
+    EXPECT_EQ(result.index, expected.index) << "feature " << i;
+    EXPECT_EQ(result.score, expected.score) << "feature " << i;
+  }
+
+  // zero features still score against the metric
+  const Eigen::VectorXf zero = Eigen::VectorXf::Zero(64);
+  EXPECT_EQ(index.getBestScore(zero).score, tasks.getBestScore(metric, zero).score);
+}
+
+TEST(TaskIndex, ThresholdDecisionsMatch) {
+  std::srand(12345);
+  const auto tasks = makeTasks(200, 16);
+  hydra::CosineDistance metric;
+  TaskIndex index(tasks, metric);
+
+  size_t num_below = 0;
+  for (size_t i = 0; i < 200; ++i) {
+    const Eigen::VectorXf feature = Eigen::VectorXf::Random(16);
+    const auto expected = tasks.getBestScore(metric, feature);
+    for (const double threshold : {0.2, 0.5, 0.7}) {
+      const auto result = index.getBestScore(feature, threshold);
+      EXPECT_EQ(result.score < threshold, expected.score < threshold);
+      if (result.score >= threshold) {
+        // scores above the threshold are always exact
+        EXPECT_EQ(result.index, expected.index);
+        EXPECT_EQ(result.score, expected.score);
+      } else {
+        ++num_below;
+      }
+    }
+  }
+
+  EXPECT_GT(num_below, 0u);
+}
+
+TEST(TaskIndex, FallsBackToScan) {
+  std::srand(12345);
+  const auto tasks = makeTasks(50, 8);
+  NegativeL2Distance l2;
+  TaskIndex unsupported(tasks, l2);
+  EXPECT_FALSE(unsupported.indexed());
+
+  hydra::CosineDistance metric;
+  TaskIndex::Config config;
+  config.enable = false;
+  TaskIndex disabled(config, tasks, metric);
+  EXPECT_FALSE(disabled.indexed());
+
+  hydra::EmbeddingGroup empty;
+  TaskIndex empty_index(empty, metric);
+  EXPECT_FALSE(empty_index.indexed());
+  config.enable = true;
+  config.min_tasks = 51;
+  EXPECT_FALSE(TaskIndex(config, tasks, metric).indexed());
+  config.min_tasks = 50;
+  EXPECT_TRUE(TaskIndex(config, tasks, metric).indexed());
+
+  for (size_t i = 0; i < 20; ++i) {
+    const Eigen::VectorXf feature = Eigen::VectorXf::Random(8);
+    const auto expected = tasks.getBestScore(l2, feature);
+    const auto result = unsupported.getBestScore(feature, 0.0);
+    EXPECT_EQ(result.index, expected.index);
+    EXPECT_EQ(result.score, expected.score);
+    EXPECT_EQ(disabled.getBestScore(feature).index,
+              tasks.getBestScore(metric, feature).index);
+  }
+}
+
+TEST(PendingTasks, KeepsMostRecentTasks) {
+  PendingTasks pending;
+  EXPECT_EQ(pending.take(), nullptr);
+  pending.set(nullptr);
+  EXPECT_EQ(pending.take(), nullptr);
+
+  std::vector<hydra::EmbeddingGroup::Ptr> tasks;
+  for (size_t i = 0; i < 10; ++i) {
+    tasks.push_back(std::make_shared<hydra::EmbeddingGroup>(makeTasks(i + 1, 4)));
+  }
+
+  std::thread publisher([&]() {
+    for (const auto& group : tasks) {
+      pending.set(group);
+    }
+  });
+  publisher.join();
+
+  EXPECT_EQ(pending.take(), tasks.back());
+  // tasks are only handed off once
+  EXPECT_EQ(pending.take(), nullptr);
+}
+
+}  // namespace clio
@@ -0,0 +1,54 @@
+#include <clio/thread_pool.h>
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+
+namespace clio {
+
+TEST(ThreadPool, RunsEveryItemOnce) {
+  for (const size_t num_threads : {1, 2, 4, 0}) {
+    ThreadPool pool(num_threads);
+    EXPECT_GE(pool.numThreads(), 1u);
+
+    std::vector<std::atomic<size_t>> counts(1000);
+    pool.parallelFor(counts.size(), [&](size_t i) { ++counts[i]; });
+    for (size_t i = 0; i < counts.size(); ++i) {
+      EXPECT_EQ(counts[i], 1u) << "item " << i << " with " << num_threads << " threads";
+    }
+
+    // empty jobs are fine
+    pool.parallelFor(0, [&](size_t) { FAIL(); });
+  }
+}
+
+TEST(ThreadPool, NestedCallsFinish) {
+  ThreadPool pool(3);
+  std::atomic<size_t> total(0);
+  pool.parallelFor(8, [&](size_t) {
+    pool.parallelFor(16, [&](size_t i) { total += i; });
+  });
+
+  EXPECT_EQ(total, 8u * 120u);
+}
+
+TEST(ThreadPool, RethrowsErrors) {
+  ThreadPool pool(4);
+  std::atomic<size_t> finished(0);
+  EXPECT_THROW(pool.parallelFor(100,
+                                [&](size_t i) {
+                                  if (i == 42) {
+                                    throw std::runtime_error("failed");
+                                  }
+
+                                  ++finished;
+                                }),
+               std::runtime_error);
+  EXPECT_EQ(finished, 99u);
+
+  // still usable afterwards
+  std::atomic<size_t> count(0);
+  pool.parallelFor(10, [&](size_t) { ++count; });
+  EXPECT_EQ(count, 10u);
+}
+
+}  // namespace clio
@@ -0,0 +1,186 @@
+#include <clio/batch_clustering.h>
+#include <clio/thread_pool.h>
+#include <glog/logging.h>
+#include <yaml-cpp/yaml.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <optional>
+
+// Usage: clio_batch_cluster ABLATION_YAML [--cluster-configs=DIR] [--threads=N]
+// [--overwrite]
+//
+// Runs the object clustering of clio_eval/experiments/run_3d_object_ablations.py for
+// every experiment of an ablation file (experiments run in parallel) and writes
+// <log_path>/<dataset>/<experiment>/dsg.json. Cluster configs are resolved against
+// ../cluster relative to the ablation file unless --cluster-configs is set. Task
+// embeddings are read from the task_embeddings entry of each dataset, or from
+// <log_path>/<dataset>/task_embeddings.yaml (see
+// clio_batch/export_task_embeddings.py). Existing results are skipped unless
+// --overwrite is set.
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct Dataset {
+  std::string name;
+  spark_dsg::DynamicSceneGraph::Ptr graph;
+  std::unique_ptr<clio::FileEmbeddingGroup> tasks;
+};
+
+struct Experiment {
+  const Dataset* dataset;
+  std::string name;
+  fs::path output;
+  clio::BatchClusteringConfig config;
+};
+
+std::optional<clio::IBEdgeSelector::Config> loadClusterConfig(const fs::path& path) {
+  YAML::Node root;
+  try {
+    root = YAML::LoadFile(path.string());
+  } catch (const std::exception& e) {
+    LOG(ERROR) << "Failed to read cluster config '" << path.string()
+               << "': " << e.what();
+    return std::nullopt;
+  }
+
+  // same keys as clio_batch.ib_cluster.ClusterIBConfig
+  const YAML::Node& node = root;
+  clio::IBEdgeSelector::Config config;
+  config.max_delta = node["delta"].as<double>(config.max_delta);
+  config.py_x.score_threshold =
+      node["sims_thres"].as<float>(config.py_x.score_threshold);
+  config.py_x.top_k = node["top_k_tasks"].as<size_t>(config.py_x.top_k);
+  config.py_x.cumulative = node["cumulative"].as<bool>(config.py_x.cumulative);
+  LOG_IF(WARNING, node["use_lerf_loss"].as<bool>(false))
+      << "'" << path.string() << "' uses the LERF loss, which is not supported: using "
+      << "cosine similarity instead";
+  return config;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  google::InitGoogleLogging(argv[0]);
+  FLAGS_logtostderr = true;
+
+  std::optional<fs::path> ablation_path;
+  std::optional<fs::path> config_dir;
+  size_t num_threads = 0;
+  bool overwrite = false;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg(argv[i]);
+    if (arg.rfind("--cluster-configs=", 0) == 0) {
+      config_dir = arg.substr(arg.find('=') + 1);
+    } else if (arg.rfind("--threads=", 0) == 0) {
+      num_threads = std::stoul(arg.substr(arg.find('=') + 1));
+    } else if (arg == "--overwrite") {
+      overwrite = true;
+    } else if (!ablation_path && arg.rfind("--", 0) != 0) {
+      ablation_path = arg;
+    } else {
+      std::cerr << "unknown argument '" << arg << "'" << std::endl;
+      return 1;
+    }
+  }
+
+  if (!ablation_path) {
+    std::cerr << "usage: " << argv[0]
+              << " ABLATION_YAML [--cluster-configs=DIR] [--threads=N] [--overwrite]"
+              << std::endl;
+    return 1;
+  }
+
+  if (!config_dir) {
+    config_dir = ablation_path->parent_path().parent_path() / "cluster";
+  }
+
+  const auto ablation = YAML::LoadFile(ablation_path->string());
+  const fs::path log_path = ablation["log_path"].as<std::string>();
+
+  std::vector<std::unique_ptr<Dataset>> datasets;
+  std::vector<Experiment> experiments;
+  for (const auto& dataset_node : ablation["datasets"]) {
+    auto dataset = std::make_unique<Dataset>();
+    dataset->name = dataset_node["name"].as<std::string>();
+
+    clio::FileEmbeddingGroup::Config tasks_config;
+    tasks_config.path = dataset_node["task_embeddings"].as<std::string>(
+        (log_path / dataset->name / "task_embeddings.yaml").string());
+    dataset->tasks = std::make_unique<clio::FileEmbeddingGroup>(tasks_config);
+    if (dataset->tasks->empty()) {
+      LOG(ERROR) << "No tasks for dataset '" << dataset->name << "'";
+      return 1;
+    }
+
+    for (const auto& experiment_node : dataset_node["experiments"]) {
+      Experiment experiment;
+      experiment.dataset = dataset.get();
+      experiment.name = experiment_node["name"].as<std::string>();
+      experiment.output = log_path / dataset->name / experiment.name;
+      if (!overwrite && fs::exists(experiment.output / "dsg.json")) {
+        LOG(INFO) << dataset->name << " - " << experiment.name
+                  << " exists. Skipping...";
+        continue;
+      }
+
+      const auto selector = loadClusterConfig(
+          *config_dir / experiment_node["cluster_config"].as<std::string>());
+      if (!selector) {
+        return 1;
+      }
+
+      auto& config = experiment.config;
+      config.selector = *selector;
+      config.prune_threshold = experiment_node["prune_threshold"].as<double>();
+      config.partition = experiment_node["partition"].as<bool>(false);
+      config.recompute_edges = experiment_node["recompute_edges"].as<bool>(false);
+      config.bbox_dilation = experiment_node["bbox_dilation"].as<double>(0.0);
+      experiments.push_back(std::move(experiment));
+    }
+
+    if (std::any_of(experiments.begin(), experiments.end(), [&](const auto& e) {
+          return e.dataset == dataset.get();
+        })) {
+      const auto graph_path = dataset_node["fine_dsg"].as<std::string>();
+      LOG(INFO) << "Loading '" << graph_path << "'";
+      dataset->graph = spark_dsg::DynamicSceneGraph::load(graph_path);
+    }
+
+    datasets.push_back(std::move(dataset));
+  }
+
+  const hydra::CosineDistance metric;
+  clio::ThreadPool pool(num_threads);
+  LOG(INFO) << "Running " << experiments.size() << " experiment(s) on "
+            << pool.numThreads() << " thread(s)";
+
+  std::atomic<size_t> num_failed = 0;
+  pool.parallelFor(experiments.size(), [&](size_t i) {
+    const auto& experiment = experiments[i];
+    const auto& dataset = *experiment.dataset;
+    try {
+      const auto start = std::chrono::steady_clock::now();
+      const auto result = clio::clusterSegments(
+          *dataset.graph, *dataset.tasks, metric, experiment.config);
+      const std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - start;
+
+      fs::create_directories(experiment.output);
+      result.graph->save((experiment.output / "dsg.json").string());
+      LOG(INFO) << dataset.name << " - " << experiment.name << ": "
+                << result.num_objects << " object(s) from " << result.num_clusters
+                << " cluster(s) in " << elapsed.count() << " s";
+    } catch (const std::exception& e) {
+      LOG(ERROR) << dataset.name << " - " << experiment.name << " failed: " << e.what();
+      ++num_failed;
+    }
+  });
+
+  return num_failed ? 1 : 0;
+}
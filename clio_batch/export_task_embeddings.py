@@ -0,0 +1,49 @@
+"""Export CLIP task embeddings for the native batch clustering tool."""
+import pathlib
+import click
+import yaml
+import clio_batch.helpers as helpers
+
+
+def export_task_embeddings(task_yaml, output_path, cliphandler):
+    """Write the embedding of every task in the task file to output_path."""
+    task_phrases = [x for x in helpers.parse_tasks_from_yaml(task_yaml) if x != ""]
+    task_features = cliphandler.get_text_clip_features(task_phrases)
+    output = {
+        "names": task_phrases,
+        "embeddings": [[float(x) for x in row] for row in task_features],
+    }
+
+    output_path.parent.mkdir(parents=True, exist_ok=True)
+    with open(output_path, "w") as file:
+        yaml.safe_dump(output, file, default_flow_style=None)
+
+
+@click.command()
+@click.argument("ablation_file", type=click.Path(exists=True))
+@click.option("--overwrite", is_flag=True)
+def main(ablation_file, overwrite):
+    """Write <log_path>/<dataset>/task_embeddings.yaml for every dataset."""
+    with open(ablation_file, "r") as stream:
+        ablation_dict = yaml.safe_load(stream)
+
+    handlers = {}
+    for dataset in ablation_dict["datasets"]:
+        output_path = (
+            pathlib.Path(ablation_dict["log_path"]) / dataset["name"] / "task_embeddings.yaml"
+        )
+        if output_path.exists() and not overwrite:
+            print(f"{output_path} exists. Skipping...")
+            continue
+
+        model_name = dataset["clip_model"]
+        if model_name not in handlers:
+            print(f"loading {model_name}...")
+            handlers[model_name] = helpers.ClipHandler(model_name)
+
+        export_task_embeddings(dataset["task_yaml"], output_path, handlers[model_name])
+        click.secho(f"wrote {output_path}", fg="green")
+
+
+if __name__ == "__main__":
+    main()